@@ -0,0 +1,44 @@
+# Locate libzstd
+# This module defines
+# ZSTD_LIBRARY
+# ZSTD_FOUND, if false, do not try to link to libzstd
+# ZSTD_INCLUDE_DIR, where to find the headers
+#
+# $ZSTD_DIR is an environment variable that would
+# correspond to the ./configure --prefix=$ZSTD_DIR
+# used in building libzstd.
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h
+    $ENV{ZSTD_DIR}/include
+    $ENV{ZSTD_DIR}
+    ~/Library/Frameworks
+    /Library/Frameworks
+    /usr/local/include
+    /usr/include
+    /sw/include # Fink
+    /opt/local/include # DarwinPorts
+    /opt/csw/include # Blastwave
+    /opt/include
+    /usr/freeware/include
+)
+
+FIND_LIBRARY(ZSTD_LIBRARY
+    NAMES zstd libzstd
+    PATHS
+    $ENV{ZSTD_DIR}/lib
+    $ENV{ZSTD_DIR}
+    ~/Library/Frameworks
+    /Library/Frameworks
+    /usr/local/lib
+    /usr/lib
+    /sw/lib
+    /opt/local/lib
+    /opt/csw/lib
+    /opt/lib
+    /usr/freeware/lib64
+)
+
+SET(ZSTD_FOUND "NO")
+IF(ZSTD_LIBRARY AND ZSTD_INCLUDE_DIR)
+    SET(ZSTD_FOUND "YES")
+ENDIF(ZSTD_LIBRARY AND ZSTD_INCLUDE_DIR)
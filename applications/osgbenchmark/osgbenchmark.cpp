@@ -0,0 +1,1128 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This application is open source and may be redistributed and/or modified
+ * freely and without restriction, both in commercial and non commercial applications,
+ * as long as this copyright notice is maintained.
+ *
+ * This application is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osg/Notify>
+#include <osg/Version>
+#include <osg/MatrixTransform>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/StateSet>
+#include <osg/Material>
+#include <osg/KdTree>
+#include <osg/FrameStamp>
+#include <osg/Polytope>
+#include <osg/Trace>
+
+#include <osgDB/Registry>
+#include <osgDB/WriteFile>
+#include <osgDB/FileNameUtils>
+
+#include <osgUtil/CullVisitor>
+#include <osgUtil/UpdateVisitor>
+#include <osgUtil/StateGraph>
+#include <osgUtil/RenderStage>
+#include <osgUtil/LineSegmentIntersector>
+#include <osgUtil/Optimizer>
+
+#include <osgAnimation/Skeleton>
+#include <osgAnimation/Bone>
+#include <osgAnimation/RigGeometry>
+#include <osgAnimation/UpdateBone>
+#include <osgAnimation/StackedTranslateElement>
+#include <osgAnimation/StackedRotateAxisElement>
+
+#include <OpenThreads/Thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <map>
+
+// osgbenchmark times CPU side scene graph operations on synthetic scenes, without creating a graphics context,
+// so that it can be run on machines without a GPU. The scenes are generated from a fixed random seed so that
+// runs are comparable.
+
+static float random(float min, float max) { return min + (max-min)*(float)rand()/(float)RAND_MAX; }
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Synthetic scenes
+//
+static osg::Geometry* createBox(const osg::Vec3& center, float size)
+{
+    static const float corners[8][3] = { {-1,-1,-1}, {1,-1,-1}, {1,1,-1}, {-1,1,-1}, {-1,-1,1}, {1,-1,1}, {1,1,1}, {-1,1,1} };
+    static const unsigned int faces[6][4] = { {0,3,2,1}, {4,5,6,7}, {0,1,5,4}, {1,2,6,5}, {2,3,7,6}, {3,0,4,7} };
+    static const float normals[6][3] = { {0,0,-1}, {0,0,1}, {0,-1,0}, {1,0,0}, {0,1,0}, {-1,0,0} };
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normalArray = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUShort> triangles = new osg::DrawElementsUShort(GL_TRIANGLES);
+    for(unsigned int f=0; f<6; ++f)
+    {
+        unsigned short base = static_cast<unsigned short>(vertices->size());
+        for(unsigned int c=0; c<4; ++c)
+        {
+            const float* corner = corners[faces[f][c]];
+            vertices->push_back(center+osg::Vec3(corner[0], corner[1], corner[2])*(size*0.5f));
+            normalArray->push_back(osg::Vec3(normals[f][0], normals[f][1], normals[f][2]));
+        }
+        triangles->push_back(base); triangles->push_back(base+1); triangles->push_back(base+2);
+        triangles->push_back(base); triangles->push_back(base+2); triangles->push_back(base+3);
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normalArray.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(triangles.get());
+    return geometry;
+}
+
+static osg::Geometry* createGrid(unsigned int numColumns, unsigned int numRows, float size)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec2Array> texcoords = new osg::Vec2Array;
+    vertices->reserve(numColumns*numRows);
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            float s = float(c)/float(numColumns-1), t = float(r)/float(numRows-1);
+            float height = sinf(s*20.0f)*cosf(t*15.0f)*size*0.02f;
+            vertices->push_back(osg::Vec3((s-0.5f)*size, (t-0.5f)*size, height));
+            normals->push_back(osg::Vec3(0.0f,0.0f,1.0f));
+            texcoords->push_back(osg::Vec2(s,t));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    triangles->reserve((numColumns-1)*(numRows-1)*6);
+    for(unsigned int r=0; r<numRows-1; ++r)
+    {
+        for(unsigned int c=0; c<numColumns-1; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+            triangles->push_back(i); triangles->push_back(i+1); triangles->push_back(i+numColumns+1);
+            triangles->push_back(i); triangles->push_back(i+numColumns+1); triangles->push_back(i+numColumns);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->setTexCoordArray(0, texcoords.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(triangles.get());
+    return geometry;
+}
+
+// many small drawables under static transforms, sharing a handful of equivalent but distinct StateSets.
+static osg::Node* createManyDrawables(unsigned int numDrawables)
+{
+    std::vector< osg::ref_ptr<osg::StateSet> > statesets;
+    for(unsigned int i=0; i<64; ++i)
+    {
+        osg::ref_ptr<osg::Material> material = new osg::Material;
+        material->setDiffuse(osg::Material::FRONT_AND_BACK, osg::Vec4(float(i%4)/3.0f, float((i/4)%4)/3.0f, 0.5f, 1.0f));
+        statesets.push_back(new osg::StateSet);
+        statesets.back()->setAttributeAndModes(material.get());
+    }
+
+    unsigned int width = static_cast<unsigned int>(ceil(sqrt(double(numDrawables))));
+    osg::Group* root = new osg::Group;
+    for(unsigned int i=0; i<numDrawables; ++i)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(createBox(osg::Vec3(0.0f,0.0f,0.0f), random(0.5f,1.5f)));
+        geode->setStateSet(statesets[rand()%statesets.size()].get());
+
+        osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform(osg::Matrixd::translate(float(i%width)*2.0f, float(i/width)*2.0f, random(-1.0f,1.0f)));
+        transform->setDataVariance(osg::Object::STATIC);
+        transform->addChild(geode.get());
+        root->addChild(transform.get());
+    }
+    return root;
+}
+
+static osg::Node* createHierarchy(osg::Geode* leaf, unsigned int depth, unsigned int branching, float spacing)
+{
+    if (depth==0) return leaf;
+
+    osg::Group* group = new osg::Group;
+    for(unsigned int i=0; i<branching; ++i)
+    {
+        osg::MatrixTransform* transform = new osg::MatrixTransform(osg::Matrixd::rotate(random(0.0f,1.0f), osg::Vec3(0.0f,0.0f,1.0f))*
+                                                                   osg::Matrixd::translate(spacing*(float(i)-float(branching-1)*0.5f), spacing*0.5f, 0.0f));
+        transform->addChild(createHierarchy(leaf, depth-1, branching, spacing*0.5f));
+        group->addChild(transform);
+    }
+    return group;
+}
+
+// a deep binary tree of transforms, all instancing the same leaf.
+static osg::Node* createDeepHierarchy(unsigned int depth)
+{
+    osg::ref_ptr<osg::Geode> leaf = new osg::Geode;
+    leaf->addDrawable(createBox(osg::Vec3(0.0f,0.0f,0.0f), 5.0f));
+    return createHierarchy(leaf.get(), depth, 2, 1000.0f);
+}
+
+static osg::Node* createLargeMesh(unsigned int numColumns, unsigned int numRows)
+{
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(createGrid(numColumns, numRows, 1000.0f));
+    return geode;
+}
+
+// a tube of vertices skinned to a chain of bones, each vertex weighted between its two nearest bones.
+static osg::Node* createSkinnedMesh(unsigned int numBones, unsigned int numRings, unsigned int numSegments,
+                                    std::vector<osgAnimation::StackedRotateAxisElement*>& rotations)
+{
+    const float boneLength = 1.0f;
+    const float length = boneLength*float(numBones);
+
+    osg::ref_ptr<osgAnimation::Skeleton> skeleton = new osgAnimation::Skeleton;
+    skeleton->setDefaultUpdateCallback();
+
+    osg::Group* parent = skeleton.get();
+    std::vector<std::string> boneNames;
+    for(unsigned int b=0; b<numBones; ++b)
+    {
+        std::stringstream sstr;
+        sstr<<"bone"<<b;
+        boneNames.push_back(sstr.str());
+
+        osg::ref_ptr<osgAnimation::Bone> bone = new osgAnimation::Bone(boneNames.back());
+        bone->setInvBindMatrixInSkeletonSpace(osg::Matrix::translate(-float(b)*boneLength, 0.0f, 0.0f));
+
+        osgAnimation::UpdateBone* updateBone = new osgAnimation::UpdateBone(boneNames.back());
+        updateBone->getStackedTransforms().push_back(new osgAnimation::StackedTranslateElement("translate", osg::Vec3(b==0 ? 0.0f : boneLength, 0.0f, 0.0f)));
+        osgAnimation::StackedRotateAxisElement* rotation = new osgAnimation::StackedRotateAxisElement("rotate", osg::Vec3(0.0f,0.0f,1.0f), 0.0);
+        updateBone->getStackedTransforms().push_back(rotation);
+        rotations.push_back(rotation);
+        bone->setUpdateCallback(updateBone);
+
+        parent->addChild(bone.get());
+        parent = bone.get();
+    }
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osgAnimation::VertexInfluenceMap> influenceMap = new osgAnimation::VertexInfluenceMap;
+    for(unsigned int b=0; b<numBones; ++b)
+    {
+        (*influenceMap)[boneNames[b]].setName(boneNames[b]);
+    }
+
+    for(unsigned int r=0; r<numRings; ++r)
+    {
+        float x = length*float(r)/float(numRings-1);
+        float bonePosition = x/boneLength - 0.5f;
+        int bone0 = osg::clampBetween(static_cast<int>(floorf(bonePosition)), 0, int(numBones)-1);
+        int bone1 = osg::minimum(bone0+1, int(numBones)-1);
+        float weight1 = osg::clampBetween(bonePosition-float(bone0), 0.0f, 1.0f);
+
+        for(unsigned int s=0; s<numSegments; ++s)
+        {
+            float angle = 2.0f*osg::PIf*float(s)/float(numSegments);
+            osg::Vec3 normal(0.0f, cosf(angle), sinf(angle));
+            unsigned int index = static_cast<unsigned int>(vertices->size());
+            vertices->push_back(osg::Vec3(x, 0.0f, 0.0f)+normal*0.25f);
+            normals->push_back(normal);
+
+            if (weight1<1.0f) (*influenceMap)[boneNames[bone0]].push_back(osgAnimation::VertexIndexWeight(index, 1.0f-weight1));
+            if (weight1>0.0f && bone1!=bone0) (*influenceMap)[boneNames[bone1]].push_back(osgAnimation::VertexIndexWeight(index, weight1));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned int r=0; r<numRings-1; ++r)
+    {
+        for(unsigned int s=0; s<numSegments; ++s)
+        {
+            unsigned int i0 = r*numSegments+s, i1 = r*numSegments+(s+1)%numSegments;
+            triangles->push_back(i0); triangles->push_back(i1); triangles->push_back(i0+numSegments);
+            triangles->push_back(i1); triangles->push_back(i1+numSegments); triangles->push_back(i0+numSegments);
+        }
+    }
+
+    osg::ref_ptr<osg::Geometry> source = new osg::Geometry;
+    source->setVertexArray(vertices.get());
+    source->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    source->addPrimitiveSet(triangles.get());
+
+    osg::ref_ptr<osgAnimation::RigGeometry> rigGeometry = new osgAnimation::RigGeometry;
+    rigGeometry->setSourceGeometry(source.get());
+    rigGeometry->setInfluenceMap(influenceMap.get());
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->addDrawable(rigGeometry.get());
+    skeleton->addChild(geode.get());
+
+    return skeleton.release();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmark harness
+//
+class Operation : public osg::Referenced
+{
+    public:
+
+        /** Prepare an iteration, not included in the timing.*/
+        virtual void setUp() {}
+
+        /** The timed part of an iteration.*/
+        virtual void run() = 0;
+
+        /** Number of items processed per iteration, such as nodes, rays or frames, reported alongside the timings.*/
+        virtual unsigned int getNumItems() const { return 1; }
+};
+
+struct Result
+{
+    Result(): iterations(0), items(0), minimum(0.0), median(0.0), mean(0.0) {}
+
+    std::string     name;
+    std::string     status;
+    unsigned int    iterations;
+    unsigned int    items;
+    double          minimum;
+    double          median;
+    double          mean;
+};
+
+typedef std::vector<Result> Results;
+
+class Harness
+{
+    public:
+
+        Harness(std::ostream& log, unsigned int numIterations, const std::vector<std::string>& filters):
+            _log(log),
+            _numIterations(numIterations),
+            _filters(filters) {}
+
+        bool selected(const std::string& name) const
+        {
+            if (_filters.empty()) return true;
+            for(std::vector<std::string>::const_iterator itr = _filters.begin(); itr != _filters.end(); ++itr)
+            {
+                if (name.find(*itr)!=std::string::npos) return true;
+            }
+            return false;
+        }
+
+        void run(const std::string& name, Operation* operation)
+        {
+            osg::ref_ptr<Operation> ref = operation;
+            if (!selected(name)) return;
+
+            // one untimed iteration to warm up the caches and any lazily built data.
+            operation->setUp();
+            operation->run();
+
+            std::vector<double> times;
+            for(unsigned int i=0; i<_numIterations; ++i)
+            {
+                operation->setUp();
+                osg::Timer_t start = osg::Timer::instance()->tick();
+                operation->run();
+                osg::Timer_t end = osg::Timer::instance()->tick();
+                times.push_back(end>start ? osg::Timer::instance()->delta_m(start, end) : 0.0);
+            }
+
+            record(name, times, operation->getNumItems());
+        }
+
+        /** Record timings, in milliseconds, measured outside of run(), such as those of the stages of an operation.*/
+        void record(const std::string& name, std::vector<double> times, unsigned int numItems)
+        {
+            Result result;
+            result.name = name;
+            result.status = "ok";
+            result.iterations = static_cast<unsigned int>(times.size());
+            result.items = numItems;
+            if (!times.empty())
+            {
+                std::sort(times.begin(), times.end());
+                result.minimum = times.front();
+                result.median = times[times.size()/2];
+                double total = 0.0;
+                for(std::vector<double>::const_iterator itr = times.begin(); itr != times.end(); ++itr) total += *itr;
+                result.mean = total/double(times.size());
+            }
+
+            _log<<std::left<<std::setw(48)<<name<<std::right<<std::fixed<<std::setprecision(3)
+                     <<" median "<<std::setw(10)<<result.median<<"ms  min "<<std::setw(10)<<result.minimum<<"ms  items "<<result.items<<std::endl;
+
+            _results.push_back(result);
+        }
+
+        void skip(const std::string& name, const std::string& reason)
+        {
+            if (!selected(name)) return;
+
+            Result result;
+            result.name = name;
+            result.status = "skipped: "+reason;
+            _log<<std::left<<std::setw(48)<<name<<" skipped, "<<reason<<std::endl;
+
+            _results.push_back(result);
+        }
+
+        unsigned int getNumIterations() const { return _numIterations; }
+
+        const Results& getResults() const { return _results; }
+
+    protected:
+
+        std::ostream&               _log;
+        unsigned int                _numIterations;
+        std::vector<std::string>    _filters;
+        Results                     _results;
+};
+
+static void writeJSON(std::ostream& out, const Results& results, unsigned int numIterations, double scale)
+{
+    out<<std::fixed<<std::setprecision(4);
+    out<<"{"<<std::endl;
+    out<<"  \"osgVersion\": "; osg::writeTraceString(out, osgGetVersion()); out<<","<<std::endl;
+    out<<"  \"numProcessors\": "<<OpenThreads::GetNumberOfProcessors()<<","<<std::endl;
+    out<<"  \"iterations\": "<<numIterations<<","<<std::endl;
+    out<<"  \"scale\": "<<scale<<","<<std::endl;
+    out<<"  \"results\": ["<<std::endl;
+    for(Results::const_iterator itr = results.begin(); itr != results.end(); ++itr)
+    {
+        out<<"    {\"name\": "; osg::writeTraceString(out, itr->name);
+        out<<", \"status\": "; osg::writeTraceString(out, itr->status);
+        if (itr->status=="ok")
+        {
+            out<<", \"iterations\": "<<itr->iterations<<", \"items\": "<<itr->items
+               <<", \"min_ms\": "<<itr->minimum<<", \"median_ms\": "<<itr->median<<", \"mean_ms\": "<<itr->mean;
+        }
+        out<<"}"<<(itr+1!=results.end() ? "," : "")<<std::endl;
+    }
+    out<<"  ]"<<std::endl;
+    out<<"}"<<std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Operations
+//
+class CountNodesVisitor : public osg::NodeVisitor
+{
+    public:
+
+        CountNodesVisitor(): osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _numNodes(0) {}
+
+        virtual void apply(osg::Node& node) { ++_numNodes; traverse(node); }
+
+        unsigned int _numNodes;
+};
+
+class TraversalOperation : public Operation
+{
+    public:
+
+        TraversalOperation(osg::Node* scene): _scene(scene), _numNodes(0) {}
+
+        virtual void run()
+        {
+            CountNodesVisitor visitor;
+            _scene->accept(visitor);
+            _numNodes = visitor._numNodes;
+        }
+
+        virtual unsigned int getNumItems() const { return _numNodes; }
+
+    protected:
+
+        osg::ref_ptr<osg::Node> _scene;
+        unsigned int            _numNodes;
+};
+
+class UpdateOperation : public Operation
+{
+    public:
+
+        UpdateOperation(osg::Node* scene, const std::vector<osgAnimation::StackedRotateAxisElement*>& rotations):
+            _scene(scene),
+            _rotations(rotations),
+            _frameStamp(new osg::FrameStamp),
+            _frameNumber(0) {}
+
+        virtual void setUp()
+        {
+            // bend the chain differently every frame so the skinning has to be recomputed.
+            ++_frameNumber;
+            for(unsigned int i=0; i<_rotations.size(); ++i)
+            {
+                _rotations[i]->setAngle(0.2*sin(double(_frameNumber)*0.1+double(i)));
+            }
+            _frameStamp->setFrameNumber(_frameNumber);
+            _frameStamp->setReferenceTime(double(_frameNumber)/60.0);
+            _frameStamp->setSimulationTime(double(_frameNumber)/60.0);
+        }
+
+        virtual void run()
+        {
+            osgUtil::UpdateVisitor visitor;
+            visitor.setFrameStamp(_frameStamp.get());
+            visitor.setTraversalNumber(_frameNumber);
+            _scene->accept(visitor);
+        }
+
+    protected:
+
+        osg::ref_ptr<osg::Node>                                 _scene;
+        std::vector<osgAnimation::StackedRotateAxisElement*>    _rotations;
+        osg::ref_ptr<osg::FrameStamp>                           _frameStamp;
+        unsigned int                                            _frameNumber;
+};
+
+class CullOperation : public Operation
+{
+    public:
+
+        CullOperation(osg::Node* scene, unsigned int batchCullThreshold=0, osgUtil::RenderBin::SortMode sortMode=osgUtil::RenderBin::SORT_BY_STATE):
+            _scene(scene),
+            _cullVisitor(new osgUtil::CullVisitor),
+            _stateGraph(new osgUtil::StateGraph),
+            _renderStage(new osgUtil::RenderStage),
+            _viewport(new osg::Viewport(0,0,1920,1080)),
+            _frameStamp(new osg::FrameStamp),
+            _numLeaves(0)
+        {
+            _cullVisitor->setStateGraph(_stateGraph.get());
+            _cullVisitor->setRenderStage(_renderStage.get());
+            _cullVisitor->setFrameStamp(_frameStamp.get());
+            _cullVisitor->setBatchCullThreshold(batchCullThreshold);
+            _renderStage->setSortMode(sortMode);
+
+            setView(scene->getBound());
+        }
+
+        /** Look down onto the bounding sphere from a distance that leaves part of it outside of the view, by default the scene's own.*/
+        void setView(const osg::BoundingSphere& bs)
+        {
+            osg::Vec3d center(bs.center());
+            double radius = bs.radius();
+            _projection = new osg::RefMatrix(osg::Matrixd::perspective(60.0, 16.0/9.0, radius*0.01, radius*4.0));
+            _view = new osg::RefMatrix(osg::Matrixd::lookAt(center+osg::Vec3d(0.0, -radius*0.8, radius*0.6), center, osg::Vec3d(0.0,0.0,1.0)));
+        }
+
+        virtual void setUp()
+        {
+            _stateGraph->clean();
+            _renderStage->reset();
+            _cullVisitor->reset();
+        }
+
+        virtual void run()
+        {
+            _cullVisitor->pushViewport(_viewport.get());
+            _cullVisitor->pushProjectionMatrix(_projection.get());
+            _cullVisitor->pushModelViewMatrix(_view.get(), osg::Transform::ABSOLUTE_RF);
+
+            _scene->accept(*_cullVisitor);
+
+            _cullVisitor->popModelViewMatrix();
+            _cullVisitor->popProjectionMatrix();
+            _cullVisitor->popViewport();
+
+            _cullVisitor->addDeferredRenderLeaves();
+            _renderStage->sort();
+            _stateGraph->prune();
+
+            // the leaves sorted by key have been moved from the StateGraphList to the RenderLeafList.
+            _numLeaves = static_cast<unsigned int>(_renderStage->getRenderLeafList().size());
+            const osgUtil::RenderBin::StateGraphList& stateGraphs = _renderStage->getStateGraphList();
+            for(osgUtil::RenderBin::StateGraphList::const_iterator itr = stateGraphs.begin(); itr != stateGraphs.end(); ++itr)
+            {
+                _numLeaves += static_cast<unsigned int>((*itr)->_leaves.size());
+            }
+        }
+
+        virtual unsigned int getNumItems() const { return _numLeaves; }
+
+    protected:
+
+        osg::ref_ptr<osg::Node>                 _scene;
+        osg::ref_ptr<osgUtil::CullVisitor>      _cullVisitor;
+        osg::ref_ptr<osgUtil::StateGraph>       _stateGraph;
+        osg::ref_ptr<osgUtil::RenderStage>      _renderStage;
+        osg::ref_ptr<osg::Viewport>             _viewport;
+        osg::ref_ptr<osg::FrameStamp>           _frameStamp;
+        osg::ref_ptr<osg::RefMatrix>            _projection;
+        osg::ref_ptr<osg::RefMatrix>            _view;
+        unsigned int                            _numLeaves;
+};
+
+// the view frustum tests of spheres spread over a square much wider than the view, so that most of them are culled,
+// either one sphere at a time or batched as the CullVisitor does for the children of large groups.
+class PolytopeContainsOperation : public Operation
+{
+    public:
+
+        PolytopeContainsOperation(unsigned int numSpheres, bool batched):
+            _batched(batched),
+            _spheres(numSpheres),
+            _x(numSpheres), _y(numSpheres), _z(numSpheres), _radius(numSpheres),
+            _contained(numSpheres),
+            _resultMasks(numSpheres),
+            _numContained(0)
+        {
+            const float extent = 1000.0f;
+            for(unsigned int i=0; i<numSpheres; ++i)
+            {
+                _spheres[i].set(osg::Vec3(random(-extent,extent), random(-extent,extent), random(-1.0f,1.0f)), random(0.1f,1.0f));
+                _x[i] = _spheres[i].center().x();
+                _y[i] = _spheres[i].center().y();
+                _z[i] = _spheres[i].center().z();
+                _radius[i] = _spheres[i].radius();
+            }
+
+            osg::Matrixd projection = osg::Matrixd::perspective(60.0, 16.0/9.0, 1.0, 1000.0);
+            osg::Matrixd view = osg::Matrixd::lookAt(osg::Vec3d(0.0,-200.0,150.0), osg::Vec3d(0.0,0.0,0.0), osg::Vec3d(0.0,0.0,1.0));
+            _frustum.setToUnitFrustum(true, true);
+            _frustum.transformProvidingInverse(view*projection);
+        }
+
+        virtual void run()
+        {
+            if (_batched)
+            {
+                _numContained = _frustum.contains(static_cast<unsigned int>(_spheres.size()), &_x[0], &_y[0], &_z[0], &_radius[0], &_contained[0], &_resultMasks[0]);
+                return;
+            }
+
+            _numContained = 0;
+            for(unsigned int i=0; i<_spheres.size(); ++i)
+            {
+                if (_frustum.contains(_spheres[i])) ++_numContained;
+            }
+        }
+
+        virtual unsigned int getNumItems() const { return static_cast<unsigned int>(_spheres.size()); }
+
+    protected:
+
+        bool                                            _batched;
+        osg::Polytope                                   _frustum;
+        std::vector<osg::BoundingSphere>                _spheres;
+        std::vector<osg::BoundingSphere::value_type>    _x, _y, _z, _radius;
+        std::vector<unsigned char>                      _contained;
+        std::vector<osg::Polytope::ClippingMask>        _resultMasks;
+        unsigned int                                    _numContained;
+};
+
+class RemoveKdTreesVisitor : public osg::NodeVisitor
+{
+    public:
+
+        RemoveKdTreesVisitor(): osg::NodeVisitor(TRAVERSE_ALL_CHILDREN) {}
+
+        virtual void apply(osg::Geometry& geometry) { geometry.setShape(0); }
+};
+
+class BuildKdTreeOperation : public Operation
+{
+    public:
+
+        BuildKdTreeOperation(osg::Node* scene, const osg::KdTree::BuildOptions& buildOptions=osg::KdTree::BuildOptions()):
+            _scene(scene),
+            _buildOptions(buildOptions) {}
+
+        virtual void setUp()
+        {
+            RemoveKdTreesVisitor visitor;
+            _scene->accept(visitor);
+        }
+
+        virtual void run()
+        {
+            osg::ref_ptr<osg::KdTreeBuilder> builder = new osg::KdTreeBuilder;
+            builder->_buildOptions = _buildOptions;
+            _scene->accept(*builder);
+        }
+
+    protected:
+
+        osg::ref_ptr<osg::Node>     _scene;
+        osg::KdTree::BuildOptions   _buildOptions;
+};
+
+class IntersectOperation : public Operation
+{
+    public:
+
+        IntersectOperation(osg::Node* scene, unsigned int numRays, bool useKdTrees, const osg::KdTree::BuildOptions& buildOptions=osg::KdTree::BuildOptions()):
+            _scene(scene),
+            _useKdTrees(useKdTrees),
+            _buildOptions(buildOptions),
+            _numHits(0)
+        {
+            const osg::BoundingSphere& bs = scene->getBound();
+            for(unsigned int i=0; i<numRays; ++i)
+            {
+                osg::Vec3d position = bs.center()+osg::Vec3d(random(-0.7f,0.7f)*bs.radius(), random(-0.7f,0.7f)*bs.radius(), 0.0);
+                _starts.push_back(position+osg::Vec3d(0.0,0.0,bs.radius()));
+                _ends.push_back(position-osg::Vec3d(0.0,0.0,bs.radius()));
+            }
+        }
+
+        virtual void setUp()
+        {
+            RemoveKdTreesVisitor remove;
+            _scene->accept(remove);
+
+            if (_useKdTrees)
+            {
+                osg::ref_ptr<osg::KdTreeBuilder> builder = new osg::KdTreeBuilder;
+                builder->_buildOptions = _buildOptions;
+                _scene->accept(*builder);
+            }
+        }
+
+        virtual void run()
+        {
+            _numHits = 0;
+            for(unsigned int i=0; i<_starts.size(); ++i)
+            {
+                osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(_starts[i], _ends[i]);
+                osgUtil::IntersectionVisitor visitor(intersector.get());
+                visitor.setUseKdTreeWhenAvailable(_useKdTrees);
+                _scene->accept(visitor);
+                if (intersector->containsIntersections()) ++_numHits;
+            }
+        }
+
+        virtual unsigned int getNumItems() const { return static_cast<unsigned int>(_starts.size()); }
+
+    protected:
+
+        osg::ref_ptr<osg::Node>     _scene;
+        bool                        _useKdTrees;
+        osg::KdTree::BuildOptions   _buildOptions;
+        std::vector<osg::Vec3d>     _starts;
+        std::vector<osg::Vec3d>     _ends;
+        unsigned int                _numHits;
+};
+
+class OptimizerOperation : public Operation
+{
+    public:
+
+        OptimizerOperation(osg::Node* scene, unsigned int options,
+                           osgUtil::Optimizer::SpatializeGroupsVisitor::DivisionStrategy strategy=osgUtil::Optimizer::SpatializeGroupsVisitor::OCTREE):
+            _scene(scene),
+            _options(options),
+            _strategy(strategy) {}
+
+        virtual void setUp()
+        {
+            _copy = osg::clone(_scene.get(), osg::CopyOp::DEEP_COPY_ALL);
+        }
+
+        virtual void run()
+        {
+            osgUtil::Optimizer optimizer;
+            optimizer.setSpatializeGroupsStrategy(_strategy);
+            optimizer.optimize(_copy.get(), _options);
+        }
+
+    protected:
+
+        osg::ref_ptr<osg::Node> _scene;
+        osg::ref_ptr<osg::Node> _copy;
+        unsigned int            _options;
+        osgUtil::Optimizer::SpatializeGroupsVisitor::DivisionStrategy _strategy;
+};
+
+static osg::Node* createSpatializedCopy(osg::Node* scene, osgUtil::Optimizer::SpatializeGroupsVisitor::DivisionStrategy strategy)
+{
+    osg::Node* copy = osg::clone(scene, osg::CopyOp::DEEP_COPY_NODES);
+    osgUtil::Optimizer optimizer;
+    optimizer.setSpatializeGroupsStrategy(strategy);
+    optimizer.optimize(copy, osgUtil::Optimizer::SPATIALIZE_GROUPS);
+    return copy;
+}
+
+// Collects the timings that the gles pseudo plugin's stages report at INFO level, as "Info: <stage> timing: <seconds>s",
+// passing the warnings on to the handler it replaces.
+class StageTimingNotifyHandler : public osg::NotifyHandler
+{
+    public:
+
+        typedef std::map<std::string, double> StageTimes;
+
+        StageTimingNotifyHandler(osg::NotifyHandler* next): _next(next) {}
+
+        virtual void notify(osg::NotifySeverity severity, const char* message)
+        {
+            std::string str(message);
+            std::string::size_type begin = str.find("Info: ");
+            std::string::size_type end = str.rfind(" timing: ");
+            if (begin!=std::string::npos && end!=std::string::npos && end>begin)
+            {
+                // drop the arguments from labels such as "IndexMeshVisitor::apply(..)".
+                std::string stage = str.substr(begin+6, end-begin-6);
+                stage = stage.substr(0, stage.find('('));
+                _stageTimes[stage] += osg::asciiToDouble(str.c_str()+end+9)*1000.0;
+                return;
+            }
+
+            if (severity<=osg::WARN && _next.valid()) _next->notify(severity, message);
+        }
+
+        osg::NotifyHandler* getNext() { return _next.get(); }
+
+        const StageTimes& getStageTimes() const { return _stageTimes; }
+
+    protected:
+
+        osg::ref_ptr<osg::NotifyHandler>    _next;
+        StageTimes                          _stageTimes;
+};
+
+class WriteOperation : public Operation
+{
+    public:
+
+        typedef std::map< std::string, std::vector<double> > StageTimings;
+
+        WriteOperation(osg::Node* scene, const std::string& fileName, const std::string& optionString, bool collectStageTimings=false):
+            _scene(scene),
+            _fileName(fileName),
+            _options(new osgDB::Options(optionString)),
+            _collectStageTimings(collectStageTimings),
+            _succeeded(true) {}
+
+        virtual void setUp()
+        {
+            removeFiles();
+        }
+
+        virtual void run()
+        {
+            if (!_collectStageTimings)
+            {
+                _succeeded = osgDB::writeNodeFile(*_scene, _fileName, _options.get()) && _succeeded;
+                return;
+            }
+
+            osg::ref_ptr<StageTimingNotifyHandler> handler = new StageTimingNotifyHandler(osg::getNotifyHandler());
+            osg::NotifySeverity notifyLevel = osg::getNotifyLevel();
+            osg::setNotifyHandler(handler.get());
+            osg::setNotifyLevel(osg::INFO);
+
+            _succeeded = osgDB::writeNodeFile(*_scene, _fileName, _options.get()) && _succeeded;
+
+            osg::setNotifyLevel(notifyLevel);
+            osg::setNotifyHandler(handler->getNext());
+
+            const StageTimingNotifyHandler::StageTimes& stageTimes = handler->getStageTimes();
+            for(StageTimingNotifyHandler::StageTimes::const_iterator itr = stageTimes.begin(); itr != stageTimes.end(); ++itr)
+            {
+                _stageTimings[itr->first].push_back(itr->second);
+            }
+        }
+
+        bool succeeded() const { return _succeeded; }
+
+        StageTimings& getStageTimings() { return _stageTimings; }
+
+    protected:
+
+        virtual ~WriteOperation()
+        {
+            removeFiles();
+        }
+
+        void removeFiles()
+        {
+            // pseudo plugins such as gles write to the file name without their extension.
+            for(std::string fileName = _fileName; !osgDB::getFileExtension(fileName).empty(); fileName = osgDB::getNameLessExtension(fileName))
+            {
+                remove(fileName.c_str());
+            }
+        }
+
+        osg::ref_ptr<osg::Node>         _scene;
+        std::string                     _fileName;
+        osg::ref_ptr<osgDB::Options>    _options;
+        bool                            _collectStageTimings;
+        bool                            _succeeded;
+        StageTimings                    _stageTimings;
+};
+
+struct OptimizerPass
+{
+    unsigned int    options;
+    const char*     name;
+};
+
+static const OptimizerPass s_optimizerPasses[] =
+{
+    { osgUtil::Optimizer::STATIC_OBJECT_DETECTION, "STATIC_OBJECT_DETECTION" },
+    { osgUtil::Optimizer::TESSELLATE_GEOMETRY, "TESSELLATE_GEOMETRY" },
+    { osgUtil::Optimizer::REMOVE_LOADED_PROXY_NODES, "REMOVE_LOADED_PROXY_NODES" },
+    { osgUtil::Optimizer::COMBINE_ADJACENT_LODS, "COMBINE_ADJACENT_LODS" },
+    { osgUtil::Optimizer::OPTIMIZE_TEXTURE_SETTINGS, "OPTIMIZE_TEXTURE_SETTINGS" },
+    { osgUtil::Optimizer::SHARE_DUPLICATE_STATE, "SHARE_DUPLICATE_STATE" },
+    { osgUtil::Optimizer::TEXTURE_ATLAS_BUILDER, "TEXTURE_ATLAS_BUILDER" },
+    { osgUtil::Optimizer::COPY_SHARED_NODES, "COPY_SHARED_NODES" },
+    { osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS, "FLATTEN_STATIC_TRANSFORMS" },
+    { osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS, "FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS" },
+    { osgUtil::Optimizer::REMOVE_REDUNDANT_NODES, "REMOVE_REDUNDANT_NODES" },
+    { osgUtil::Optimizer::MERGE_GEODES, "MERGE_GEODES" },
+    { osgUtil::Optimizer::MAKE_FAST_GEOMETRY, "MAKE_FAST_GEOMETRY" },
+    { osgUtil::Optimizer::MERGE_GEOMETRY, "MERGE_GEOMETRY" },
+    { osgUtil::Optimizer::FLATTEN_BILLBOARDS, "FLATTEN_BILLBOARDS" },
+    { osgUtil::Optimizer::SPATIALIZE_GROUPS, "SPATIALIZE_GROUPS" },
+    { osgUtil::Optimizer::INDEX_MESH, "INDEX_MESH" },
+    { osgUtil::Optimizer::VERTEX_POSTTRANSFORM, "VERTEX_POSTTRANSFORM" },
+    { osgUtil::Optimizer::VERTEX_PRETRANSFORM, "VERTEX_PRETRANSFORM" },
+    { osgUtil::Optimizer::BUFFER_OBJECT_SETTINGS, "BUFFER_OBJECT_SETTINGS" },
+    { osgUtil::Optimizer::DEFAULT_OPTIMIZATIONS, "DEFAULT_OPTIMIZATIONS" }
+};
+
+// the plugins are looked up through the full extension chain, so both "gles" and "osgjs" have to be available for "x.osgjs.gles".
+static bool findPlugins(const std::string& fileName, std::string& missingExtension)
+{
+    std::string extensions = fileName;
+    while (!osgDB::getFileExtension(extensions).empty())
+    {
+        std::string ext = osgDB::getLowerCaseFileExtension(extensions);
+        if (!osgDB::Registry::instance()->getReaderWriterForExtension(ext))
+        {
+            missingExtension = ext;
+            return false;
+        }
+        extensions = osgDB::getNameLessExtension(extensions);
+    }
+    return true;
+}
+
+static void runWriteBenchmark(Harness& harness, const std::string& name, osg::Node* scene, const std::string& fileName, const std::string& optionString)
+{
+    if (!harness.selected(name)) return;
+
+    std::string missingExtension;
+    if (!findPlugins(fileName, missingExtension))
+    {
+        harness.skip(name, "no plugin for ."+missingExtension);
+        return;
+    }
+
+    osg::ref_ptr<WriteOperation> operation = new WriteOperation(scene, fileName, optionString);
+    harness.run(name, operation.get());
+    if (!operation->succeeded()) OSG_WARN<<"Warning: "<<name<<" failed to write "<<fileName<<std::endl;
+}
+
+// Time the stages of the gles pseudo plugin from the timings it reports, as "<name>/<stage>". These are separate iterations
+// from those of runWriteBenchmark() as reporting the timings at INFO level slows down the whole write.
+static void runWriteStagesBenchmark(Harness& harness, const std::string& name, osg::Node* scene, const std::string& fileName, const std::string& optionString)
+{
+    if (!harness.selected(name)) return;
+
+    std::string missingExtension;
+    if (!findPlugins(fileName, missingExtension))
+    {
+        harness.skip(name, "no plugin for ."+missingExtension);
+        return;
+    }
+
+    osg::ref_ptr<WriteOperation> operation = new WriteOperation(scene, fileName, optionString, true);
+
+    // one iteration to warm up, as Harness::run() does.
+    operation->setUp();
+    operation->run();
+    operation->getStageTimings().clear();
+
+    for(unsigned int i=0; i<harness.getNumIterations(); ++i)
+    {
+        operation->setUp();
+        operation->run();
+    }
+
+    const WriteOperation::StageTimings& stageTimings = operation->getStageTimings();
+    for(WriteOperation::StageTimings::const_iterator itr = stageTimings.begin(); itr != stageTimings.end(); ++itr)
+    {
+        harness.record(name+"/"+itr->first, itr->second, 1);
+    }
+}
+
+int main( int argc, char **argv )
+{
+    osg::ArgumentParser arguments(&argc,argv);
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" times scene graph traversal, cull, view frustum tests, intersection, optimizer and export on synthetic scenes, without requiring a GPU.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("--iterations <num>","Number of timed iterations of each benchmark, default 5.");
+    arguments.getApplicationUsage()->addCommandLineOption("--scale <factor>","Scale the size of the synthetic scenes, default 1.0.");
+    arguments.getApplicationUsage()->addCommandLineOption("--filter <substring>","Only run the benchmarks whose name contains the substring, can be given more than once.");
+    arguments.getApplicationUsage()->addCommandLineOption("--output <filename>","Write the results as JSON to the file, or to the console when the file name is -.");
+    arguments.getApplicationUsage()->addCommandLineOption("--temp-directory <path>","Directory the export benchmarks write their files to, default the current directory.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numIterations = 5;
+    double scale = 1.0;
+    std::string outputFileName;
+    std::string tempDirectory = ".";
+    std::vector<std::string> filters;
+    std::string filter;
+    while (arguments.read("--iterations", numIterations)) {}
+    while (arguments.read("--scale", scale)) {}
+    while (arguments.read("--output", outputFileName)) {}
+    while (arguments.read("--temp-directory", tempDirectory)) {}
+    while (arguments.read("--filter", filter)) { filters.push_back(filter); }
+
+    arguments.reportRemainingOptionsAsUnrecognized();
+    if (arguments.errors())
+    {
+        arguments.writeErrorMessages(std::cout);
+        return 1;
+    }
+
+    // notices written by the passes and plugins would distort their timings, so only report warnings unless asked otherwise.
+    if (!getenv("OSG_NOTIFY_LEVEL") && !getenv("OSGNOTIFYLEVEL")) osg::setNotifyLevel(osg::WARN);
+
+    // keep the console free for the JSON when it is written there.
+    bool writeToConsole = (outputFileName=="-");
+    std::ostream& logStream = writeToConsole ? std::cerr : std::cout;
+
+    srand(1);
+
+    unsigned int numDrawables = osg::maximum(1u, static_cast<unsigned int>(10000.0*scale));
+    unsigned int hierarchyDepth = osg::maximum(1u, static_cast<unsigned int>(14.0+log(scale)/log(2.0)+0.5));
+    unsigned int meshSize = osg::maximum(2u, static_cast<unsigned int>(512.0*sqrt(scale)));
+    unsigned int numBones = 32;
+    unsigned int numRings = osg::maximum(2u, static_cast<unsigned int>(1024.0*scale));
+    unsigned int numSpheres = osg::maximum(1u, static_cast<unsigned int>(50000.0*scale));
+
+    osg::ref_ptr<osg::Node> manyDrawables = createManyDrawables(numDrawables);
+    osg::ref_ptr<osg::Node> deepHierarchy = createDeepHierarchy(hierarchyDepth);
+    osg::ref_ptr<osg::Node> largeMesh = createLargeMesh(meshSize, meshSize);
+    std::vector<osgAnimation::StackedRotateAxisElement*> rotations;
+    osg::ref_ptr<osg::Node> skinnedMesh = createSkinnedMesh(numBones, numRings, 32, rotations);
+
+    struct Scene { const char* name; osg::Node* node; };
+    Scene scenes[] =
+    {
+        { "many_drawables", manyDrawables.get() },
+        { "deep_hierarchy", deepHierarchy.get() },
+        { "large_mesh", largeMesh.get() },
+        { "skinned_mesh", skinnedMesh.get() }
+    };
+    const unsigned int numScenes = sizeof(scenes)/sizeof(Scene);
+
+    Harness harness(logStream, numIterations, filters);
+
+    for(unsigned int i=0; i<numScenes; ++i)
+    {
+        harness.run(std::string("traversal/")+scenes[i].name, new TraversalOperation(scenes[i].node));
+    }
+
+    harness.run("update/skinned_mesh", new UpdateOperation(skinnedMesh.get(), rotations));
+
+    harness.run("cull/many_drawables", new CullOperation(manyDrawables.get()));
+    harness.run("cull/batched/many_drawables", new CullOperation(manyDrawables.get(), 32));
+    harness.run("cull/state_key/many_drawables", new CullOperation(manyDrawables.get(), 0, osgUtil::RenderBin::SORT_BY_STATE_KEY));
+    harness.run("cull/deep_hierarchy", new CullOperation(deepHierarchy.get()));
+
+    harness.run("polytope/contains/per_sphere", new PolytopeContainsOperation(numSpheres, false));
+    harness.run("polytope/contains/batched", new PolytopeContainsOperation(numSpheres, true));
+
+    osg::KdTree::BuildOptions sahOptions;
+    sahOptions._splitStrategy = osg::KdTree::SPLIT_SURFACE_AREA_HEURISTIC;
+    osg::KdTree::BuildOptions triangleLeafOptions = sahOptions;
+    triangleLeafOptions._triangleLeafLayout = true;
+
+    harness.run("kdtree/build/large_mesh", new BuildKdTreeOperation(largeMesh.get()));
+    harness.run("kdtree/build/sah/large_mesh", new BuildKdTreeOperation(largeMesh.get(), sahOptions));
+    harness.run("kdtree/build/sah_triangle_leaves/large_mesh", new BuildKdTreeOperation(largeMesh.get(), triangleLeafOptions));
+    harness.run("intersect/kdtree/large_mesh", new IntersectOperation(largeMesh.get(), 1000, true));
+    harness.run("intersect/kdtree/sah/large_mesh", new IntersectOperation(largeMesh.get(), 1000, true, sahOptions));
+    harness.run("intersect/kdtree/sah_triangle_leaves/large_mesh", new IntersectOperation(largeMesh.get(), 1000, true, triangleLeafOptions));
+    harness.run("intersect/brute_force/large_mesh", new IntersectOperation(largeMesh.get(), 10, false));
+
+    for(unsigned int i=0; i<sizeof(s_optimizerPasses)/sizeof(OptimizerPass); ++i)
+    {
+        const OptimizerPass& pass = s_optimizerPasses[i];
+        harness.run(std::string("optimizer/")+pass.name+"/many_drawables", new OptimizerOperation(manyDrawables.get(), pass.options));
+    }
+    // compare the cost of the spatialize groups strategies along with the cull traversal of the subgraphs they build.
+    harness.run("optimizer/SPATIALIZE_GROUPS/octree/many_drawables",
+                new OptimizerOperation(manyDrawables.get(), osgUtil::Optimizer::SPATIALIZE_GROUPS, osgUtil::Optimizer::SpatializeGroupsVisitor::OCTREE));
+    harness.run("optimizer/SPATIALIZE_GROUPS/bounding_volume_hierarchy/many_drawables",
+                new OptimizerOperation(manyDrawables.get(), osgUtil::Optimizer::SPATIALIZE_GROUPS, osgUtil::Optimizer::SpatializeGroupsVisitor::BOUNDING_VOLUME_HIERARCHY));
+    {
+        osg::ref_ptr<osg::Node> octree = createSpatializedCopy(manyDrawables.get(), osgUtil::Optimizer::SpatializeGroupsVisitor::OCTREE);
+        osg::ref_ptr<osg::Node> bvh = createSpatializedCopy(manyDrawables.get(), osgUtil::Optimizer::SpatializeGroupsVisitor::BOUNDING_VOLUME_HIERARCHY);
+        // the spatialized roots have larger bounding spheres, so both are viewed as the original scene is.
+        osg::ref_ptr<CullOperation> cullOctree = new CullOperation(octree.get());
+        cullOctree->setView(manyDrawables->getBound());
+        harness.run("cull/spatialized/octree/many_drawables", cullOctree.get());
+
+        osg::ref_ptr<CullOperation> cullBVH = new CullOperation(bvh.get());
+        cullBVH->setView(manyDrawables->getBound());
+        harness.run("cull/spatialized/bounding_volume_hierarchy/many_drawables", cullBVH.get());
+    }
+    harness.run("optimizer/INDEX_MESH/large_mesh", new OptimizerOperation(largeMesh.get(), osgUtil::Optimizer::INDEX_MESH));
+    harness.run("optimizer/VERTEX_POSTTRANSFORM/large_mesh", new OptimizerOperation(largeMesh.get(), osgUtil::Optimizer::VERTEX_POSTTRANSFORM));
+    harness.run("optimizer/VERTEX_PRETRANSFORM/large_mesh", new OptimizerOperation(largeMesh.get(), osgUtil::Optimizer::VERTEX_PRETRANSFORM));
+
+    // the gles pseudo plugin optimizes a clone of the scene then hands it on to the osgjs writer, so its timings include the export/osgjs ones,
+    // its stages being timed separately.
+    std::string osgjsFileName = osgDB::concatPaths(tempDirectory, "osgbenchmark.osgjs");
+    runWriteBenchmark(harness, "export/osgjs/many_drawables", manyDrawables.get(), osgjsFileName, "");
+    runWriteBenchmark(harness, "export/osgjs/large_mesh", largeMesh.get(), osgjsFileName, "");
+    runWriteBenchmark(harness, "gles/geometry/many_drawables", manyDrawables.get(), osgjsFileName+".gles", "glesMode=geometry");
+    runWriteBenchmark(harness, "gles/geometry/large_mesh", largeMesh.get(), osgjsFileName+".gles", "glesMode=geometry");
+    runWriteBenchmark(harness, "gles/all/skinned_mesh", skinnedMesh.get(), osgjsFileName+".gles", "glesMode=all");
+    runWriteStagesBenchmark(harness, "gles/stages/geometry/large_mesh", largeMesh.get(), osgjsFileName+".gles", "glesMode=geometry");
+    runWriteStagesBenchmark(harness, "gles/stages/all/skinned_mesh", skinnedMesh.get(), osgjsFileName+".gles", "glesMode=all");
+
+    if (writeToConsole)
+    {
+        writeJSON(std::cout, harness.getResults(), numIterations, scale);
+    }
+    else if (!outputFileName.empty())
+    {
+        std::ofstream fout(outputFileName.c_str());
+        if (!fout)
+        {
+            OSG_WARN<<"Error: could not open "<<outputFileName<<" to write the results to."<<std::endl;
+            return 1;
+        }
+        writeJSON(fout, harness.getResults(), numIterations, scale);
+    }
+
+    return 0;
+}
@@ -29,6 +29,11 @@ CullStack::CullStack()
     _index_modelviewCullingStack = 0;
     _back_modelviewCullingStack = 0;
 
+    _batchCullNode = 0;
+    _batchCullIndex = 0;
+    _batchCullInsideFrustum = true;
+    _batchCullResultMask = 0;
+
     _referenceViewPoints.push_back(osg::Vec3(0.0f,0.0f,0.0f));
 }
 
@@ -44,6 +49,11 @@ CullStack::CullStack(const CullStack& cs):
     _index_modelviewCullingStack = 0;
     _back_modelviewCullingStack = 0;
 
+    _batchCullNode = 0;
+    _batchCullIndex = 0;
+    _batchCullInsideFrustum = true;
+    _batchCullResultMask = 0;
+
     _referenceViewPoints.push_back(osg::Vec3(0.0f,0.0f,0.0f));
 }
 
@@ -76,6 +86,7 @@ void CullStack::reset()
     //_modelviewCullingStack.clear();
     _index_modelviewCullingStack=0;
     _back_modelviewCullingStack = 0;
+    _batchCullNode = 0;
 
     osg::Vec3 lookVector(0.0,0.0,-1.0);
 
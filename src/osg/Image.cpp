@@ -14,6 +14,7 @@
 #include <osg/GLU>
 
 #include <osg/Image>
+#include <osg/ImageUtils>
 #include <osg/Notify>
 #include <osg/io_utils>
 
@@ -1543,6 +1544,23 @@ void Image::scaleImage(int s,int t,int r, GLenum newDataType)
         return;
     }
 
+    if (newDataType==_dataType)
+    {
+        // use the multi-threaded resampler for the formats it supports, falling back to gluScaleImage
+        osg::ref_ptr<osg::Image> newImage = new osg::Image;
+        newImage->setImage(s, t, r, _internalTextureFormat, _pixelFormat, _dataType, newData, NO_DELETE, _packing);
+        if (osg::resampleImage(this, newImage.get(), osg::RESAMPLE_TRIANGLE))
+        {
+            _s = s;
+            _t = t;
+            _rowLength = 0;
+            setData(newData,USE_NEW_DELETE);
+
+            dirty();
+            return;
+        }
+    }
+
     PixelStorageModes psm;
     psm.pack_alignment = _packing;
     psm.pack_row_length = _rowLength;
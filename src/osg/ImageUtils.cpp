@@ -16,6 +16,7 @@
 
 #include <osg/Math>
 #include <osg/ImageUtils>
+#include <osg/ParallelFor>
 #include <osg/Texture>
 
 #include <osg/Notify>
@@ -797,5 +798,510 @@ OSG_EXPORT osg::Image* createImageWithOrientationConversion(const osg::Image* sr
     return dstImage.release();
 }
 
+namespace
+{
+
+inline float boxFilter(float x) { return (x>=-0.5f && x<0.5f) ? 1.0f : 0.0f; }
+
+inline float triangleFilter(float x) { x = fabsf(x); return x<1.0f ? 1.0f-x : 0.0f; }
+
+inline float sinc(float x)
+{
+    if (x==0.0f) return 1.0f;
+    x *= osg::PIf;
+    return sinf(x)/x;
+}
+
+inline float lanczos3Filter(float x) { return fabsf(x)<3.0f ? sinc(x)*sinc(x/3.0f) : 0.0f; }
+
+// Mitchell-Netravali cubic with B = C = 1/3
+inline float mitchellFilter(float x)
+{
+    const float B = 1.0f/3.0f, C = 1.0f/3.0f;
+    x = fabsf(x);
+    if (x<1.0f) return ((12.0f-9.0f*B-6.0f*C)*x*x*x + (-18.0f+12.0f*B+6.0f*C)*x*x + (6.0f-2.0f*B))/6.0f;
+    if (x<2.0f) return ((-B-6.0f*C)*x*x*x + (6.0f*B+30.0f*C)*x*x + (-12.0f*B-48.0f*C)*x + (8.0f*B+24.0f*C))/6.0f;
+    return 0.0f;
+}
+
+inline float evaluateFilter(ResampleFilter filter, float x)
+{
+    switch(filter)
+    {
+        case(RESAMPLE_BOX): return boxFilter(x);
+        case(RESAMPLE_LANCZOS3): return lanczos3Filter(x);
+        case(RESAMPLE_MITCHELL): return mitchellFilter(x);
+        default: return triangleFilter(x);
+    }
+}
+
+inline float filterRadius(ResampleFilter filter)
+{
+    switch(filter)
+    {
+        case(RESAMPLE_BOX): return 0.5f;
+        case(RESAMPLE_LANCZOS3): return 3.0f;
+        case(RESAMPLE_MITCHELL): return 2.0f;
+        default: return 1.0f;
+    }
+}
+
+// Normalized weights of the source pixels contributing to each destination pixel along one axis,
+// stored with a fixed stride of _maxTaps weights per destination pixel.
+struct ResampleWeights
+{
+    ResampleWeights(unsigned int srcSize, unsigned int dstSize, ResampleFilter filter):
+        _maxTaps(0)
+    {
+        // an empty axis has no weights, and would otherwise give an infinite filter support
+        if (srcSize==0 || dstSize==0) return;
+
+        float scale = float(dstSize)/float(srcSize);
+
+        // widen the filter when minifying so every source pixel contributes
+        float filterScale = osg::minimum(scale, 1.0f);
+        float support = filterRadius(filter)/filterScale;
+
+        _maxTaps = static_cast<unsigned int>(ceilf(support*2.0f))+3;
+        _first.resize(dstSize);
+        _count.resize(dstSize);
+        _weights.resize(dstSize*_maxTaps, 0.0f);
+
+        for(unsigned int i=0; i<dstSize; ++i)
+        {
+            float center = (float(i)+0.5f)/scale;
+            int first = osg::maximum(static_cast<int>(floorf(center-support)), 0);
+            int last = osg::minimum(static_cast<int>(ceilf(center+support)), static_cast<int>(srcSize)-1);
+
+            float* weights = &_weights[i*_maxTaps];
+            float total = 0.0f;
+            for(int j=first; j<=last; ++j)
+            {
+                float w = evaluateFilter(filter, (float(j)+0.5f-center)*filterScale);
+                weights[j-first] = w;
+                total += w;
+            }
+
+            if (total!=0.0f)
+            {
+                for(int j=first; j<=last; ++j) weights[j-first] /= total;
+            }
+            else
+            {
+                // fall back to the nearest source pixel
+                first = osg::minimum(static_cast<int>(center), static_cast<int>(srcSize)-1);
+                last = first;
+                weights[0] = 1.0f;
+            }
+
+            _first[i] = first;
+            _count[i] = last-first+1;
+        }
+    }
+
+    unsigned int        _maxTaps;
+    std::vector<int>    _first;
+    std::vector<int>    _count;
+    std::vector<float>  _weights;
+};
+
+inline float sRGBToLinear(float v) { return v<=0.04045f ? v/12.92f : powf((v+0.055f)/1.055f, 2.4f); }
+
+inline float linearToSRGB(float v) { return v<=0.0031308f ? v*12.92f : 1.055f*powf(v, 1.0f/2.4f)-0.055f; }
+
+// Conversions between the stored components and the normalized floats being filtered.
+struct ResampleConverter
+{
+    enum { LINEAR_TO_SRGB_SIZE = 4096 };
+
+    ResampleConverter(GLenum pixelFormat, bool sRGB):
+        _numComponents(osg::Image::computeNumComponents(pixelFormat))
+    {
+        for(unsigned int i=0; i<256; ++i)
+        {
+            _linearFromUByte[i] = float(i)/255.0f;
+            _sRGBFromUByte[i] = sRGBToLinear(float(i)/255.0f);
+        }
+
+        for(unsigned int i=0; i<LINEAR_TO_SRGB_SIZE; ++i)
+        {
+            _sRGBToUByte[i] = static_cast<unsigned char>(linearToSRGB(float(i)/float(LINEAR_TO_SRGB_SIZE-1))*255.0f+0.5f);
+        }
+
+        int alphaComponent = -1;
+        switch(pixelFormat)
+        {
+            case(GL_ALPHA): alphaComponent = 0; break;
+            case(GL_LUMINANCE_ALPHA): alphaComponent = 1; break;
+            case(GL_RGBA): alphaComponent = 3; break;
+            case(GL_BGRA): alphaComponent = 3; break;
+            default: break;
+        }
+
+        for(unsigned int c=0; c<4; ++c)
+        {
+            _isSRGB[c] = sRGB && static_cast<int>(c)!=alphaComponent;
+        }
+    }
+
+    inline const float* lookupTable(unsigned int c) const { return _isSRGB[c] ? _sRGBFromUByte : _linearFromUByte; }
+
+    inline void accumulate(const unsigned char* src, float w, float* dst, unsigned int num) const
+    {
+        for(unsigned int c=0; c<_numComponents; ++c)
+        {
+            const float* lut = lookupTable(c);
+            for(unsigned int i=c; i<num; i+=_numComponents) dst[i] += w*lut[src[i]];
+        }
+    }
+
+    inline void accumulate(const unsigned short* src, float w, float* dst, unsigned int num) const
+    {
+        w /= 65535.0f;
+        for(unsigned int i=0; i<num; ++i) dst[i] += w*float(src[i]);
+    }
+
+    inline void accumulate(const float* src, float w, float* dst, unsigned int num) const
+    {
+        for(unsigned int i=0; i<num; ++i) dst[i] += w*src[i];
+    }
+
+    inline void store(float v, unsigned int c, unsigned char& dst) const
+    {
+        v = osg::clampBetween(v, 0.0f, 1.0f);
+        dst = _isSRGB[c] ? _sRGBToUByte[static_cast<unsigned int>(v*float(LINEAR_TO_SRGB_SIZE-1)+0.5f)] :
+                           static_cast<unsigned char>(v*255.0f+0.5f);
+    }
+
+    inline void store(float v, unsigned int, unsigned short& dst) const
+    {
+        dst = static_cast<unsigned short>(osg::clampBetween(v, 0.0f, 1.0f)*65535.0f+0.5f);
+    }
+
+    inline void store(float v, unsigned int, float& dst) const { dst = v; }
+
+    unsigned int    _numComponents;
+    bool            _isSRGB[4];
+    float           _linearFromUByte[256];
+    float           _sRGBFromUByte[256];
+    unsigned char   _sRGBToUByte[LINEAR_TO_SRGB_SIZE];
+};
+
+// Resamples a range of destination rows, first filtering the contributing source rows vertically
+// into a single row of floats then filtering that row horizontally into the destination.
+template<typename T>
+struct ResampleRows : public osg::ParallelForFunctor
+{
+    ResampleRows(const osg::Image* srcImage, osg::Image* destImage, const ResampleWeights& rowWeights,
+                 const ResampleWeights& columnWeights, const ResampleConverter& converter):
+        _srcImage(srcImage),
+        _destImage(destImage),
+        _rowWeights(rowWeights),
+        _columnWeights(columnWeights),
+        _converter(converter) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        unsigned int numComponents = _converter._numComponents;
+        unsigned int srcRowSize = _srcImage->s()*numComponents;
+        std::vector<float> row(srcRowSize);
+
+        for(unsigned int t=begin; t<end; ++t)
+        {
+            std::fill(row.begin(), row.end(), 0.0f);
+
+            const float* weights = &_rowWeights._weights[t*_rowWeights._maxTaps];
+            for(int i=0; i<_rowWeights._count[t]; ++i)
+            {
+                const T* src = reinterpret_cast<const T*>(_srcImage->data(0, _rowWeights._first[t]+i));
+                _converter.accumulate(src, weights[i], &row[0], srcRowSize);
+            }
+
+            T* dst = reinterpret_cast<T*>(_destImage->data(0, t));
+            for(int s=0; s<_destImage->s(); ++s)
+            {
+                const float* columnWeights = &_columnWeights._weights[s*_columnWeights._maxTaps];
+                const float* src = &row[_columnWeights._first[s]*numComponents];
+                int count = _columnWeights._count[s];
+                for(unsigned int c=0; c<numComponents; ++c)
+                {
+                    float v = 0.0f;
+                    for(int i=0; i<count; ++i) v += columnWeights[i]*src[i*numComponents+c];
+                    _converter.store(v, c, *dst++);
+                }
+            }
+        }
+    }
+
+    const osg::Image*           _srcImage;
+    osg::Image*                 _destImage;
+    const ResampleWeights&      _rowWeights;
+    const ResampleWeights&      _columnWeights;
+    const ResampleConverter&    _converter;
+};
+
+}
+
+bool resampleImage(const osg::Image* srcImage, osg::Image* destImage, ResampleFilter filter, bool sRGB)
+{
+    if (!srcImage || !destImage || !srcImage->data() || !destImage->data()) return false;
+    if (srcImage->isCompressed() || srcImage->r()!=1 || destImage->r()!=1) return false;
+    if (srcImage->s()==0 || srcImage->t()==0 || destImage->s()==0 || destImage->t()==0) return false;
+    if (srcImage->getPixelFormat()!=destImage->getPixelFormat() || srcImage->getDataType()!=destImage->getDataType()) return false;
+
+    switch(srcImage->getPixelFormat())
+    {
+        case(GL_ALPHA):
+        case(GL_LUMINANCE):
+        case(GL_INTENSITY):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_RED):
+        case(GL_RG):
+        case(GL_RGB):
+        case(GL_BGR):
+        case(GL_RGBA):
+        case(GL_BGRA):
+            break;
+        default:
+            return false;
+    }
+
+    ResampleWeights rowWeights(srcImage->t(), destImage->t(), filter);
+    ResampleWeights columnWeights(srcImage->s(), destImage->s(), filter);
+    ResampleConverter converter(srcImage->getPixelFormat(), sRGB);
+
+    const unsigned int grainSize = 16;
+    switch(srcImage->getDataType())
+    {
+        case(GL_UNSIGNED_BYTE):
+        {
+            ResampleRows<unsigned char> resampleRows(srcImage, destImage, rowWeights, columnWeights, converter);
+            osg::parallelFor(destImage->t(), resampleRows, grainSize);
+            break;
+        }
+        case(GL_UNSIGNED_SHORT):
+        {
+            ResampleRows<unsigned short> resampleRows(srcImage, destImage, rowWeights, columnWeights, converter);
+            osg::parallelFor(destImage->t(), resampleRows, grainSize);
+            break;
+        }
+        case(GL_FLOAT):
+        {
+            ResampleRows<float> resampleRows(srcImage, destImage, rowWeights, columnWeights, converter);
+            osg::parallelFor(destImage->t(), resampleRows, grainSize);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    destImage->dirty();
+    return true;
+}
+
+bool generateMipmaps(osg::Image* image, ResampleFilter filter, bool sRGB)
+{
+    if (!image || !image->data() || image->isCompressed() || image->r()!=1) return false;
+
+    int numLevels = osg::Image::computeNumberOfMipmapLevels(image->s(), image->t());
+
+    osg::Image::MipmapDataType mipmapData;
+    unsigned int totalSize = 0;
+    for(int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapData.push_back(totalSize);
+        totalSize += osg::Image::computeImageSizeInBytes(osg::maximum(image->s()>>level, 1), osg::maximum(image->t()>>level, 1), 1,
+                                                         image->getPixelFormat(), image->getDataType(), image->getPacking());
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    // copy the base level, dropping any row length
+    unsigned int rowSize = image->getRowSizeInBytes();
+    for(int row=0; row<image->t(); ++row)
+    {
+        memcpy(data+row*rowSize, image->data(0, row), rowSize);
+    }
+
+    osg::ref_ptr<osg::Image> previousLevel = new osg::Image;
+    previousLevel->setImage(image->s(), image->t(), 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+                            data, osg::Image::NO_DELETE, image->getPacking());
+
+    for(int level=1; level<numLevels; ++level)
+    {
+        osg::ref_ptr<osg::Image> currentLevel = new osg::Image;
+        currentLevel->setImage(osg::maximum(image->s()>>level, 1), osg::maximum(image->t()>>level, 1), 1,
+                               image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+                               data+mipmapData[level-1], osg::Image::NO_DELETE, image->getPacking());
+
+        if (!resampleImage(previousLevel.get(), currentLevel.get(), filter, sRGB))
+        {
+            delete [] data;
+            return false;
+        }
+
+        previousLevel = currentLevel;
+    }
+
+    image->setImage(image->s(), image->t(), 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+                    data, osg::Image::USE_NEW_DELETE, image->getPacking());
+    image->setMipmapLevels(mipmapData);
+
+    return true;
+}
+
+namespace
+{
+
+inline void expandToRGBA(GLenum pixelFormat, const unsigned char* src, unsigned char* rgba)
+{
+    switch(pixelFormat)
+    {
+        case(GL_RGBA): rgba[0] = src[0]; rgba[1] = src[1]; rgba[2] = src[2]; rgba[3] = src[3]; break;
+        case(GL_BGRA): rgba[0] = src[2]; rgba[1] = src[1]; rgba[2] = src[0]; rgba[3] = src[3]; break;
+        case(GL_RGB): rgba[0] = src[0]; rgba[1] = src[1]; rgba[2] = src[2]; rgba[3] = 255; break;
+        case(GL_BGR): rgba[0] = src[2]; rgba[1] = src[1]; rgba[2] = src[0]; rgba[3] = 255; break;
+        case(GL_LUMINANCE): rgba[0] = rgba[1] = rgba[2] = src[0]; rgba[3] = 255; break;
+        case(GL_LUMINANCE_ALPHA): rgba[0] = rgba[1] = rgba[2] = src[0]; rgba[3] = src[1]; break;
+        case(GL_INTENSITY): rgba[0] = rgba[1] = rgba[2] = rgba[3] = src[0]; break;
+        case(GL_ALPHA): rgba[0] = rgba[1] = rgba[2] = 0; rgba[3] = src[0]; break;
+        case(GL_RED): rgba[0] = src[0]; rgba[1] = rgba[2] = 0; rgba[3] = 255; break;
+        case(GL_RG): rgba[0] = src[0]; rgba[1] = src[1]; rgba[2] = 0; rgba[3] = 255; break;
+        default: break;
+    }
+}
+
+// Encodes a range of block rows of one level, replicating the edge pixels into partial blocks.
+struct CompressBlockRows : public osg::ParallelForFunctor
+{
+    CompressBlockRows(const unsigned char* src, int s, int t, unsigned int rowStep, GLenum pixelFormat,
+                      unsigned char* dst, GLenum compressedFormat):
+        _src(src),
+        _s(s),
+        _t(t),
+        _rowStep(rowStep),
+        _pixelSize(osg::Image::computeNumComponents(pixelFormat)),
+        _pixelFormat(pixelFormat),
+        _dst(dst),
+        _compressedFormat(compressedFormat),
+        _blockSize(osg::Image::computeBlockSize(compressedFormat, 0)) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        unsigned int numBlockColumns = (_s+3)/4;
+        unsigned char rgba[64];
+
+        for(unsigned int blockRow=begin; blockRow<end; ++blockRow)
+        {
+            unsigned char* dst = _dst + blockRow*numBlockColumns*_blockSize;
+            for(unsigned int blockColumn=0; blockColumn<numBlockColumns; ++blockColumn, dst+=_blockSize)
+            {
+                for(int j=0; j<4; ++j)
+                {
+                    int row = osg::minimum(static_cast<int>(blockRow*4)+j, _t-1);
+                    for(int i=0; i<4; ++i)
+                    {
+                        int column = osg::minimum(static_cast<int>(blockColumn*4)+i, _s-1);
+                        expandToRGBA(_pixelFormat, _src + row*_rowStep + column*_pixelSize, rgba + (j*4+i)*4);
+                    }
+                }
+
+                switch(_compressedFormat)
+                {
+                    case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT): dxtc_tool::compressBlockDXT1(rgba, dst, false); break;
+                    case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT): dxtc_tool::compressBlockDXT1(rgba, dst, true); break;
+                    case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT): dxtc_tool::compressBlockDXT5(rgba, dst); break;
+                    case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+                        dxtc_tool::compressBlockRGTC1(rgba, 4, dst);
+                        dxtc_tool::compressBlockRGTC1(rgba+1, 4, dst+8);
+                        break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    const unsigned char*    _src;
+    int                     _s;
+    int                     _t;
+    unsigned int            _rowStep;
+    unsigned int            _pixelSize;
+    GLenum                  _pixelFormat;
+    unsigned char*          _dst;
+    GLenum                  _compressedFormat;
+    unsigned int            _blockSize;
+};
+
+}
+
+osg::Image* compressImage(const osg::Image* image, GLenum compressedFormat)
+{
+    if (!image || !image->data() || image->isCompressed() || image->r()!=1 || image->getDataType()!=GL_UNSIGNED_BYTE) return 0;
+
+    switch(image->getPixelFormat())
+    {
+        case(GL_RGBA):
+        case(GL_BGRA):
+        case(GL_RGB):
+        case(GL_BGR):
+        case(GL_LUMINANCE):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_INTENSITY):
+        case(GL_ALPHA):
+        case(GL_RED):
+        case(GL_RG):
+            break;
+        default:
+            return 0;
+    }
+
+    switch(compressedFormat)
+    {
+        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):
+        case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT):
+        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+            break;
+        default:
+            return 0;
+    }
+
+    unsigned int numLevels = image->getNumMipmapLevels();
+
+    osg::Image::MipmapDataType mipmapData;
+    unsigned int totalSize = 0;
+    for(unsigned int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapData.push_back(totalSize);
+        totalSize += osg::Image::computeImageSizeInBytes(osg::maximum(image->s()>>level, 1), osg::maximum(image->t()>>level, 1), 1,
+                                                         compressedFormat, GL_UNSIGNED_BYTE, 1);
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    for(unsigned int level=0; level<numLevels; ++level)
+    {
+        int s = osg::maximum(image->s()>>level, 1);
+        int t = osg::maximum(image->t()>>level, 1);
+
+        // the base level may have a row length, mipmap levels are tightly packed rows
+        const unsigned char* src = image->getMipmapData(level);
+        unsigned int rowStep = level==0 ? image->getRowStepInBytes() :
+                                          osg::Image::computeRowWidthInBytes(s, image->getPixelFormat(), image->getDataType(), image->getPacking());
+
+        CompressBlockRows compressBlockRows(src, s, t, rowStep, image->getPixelFormat(),
+                                            data + (level==0 ? 0 : mipmapData[level-1]), compressedFormat);
+        osg::parallelFor((t+3)/4, compressBlockRows, 4);
+    }
+
+    osg::Image* compressedImage = new osg::Image;
+    compressedImage->setImage(image->s(), image->t(), 1, compressedFormat, compressedFormat, GL_UNSIGNED_BYTE,
+                              data, osg::Image::USE_NEW_DELETE, 1);
+    compressedImage->setMipmapLevels(mipmapData);
+    compressedImage->setOrigin(image->getOrigin());
+    compressedImage->setFileName(image->getFileName());
+
+    return compressedImage;
 }
 
+}
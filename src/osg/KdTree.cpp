@@ -16,9 +16,15 @@
 #include <osg/TriangleIndexFunctor>
 #include <osg/TemplatePrimitiveIndexFunctor>
 #include <osg/Timer>
+#include <osg/ParallelFor>
+#include <osg/SurfaceAreaHeuristic>
 
 #include <osg/io_utils>
 
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+
 using namespace osg;
 
 //#define VERBOSE_OUTPUT
@@ -31,24 +37,57 @@ using namespace osg;
 struct BuildKdTree
 {
     BuildKdTree(KdTree& kdTree):
-        _kdTree(kdTree) {}
+        _kdTree(kdTree),
+        _collectBounds(false) {}
 
     typedef std::vector< osg::Vec3 >            CenterList;
+    typedef std::vector< osg::BoundingBox >     BoundsList;
     typedef std::vector< unsigned int >           Indices;
     typedef std::vector< unsigned int >         AxisStack;
 
+    // a subtree whose construction has been deferred so that it can be built in parallel
+    struct Subtree
+    {
+        Subtree(int ni, unsigned int b, unsigned int e, unsigned int l):
+            nodeIndex(ni), begin(b), end(e), level(l) {}
+
+        int                 nodeIndex;
+        unsigned int        begin;
+        unsigned int        end;
+        unsigned int        level;
+        KdTree::KdNodeList  nodes;
+    };
+    typedef std::vector< Subtree > Subtrees;
+
     bool build(KdTree::BuildOptions& options, osg::Geometry* geometry);
 
+    inline void addPrimitive(const osg::BoundingBox& bb)
+    {
+        _primitiveIndices.push_back(_centers.size());
+        _centers.push_back(bb.center());
+        if (_collectBounds) _bounds.push_back(bb);
+    }
+
     void computeDivisions(KdTree::BuildOptions& options);
 
     int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
 
+    void buildSAH(KdTree::BuildOptions& options);
+
+    int divideSAH(KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, unsigned int begin, unsigned int end, unsigned int level, Subtrees* subtrees, unsigned int parallelThreshold);
+
+    void reorderVertexIndices();
+
+    bool buildTriangles();
+
     KdTree&             _kdTree;
 
     osg::BoundingBox    _bb;
     AxisStack           _axisStack;
     Indices             _primitiveIndices;
     CenterList          _centers;
+    bool                _collectBounds;
+    BoundsList          _bounds;
 
 protected:
 
@@ -72,8 +111,7 @@ struct PrimitiveIndicesCollector
         osg::BoundingBox bb;
         bb.expandBy(v0);
 
-        _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
-        _buildKdTree->_centers.push_back(bb.center());
+        _buildKdTree->addPrimitive(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1)
@@ -96,8 +134,7 @@ struct PrimitiveIndicesCollector
         bb.expandBy(v0);
         bb.expandBy(v1);
 
-        _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
-        _buildKdTree->_centers.push_back(bb.center());
+        _buildKdTree->addPrimitive(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2)
@@ -123,8 +160,7 @@ struct PrimitiveIndicesCollector
         bb.expandBy(v1);
         bb.expandBy(v2);
 
-        _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
-        _buildKdTree->_centers.push_back(bb.center());
+        _buildKdTree->addPrimitive(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
@@ -152,8 +188,7 @@ struct PrimitiveIndicesCollector
         bb.expandBy(v2);
         bb.expandBy(v3);
 
-        _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
-        _buildKdTree->_centers.push_back(bb.center());
+        _buildKdTree->addPrimitive(bb);
     }
 
     BuildKdTree* _buildKdTree;
@@ -188,7 +223,8 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
 
     _kdTree.getNodes().reserve(estimatedSize*5);
 
-    computeDivisions(options);
+    bool useSAH = options._splitStrategy==KdTree::SPLIT_SURFACE_AREA_HEURISTIC;
+    if (!useSAH) computeDivisions(options);
 
     options._numVerticesProcessed += vertices->size();
 
@@ -196,19 +232,30 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     _primitiveIndices.reserve(estimatedNumTriangles);
     _centers.reserve(estimatedNumTriangles);
 
+    _collectBounds = useSAH;
+    if (_collectBounds) _bounds.reserve(estimatedNumTriangles);
+
     osg::TemplatePrimitiveIndexFunctor<PrimitiveIndicesCollector> collectIndices;
     collectIndices._buildKdTree = this;
     geometry->accept(collectIndices);
 
-    _primitiveIndices.reserve(vertices->size());
+    int nodeNum = 0;
+    if (useSAH)
+    {
+        buildSAH(options);
+    }
+    else
+    {
+        _primitiveIndices.reserve(vertices->size());
 
-    KdTree::KdNode node(-1, _primitiveIndices.size());
-    node.bb = _bb;
+        KdTree::KdNode node(-1, _primitiveIndices.size());
+        node.bb = _bb;
 
-    int nodeNum = _kdTree.addNode(node);
+        nodeNum = _kdTree.addNode(node);
 
-    osg::BoundingBox bb = _bb;
-    nodeNum = divide(options, bb, nodeNum, 0);
+        osg::BoundingBox bb = _bb;
+        nodeNum = divide(options, bb, nodeNum, 0);
+    }
 
     osg::KdTree::Indices& primitiveIndices = _kdTree.getPrimitiveIndices();
 
@@ -222,6 +269,8 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     }
     primitiveIndices.swap(new_indices);
 
+    if (useSAH && !(options._triangleLeafLayout && buildTriangles())) reorderVertexIndices();
+
 
 #ifdef VERBOSE_OUTPUT
     OSG_NOTICE<<"Root nodeNum="<<nodeNum<<std::endl;
@@ -469,6 +518,168 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
 }
 
+namespace
+{
+
+inline void expandByEpsilon(osg::BoundingBox& bb)
+{
+    if (bb.valid())
+    {
+        float epsilon = 1e-6f;
+        bb._min -= osg::Vec3(epsilon, epsilon, epsilon);
+        bb._max += osg::Vec3(epsilon, epsilon, epsilon);
+    }
+}
+
+struct BuildSubtrees : public osg::ParallelForFunctor
+{
+    BuildSubtrees(BuildKdTree& buildKdTree, KdTree::BuildOptions& options, BuildKdTree::Subtrees& subtrees):
+        _buildKdTree(buildKdTree),
+        _options(options),
+        _subtrees(subtrees) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            BuildKdTree::Subtree& subtree = _subtrees[i];
+            _buildKdTree.divideSAH(_options, subtree.nodes, subtree.begin, subtree.end, subtree.level, 0, 0);
+        }
+    }
+
+    BuildKdTree&                _buildKdTree;
+    KdTree::BuildOptions&       _options;
+    BuildKdTree::Subtrees&      _subtrees;
+};
+
+}
+
+void BuildKdTree::buildSAH(KdTree::BuildOptions& options)
+{
+    KdTree::KdNodeList& nodes = _kdTree.getNodes();
+    unsigned int numPrimitives = _primitiveIndices.size();
+
+    unsigned int numThreads = std::max(OpenThreads::GetNumberOfProcessors(), 1);
+    unsigned int parallelThreshold = SurfaceAreaHeuristicSplit::computeParallelSubtreeSize(numPrimitives, numThreads, 4096);
+
+    Subtrees subtrees;
+    divideSAH(options, nodes, 0, numPrimitives, 0, parallelThreshold>0 ? &subtrees : 0, parallelThreshold);
+
+    if (subtrees.empty()) return;
+
+    BuildSubtrees buildSubtrees(*this, options, subtrees);
+    osg::parallelFor(subtrees.size(), buildSubtrees, 1, numThreads);
+
+    // append each subtree, its local root replacing the placeholder node and its other nodes being renumbered
+    for(Subtrees::iterator itr = subtrees.begin();
+        itr != subtrees.end();
+        ++itr)
+    {
+        int offset = static_cast<int>(nodes.size())-1;
+        for(KdTree::KdNodeList::iterator nitr = itr->nodes.begin();
+            nitr != itr->nodes.end();
+            ++nitr)
+        {
+            if (nitr->first>0) nitr->first += offset;
+            if (nitr->second>0) nitr->second += offset;
+        }
+
+        nodes[itr->nodeIndex] = itr->nodes.front();
+        nodes.insert(nodes.end(), itr->nodes.begin()+1, itr->nodes.end());
+    }
+}
+
+int BuildKdTree::divideSAH(KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, unsigned int begin, unsigned int end, unsigned int level, Subtrees* subtrees, unsigned int parallelThreshold)
+{
+    int nodeIndex = static_cast<int>(nodes.size());
+    nodes.push_back(KdTree::KdNode(-static_cast<int>(begin)-1, end-begin));
+
+    unsigned int numPrimitives = end-begin;
+    if (subtrees && numPrimitives<=parallelThreshold)
+    {
+        subtrees->push_back(Subtree(nodeIndex, begin, end, level));
+        return nodeIndex;
+    }
+
+    osg::BoundingBox bb, centerBB;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        bb.expandBy(_bounds[_primitiveIndices[i]]);
+        centerBB.expandBy(_centers[_primitiveIndices[i]]);
+    }
+    expandByEpsilon(bb);
+    nodes[nodeIndex].bb = bb;
+
+    if (numPrimitives<=options._targetNumTrianglesPerLeaf || level>=options._maxNumLevels) return nodeIndex;
+
+    SurfaceAreaHeuristicSplit split(_bounds, _centers);
+    if (!split.find(_primitiveIndices, begin, end, centerBB)) return nodeIndex;
+
+    // keep the leaf when splitting doesn't pay off, unless it is too large to be efficient
+    float leafCost = surfaceArea(bb)*float(numPrimitives);
+    float traversalCost = surfaceArea(bb);
+    if (traversalCost+split.getCost()>=leafCost && numPrimitives<=options._targetNumTrianglesPerLeaf*4) return nodeIndex;
+
+    unsigned int mid = split.partition(_primitiveIndices, begin, end);
+
+    int leftChildIndex = divideSAH(options, nodes, begin, mid, level+1, subtrees, parallelThreshold);
+    int rightChildIndex = divideSAH(options, nodes, mid, end, level+1, subtrees, parallelThreshold);
+
+    // take a fresh reference as the push_back()'s may have reallocated the node list
+    KdTree::KdNode& node = nodes[nodeIndex];
+    node.first = leftChildIndex;
+    node.second = rightChildIndex;
+
+    return nodeIndex;
+}
+
+void BuildKdTree::reorderVertexIndices()
+{
+    KdTree::Indices& primitiveIndices = _kdTree.getPrimitiveIndices();
+    KdTree::Indices& vertexIndices = _kdTree.getVertexIndices();
+
+    // copy each primitive's original index, vertex count and vertex indices in leaf order,
+    // so that intersecting a leaf reads its primitives from consecutive memory.
+    KdTree::Indices new_vertexIndices;
+    new_vertexIndices.reserve(vertexIndices.size());
+    for(KdTree::Indices::iterator itr = primitiveIndices.begin();
+        itr != primitiveIndices.end();
+        ++itr)
+    {
+        unsigned int primitiveIndex = *itr;
+        unsigned int numVertices = vertexIndices[primitiveIndex+1];
+
+        *itr = new_vertexIndices.size();
+        new_vertexIndices.insert(new_vertexIndices.end(), vertexIndices.begin()+primitiveIndex, vertexIndices.begin()+primitiveIndex+2+numVertices);
+    }
+    vertexIndices.swap(new_vertexIndices);
+}
+
+bool BuildKdTree::buildTriangles()
+{
+    const KdTree::Indices& primitiveIndices = _kdTree.getPrimitiveIndices();
+    const KdTree::Indices& vertexIndices = _kdTree.getVertexIndices();
+    const osg::Vec3Array& vertices = *_kdTree.getVertices();
+
+    KdTree::TriangleList triangles;
+    triangles.reserve(primitiveIndices.size());
+    for(KdTree::Indices::const_iterator itr = primitiveIndices.begin();
+        itr != primitiveIndices.end();
+        ++itr)
+    {
+        unsigned int primitiveIndex = *itr;
+        if (vertexIndices[primitiveIndex+1]!=3) return false;
+
+        unsigned int p0 = vertexIndices[primitiveIndex+2];
+        unsigned int p1 = vertexIndices[primitiveIndex+3];
+        unsigned int p2 = vertexIndices[primitiveIndex+4];
+        triangles.push_back(KdTree::Triangle(vertexIndices[primitiveIndex], p0, p1, p2, vertices[p0], vertices[p1], vertices[p2]));
+    }
+
+    _kdTree.getTriangles().swap(triangles);
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTree::BuildOptions
@@ -476,7 +687,9 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _splitStrategy(SPLIT_MIDDLE),
+        _triangleLeafLayout(false)
 {
 }
 
@@ -492,6 +705,9 @@ KdTree::KdTree(const KdTree& rhs, const osg::CopyOp& copyop):
     Shape(rhs, copyop),
     _degenerateCount(rhs._degenerateCount),
     _vertices(rhs._vertices),
+    _primitiveIndices(rhs._primitiveIndices),
+    _vertexIndices(rhs._vertexIndices),
+    _triangles(rhs._triangles),
     _kdNodes(rhs._kdNodes)
 {
 }
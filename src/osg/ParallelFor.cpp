@@ -0,0 +1,227 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/ParallelFor>
+#include <osg/Trace>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <sstream>
+
+using namespace osg;
+
+namespace
+{
+
+struct ParallelForJob
+{
+    ParallelForJob(unsigned int numItems, unsigned int grainSize, ParallelForFunctor& functor, unsigned int numHelpers):
+        _numItems(numItems),
+        _grainSize(grainSize),
+        _functor(functor),
+        _numHelpersWanted(numHelpers),
+        _numActiveHelpers(0) {}
+
+    void process()
+    {
+        for(unsigned int chunk=(++_nextChunk)-1; chunk*_grainSize<_numItems; chunk=(++_nextChunk)-1)
+        {
+            unsigned int begin = chunk*_grainSize;
+            _functor(begin, std::min(begin+_grainSize, _numItems));
+        }
+    }
+
+    unsigned int            _numItems;
+    unsigned int            _grainSize;
+    ParallelForFunctor&     _functor;
+    OpenThreads::Atomic     _nextChunk;
+
+    // protected by the pool's mutex
+    unsigned int            _numHelpersWanted;
+    unsigned int            _numActiveHelpers;
+};
+
+class ParallelForThread;
+
+/** Pool of worker threads shared by all the parallelFor() calls, started on demand and kept waiting for
+  * jobs until exit. The calling thread always processes the chunks of its own job too, so a job completes
+  * even when all the workers are busy, which also makes parallelFor() calls from within a functor safe.*/
+class ParallelForPool
+{
+    public:
+
+        ParallelForPool(): _done(false) {}
+
+        ~ParallelForPool();
+
+        void run(ParallelForJob& job);
+
+        // called by the worker threads
+        ParallelForJob* waitForJob();
+        void helperFinished(ParallelForJob* job);
+
+    protected:
+
+        void startThreads(unsigned int numThreads);
+
+        OpenThreads::Mutex                  _mutex;
+        OpenThreads::Condition              _jobAvailable;
+        OpenThreads::Condition              _jobFinished;
+        std::deque<ParallelForJob*>         _jobs;
+        std::vector<ParallelForThread*>     _threads;
+        bool                                _done;
+};
+
+class ParallelForThread : public OpenThreads::Thread
+{
+    public:
+
+        ParallelForThread(ParallelForPool& pool, unsigned int index):
+            _pool(pool),
+            _index(index) {}
+
+        virtual void run()
+        {
+            std::stringstream sstr;
+            sstr<<"parallelFor "<<_index;
+            osg::setTraceThreadName(sstr.str());
+
+            while(ParallelForJob* job = _pool.waitForJob())
+            {
+                job->process();
+                _pool.helperFinished(job);
+            }
+        }
+
+    protected:
+
+        ParallelForPool&    _pool;
+        unsigned int        _index;
+};
+
+ParallelForPool::~ParallelForPool()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _done = true;
+        _jobAvailable.broadcast();
+    }
+
+    for(std::vector<ParallelForThread*>::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+}
+
+void ParallelForPool::startThreads(unsigned int numThreads)
+{
+    while(_threads.size()<numThreads)
+    {
+        ParallelForThread* thread = new ParallelForThread(*this, static_cast<unsigned int>(_threads.size()));
+        thread->start();
+        _threads.push_back(thread);
+    }
+}
+
+void ParallelForPool::run(ParallelForJob& job)
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        startThreads(job._numHelpersWanted);
+        _jobs.push_back(&job);
+        _jobAvailable.broadcast();
+    }
+
+    job.process();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    // all the chunks have been handed out, so stop any further workers from joining in
+    std::deque<ParallelForJob*>::iterator itr = std::find(_jobs.begin(), _jobs.end(), &job);
+    if (itr != _jobs.end()) _jobs.erase(itr);
+
+    while(job._numActiveHelpers>0)
+    {
+        _jobFinished.wait(&_mutex);
+    }
+}
+
+ParallelForJob* ParallelForPool::waitForJob()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    while(_jobs.empty() && !_done)
+    {
+        _jobAvailable.wait(&_mutex);
+    }
+
+    if (_done) return 0;
+
+    ParallelForJob* job = _jobs.front();
+    ++(job->_numActiveHelpers);
+    if (--(job->_numHelpersWanted)==0) _jobs.pop_front();
+
+    return job;
+}
+
+void ParallelForPool::helperFinished(ParallelForJob* job)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    if (--(job->_numActiveHelpers)==0) _jobFinished.broadcast();
+}
+
+ParallelForPool& getParallelForPool()
+{
+    static ParallelForPool s_parallelForPool;
+    return s_parallelForPool;
+}
+
+// construct the pool while the library is loaded, rather than on first use from several threads at once.
+struct InitParallelForPool
+{
+    InitParallelForPool() { getParallelForPool(); }
+};
+
+static InitParallelForPool s_initParallelForPool;
+
+}
+
+void osg::parallelFor(unsigned int numItems, ParallelForFunctor& functor, unsigned int grainSize, unsigned int numThreads)
+{
+    if (numItems==0) return;
+    if (grainSize==0) grainSize = 1;
+
+    if (numThreads==0) numThreads = std::max(OpenThreads::GetNumberOfProcessors(), 1);
+
+    unsigned int numChunks = (numItems+grainSize-1)/grainSize;
+    numThreads = std::min(numThreads, numChunks);
+
+    if (numThreads<=1)
+    {
+        functor(0, numItems);
+        return;
+    }
+
+    ParallelForJob job(numItems, grainSize, functor, numThreads-1);
+    getParallelForPool().run(job);
+}
@@ -99,3 +99,48 @@ bool Polytope::contains(const osg::Vec3f& v0, const osg::Vec3f& v1, const osg::V
     //OSG_NOTICE<<"Polytope::contains() triangle within Polytope, src.size()="<<src.size()<<std::endl;
     return true;
 }
+
+unsigned int Polytope::contains(unsigned int numSpheres,
+                                const BoundingSphere::value_type* x, const BoundingSphere::value_type* y, const BoundingSphere::value_type* z,
+                                const BoundingSphere::value_type* radius,
+                                unsigned char* contained, ClippingMask* resultMasks) const
+{
+    const ClippingMask mask = _maskStack.back();
+    for(unsigned int i=0; i<numSpheres; ++i)
+    {
+        contained[i] = 1;
+        resultMasks[i] = mask;
+    }
+
+    if (!mask) return numSpheres;
+
+    ClippingMask selector_mask = 0x1;
+    for(PlaneList::const_iterator pitr = _planeList.begin();
+        pitr != _planeList.end();
+        ++pitr, selector_mask <<= 1)
+    {
+        if (!(mask&selector_mask)) continue;
+
+        const Plane::value_type a = (*pitr)[0];
+        const Plane::value_type b = (*pitr)[1];
+        const Plane::value_type c = (*pitr)[2];
+        const Plane::value_type d = (*pitr)[3];
+
+        // same arithmetic as Plane::intersect(const BoundingSphere&), the distance being computed at the plane's
+        // precision and then rounded to float, written without branches so that the loop compiles to packed
+        // multiplies, compares and masks.
+        for(unsigned int i=0; i<numSpheres; ++i)
+        {
+            float distance = a*x[i] + b*y[i] + c*z[i] + d;
+            contained[i] &= static_cast<unsigned char>(!(distance < -radius[i]));
+            resultMasks[i] &= ~(selector_mask & (0u - static_cast<ClippingMask>(distance > radius[i])));
+        }
+    }
+
+    unsigned int numContained = 0;
+    for(unsigned int i=0; i<numSpheres; ++i)
+    {
+        numContained += contained[i];
+    }
+    return numContained;
+}
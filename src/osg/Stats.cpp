@@ -13,22 +13,142 @@
 
 #include <osg/Stats>
 #include <osg/Notify>
+#include <osg/Trace>
+
+#include <float.h>
+#include <string.h>
+#include <iomanip>
 
 using namespace osg;
 
+namespace
+{
+
+// The registered attribute names, along with an open addressing hash table of their AttributeIDs plus one, 0 for an empty
+// slot. Names and slots are written once, under the mutex, and published by the atomic writes of the slot and of numNames,
+// so the lookups of registered names don't need to lock.
+struct AttributeRegistry
+{
+    enum { NUMBER_OF_SLOTS = Stats::MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS*2 };
+
+    OpenThreads::Mutex          mutex;
+    std::string                 names[Stats::MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS];
+    OpenThreads::Atomic         numNames;
+    OpenThreads::Atomic         slots[NUMBER_OF_SLOTS];
+
+    static unsigned int hash(const std::string& name)
+    {
+        // FNV-1a
+        unsigned int h = 2166136261u;
+        for(std::string::const_iterator itr = name.begin(); itr != name.end(); ++itr)
+        {
+            h = (h ^ static_cast<unsigned char>(*itr)) * 16777619u;
+        }
+        return h;
+    }
+
+    // find the slot holding name, or the empty slot it would be placed in, returning the slot's value.
+    unsigned int find(const std::string& name, unsigned int& slot) const
+    {
+        // the table is never more than half full so there is always an empty slot to end the search.
+        for(slot = hash(name) % NUMBER_OF_SLOTS; ; slot = (slot+1) % NUMBER_OF_SLOTS)
+        {
+            unsigned int value = slots[slot];
+            if (value==0 || names[value-1]==name) return value;
+        }
+    }
+};
+
+AttributeRegistry& getAttributeRegistry()
+{
+    static AttributeRegistry s_attributeRegistry;
+    return s_attributeRegistry;
+}
+
+const char* const s_beginTimeSuffix = " begin time";
+const char* const s_endTimeSuffix = " end time";
+const char* const s_timeTakenSuffix = " time taken";
+
+bool endsWith(const std::string& str, const char* suffix, std::string& prefix)
+{
+    std::string::size_type length = strlen(suffix);
+    if (str.size()<length || str.compare(str.size()-length, length, suffix)!=0) return false;
+    prefix = str.substr(0, str.size()-length);
+    return true;
+}
+
+// JSON has no representation for infinities and NaNs.
+inline bool isFinite(double value) { return value>=-DBL_MAX && value<=DBL_MAX; }
+
+}
+
+Stats::AttributeID Stats::registerAttribute(const std::string& attributeName)
+{
+    AttributeRegistry& registry = getAttributeRegistry();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+
+    unsigned int slot = 0;
+    unsigned int value = registry.find(attributeName, slot);
+    if (value!=0) return value-1;
+
+    AttributeID id = registry.numNames;
+    if (id>=MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS)
+    {
+        OSG_WARN<<"Warning: Stats::registerAttribute("<<attributeName<<") exceeds the maximum number of attributes, "<<MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS<<"."<<std::endl;
+        return MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS;
+    }
+
+    // write the name before publishing it through the slot and the count.
+    registry.names[id] = attributeName;
+    registry.slots[slot].exchange(id+1);
+    registry.numNames.exchange(id+1);
+    return id;
+}
+
+bool Stats::getAttributeID(const std::string& attributeName, AttributeID& id)
+{
+    unsigned int slot = 0;
+    unsigned int value = getAttributeRegistry().find(attributeName, slot);
+    if (value==0) return false;
+
+    id = value-1;
+    return true;
+}
+
+std::string Stats::getAttributeName(AttributeID id)
+{
+    AttributeRegistry& registry = getAttributeRegistry();
+    return id<static_cast<unsigned int>(registry.numNames) ? registry.names[id] : std::string();
+}
+
 Stats::Stats(const std::string& name):
-    _name(name)
+    _name(name),
+    _numTypedFrames(0),
+    _typedValues(0),
+    _typedValueStamps(0),
+    _typedFrameStamps(0)
 {
     allocate(25);
 }
 
 
 Stats::Stats(const std::string& name, unsigned int numberOfFrames):
-    _name(name)
+    _name(name),
+    _numTypedFrames(0),
+    _typedValues(0),
+    _typedValueStamps(0),
+    _typedFrameStamps(0)
 {
     allocate(numberOfFrames);
 }
 
+Stats::~Stats()
+{
+    delete [] _typedValues;
+    delete [] _typedValueStamps;
+    delete [] _typedFrameStamps;
+}
+
 void Stats::allocate(unsigned int numberOfFrames)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
@@ -37,6 +157,65 @@ void Stats::allocate(unsigned int numberOfFrames)
     _latestFrameNumber  = 0;
     _attributeMapList.clear();
     _attributeMapList.resize(numberOfFrames);
+
+    // the ring buffers are written without locking, so mustn't be reallocated while attributes are being set.
+    delete [] _typedValues;
+    delete [] _typedValueStamps;
+    delete [] _typedFrameStamps;
+
+    _numTypedFrames = numberOfFrames;
+    _typedValues = numberOfFrames>0 ? new double[numberOfFrames*MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS] : 0;
+    _typedValueStamps = numberOfFrames>0 ? new OpenThreads::Atomic[numberOfFrames*MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS] : 0;
+    _typedFrameStamps = numberOfFrames>0 ? new OpenThreads::Atomic[numberOfFrames] : 0;
+}
+
+unsigned int Stats::getLatestFrameNumber() const
+{
+    unsigned int latestFrameNumber = _latestFrameNumber;
+    for(unsigned int i=0; i<_numTypedFrames; ++i)
+    {
+        unsigned int stamp = _typedFrameStamps[i];
+        if (stamp>0 && stamp-1>latestFrameNumber) latestFrameNumber = stamp-1;
+    }
+    return latestFrameNumber;
+}
+
+bool Stats::setAttribute(unsigned int frameNumber, AttributeID id, double value)
+{
+    if (id>=MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS || _numTypedFrames==0) return false;
+
+    unsigned int frameIndex = frameNumber % _numTypedFrames;
+
+    // reject frames that are too early, their slot already holding a later frame
+    unsigned int frameStamp = _typedFrameStamps[frameIndex];
+    if (frameStamp>frameNumber+1) return false;
+
+    // clear the stamp while the value is written so that readers can't pair the value of one frame with the stamp of another.
+    unsigned int index = frameIndex*MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS + id;
+    _typedValueStamps[index].exchange(0);
+    _typedValues[index] = value;
+    _typedValueStamps[index].exchange(frameNumber+1);
+
+    if (frameStamp!=frameNumber+1) _typedFrameStamps[frameIndex].exchange(frameNumber+1);
+
+    return true;
+}
+
+bool Stats::getAttribute(unsigned int frameNumber, AttributeID id, double& value) const
+{
+    if (id>=MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS || _numTypedFrames==0) return false;
+
+    unsigned int index = (frameNumber % _numTypedFrames)*MAXIMUM_NUMBER_OF_ATTRIBUTE_IDS + id;
+    unsigned int stamp = _typedValueStamps[index];
+    if (stamp!=frameNumber+1) return false;
+
+    double v = _typedValues[index];
+
+    // the value was overwritten while being read
+    if (static_cast<unsigned int>(_typedValueStamps[index])!=stamp) return false;
+
+    value = v;
+    return true;
 }
 
 
@@ -80,16 +259,46 @@ bool Stats::setAttribute(unsigned int frameNumber, const std::string& attributeN
 }
 
 bool Stats::getAttributeNoMutex(unsigned int frameNumber, const std::string& attributeName, double& value) const
+{
+    AttributeID id = 0;
+    bool registered = getAttributeID(attributeName, id);
+    return getAttributeNoMutex(frameNumber, attributeName, registered, id, value);
+}
+
+bool Stats::getAttributeNoMutex(unsigned int frameNumber, const std::string& attributeName, bool registered, AttributeID id, double& value) const
 {
     int index = getIndex(frameNumber);
-    if (index<0) return false;
+    if (index>=0)
+    {
+        const AttributeMap& attributeMap = _attributeMapList[index];
+        AttributeMap::const_iterator itr = attributeMap.find(attributeName);
+        if (itr != attributeMap.end())
+        {
+            value = itr->second;
+            return true;
+        }
+    }
+
+    return registered && getAttribute(frameNumber, id, value);
+}
 
-    const AttributeMap& attributeMap = _attributeMapList[index];
-    AttributeMap::const_iterator itr = attributeMap.find(attributeName);
-    if (itr == attributeMap.end()) return false;
+void Stats::getAttributes(unsigned int frameNumber, AttributeMap& attributes) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    getAttributesNoMutex(frameNumber, attributes);
+}
 
-    value = itr->second;
-    return true;
+void Stats::getAttributesNoMutex(unsigned int frameNumber, AttributeMap& attributes) const
+{
+    attributes = getAttributeMapNoMutex(frameNumber);
+
+    const AttributeRegistry& registry = getAttributeRegistry();
+    AttributeID numNames = registry.numNames;
+    for(AttributeID id=0; id<numNames; ++id)
+    {
+        double value = 0.0;
+        if (getAttribute(frameNumber, id, value) && attributes.count(registry.names[id])==0) attributes[registry.names[id]] = value;
+    }
 }
 
 bool Stats::getAveragedAttribute(const std::string& attributeName, double& value, bool averageInInverseSpace) const
@@ -104,6 +313,9 @@ bool Stats::getAveragedAttribute(unsigned int startFrameNumber, unsigned int end
         std::swap(endFrameNumber, startFrameNumber);
     }
 
+    AttributeID id = 0;
+    bool registered = getAttributeID(attributeName, id);
+
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
     double total = 0.0;
@@ -111,7 +323,7 @@ bool Stats::getAveragedAttribute(unsigned int startFrameNumber, unsigned int end
     for(unsigned int i = startFrameNumber; i<=endFrameNumber; ++i)
     {
         double v = 0.0;
-        if (getAttributeNoMutex(i,attributeName,v))
+        if (getAttributeNoMutex(i,attributeName,registered,id,v))
         {
             if (averageInInverseSpace) total += 1.0/v;
             else total += v;
@@ -152,7 +364,8 @@ void Stats::report(std::ostream& out, const char* indent) const
     for(unsigned int i = getEarliestFrameNumber(); i<= getLatestFrameNumber(); ++i)
     {
         out<<" FrameNumber "<<i<<std::endl;
-        const osg::Stats::AttributeMap& attributes = getAttributeMapNoMutex(i);
+        osg::Stats::AttributeMap attributes;
+        getAttributesNoMutex(i, attributes);
         for(osg::Stats::AttributeMap::const_iterator itr = attributes.begin();
             itr != attributes.end();
             ++itr)
@@ -170,7 +383,8 @@ void Stats::report(std::ostream& out, unsigned int frameNumber, const char* inde
 
     if (indent) out<<indent;
     out<<"Stats "<<_name<<" FrameNumber "<<frameNumber<<std::endl;
-    const osg::Stats::AttributeMap& attributes = getAttributeMapNoMutex(frameNumber);
+    osg::Stats::AttributeMap attributes;
+    getAttributesNoMutex(frameNumber, attributes);
     for(osg::Stats::AttributeMap::const_iterator itr = attributes.begin();
         itr != attributes.end();
         ++itr)
@@ -179,3 +393,78 @@ void Stats::report(std::ostream& out, unsigned int frameNumber, const char* inde
         out<<"    "<<itr->first<<"\t"<<itr->second<<std::endl;
     }
 }
+
+void Stats::writeChromeTrace(std::ostream& out, const StatsList& statsList, unsigned int startFrameNumber, unsigned int endFrameNumber)
+{
+    if (endFrameNumber<startFrameNumber)
+    {
+        std::swap(endFrameNumber, startFrameNumber);
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out<<std::fixed<<std::setprecision(3);
+
+    out<<"{\"traceEvents\":["<<std::endl;
+
+    // name the thread that each Stats is shown as
+    for(unsigned int tid=0; tid<statsList.size(); ++tid)
+    {
+        if (tid>0) out<<","<<std::endl;
+        out<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"<<tid<<",\"args\":{\"name\":";
+        osg::writeTraceString(out, statsList[tid]->getName());
+        out<<"}}";
+    }
+
+    std::vector<AttributeMap> frameAttributes(statsList.size());
+    for(unsigned int frameNumber = startFrameNumber; frameNumber<=endFrameNumber; ++frameNumber)
+    {
+        // the counters of a frame are placed at the earliest begin time of any of its events.
+        double frameBeginTime = DBL_MAX;
+        for(unsigned int tid=0; tid<statsList.size(); ++tid)
+        {
+            statsList[tid]->getAttributes(frameNumber, frameAttributes[tid]);
+
+            std::string prefix;
+            for(AttributeMap::const_iterator itr = frameAttributes[tid].begin(); itr != frameAttributes[tid].end(); ++itr)
+            {
+                if (endsWith(itr->first, s_beginTimeSuffix, prefix) && isFinite(itr->second) && itr->second<frameBeginTime) frameBeginTime = itr->second;
+            }
+        }
+
+        if (frameBeginTime==DBL_MAX) continue;
+
+        out<<","<<std::endl<<"{\"name\":\"Frame "<<frameNumber<<"\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":"<<frameBeginTime*1e6<<"}";
+
+        for(unsigned int tid=0; tid<statsList.size(); ++tid)
+        {
+            const AttributeMap& attributes = frameAttributes[tid];
+            std::string prefix;
+            for(AttributeMap::const_iterator itr = attributes.begin(); itr != attributes.end(); ++itr)
+            {
+                if (endsWith(itr->first, s_beginTimeSuffix, prefix))
+                {
+                    AttributeMap::const_iterator end_itr = attributes.find(prefix+s_endTimeSuffix);
+                    if (end_itr==attributes.end() || !isFinite(itr->second) || !isFinite(end_itr->second) || end_itr->second<itr->second) continue;
+
+                    out<<","<<std::endl<<"{\"name\":";
+                    osg::writeTraceString(out, prefix);
+                    out<<",\"cat\":\"osg\",\"ph\":\"X\",\"pid\":0,\"tid\":"<<tid
+                       <<",\"ts\":"<<itr->second*1e6<<",\"dur\":"<<(end_itr->second-itr->second)*1e6
+                       <<",\"args\":{\"frame\":"<<frameNumber<<"}}";
+                }
+                else if (isFinite(itr->second) && !endsWith(itr->first, s_endTimeSuffix, prefix) && !endsWith(itr->first, s_timeTakenSuffix, prefix))
+                {
+                    out<<","<<std::endl<<"{\"name\":";
+                    osg::writeTraceString(out, statsList[tid]->getName()+": "+itr->first);
+                    out<<",\"ph\":\"C\",\"pid\":0,\"tid\":"<<tid<<",\"ts\":"<<frameBeginTime*1e6<<",\"args\":{\"value\":"<<itr->second<<"}}";
+                }
+            }
+        }
+    }
+
+    out<<std::endl<<"]}"<<std::endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
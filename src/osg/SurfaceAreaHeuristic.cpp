@@ -0,0 +1,104 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/SurfaceAreaHeuristic>
+
+#include <float.h>
+#include <algorithm>
+
+using namespace osg;
+
+static const unsigned int s_numBins = 16;
+
+SurfaceAreaHeuristicSplit::SurfaceAreaHeuristicSplit(const BoundsList& bounds, const CenterList& centers):
+    _bounds(bounds),
+    _centers(centers),
+    _axis(0),
+    _binOrigin(0.0f),
+    _binScale(0.0f),
+    _splitBin(0),
+    _cost(FLT_MAX)
+{
+}
+
+bool SurfaceAreaHeuristicSplit::find(const Indices& indices, unsigned int begin, unsigned int end, const BoundingBox& centerBB)
+{
+    _splitBin = 0;
+    _cost = FLT_MAX;
+
+    Vec3 extents = centerBB._max - centerBB._min;
+    _axis = (extents.x()>=extents.y() && extents.x()>=extents.z()) ? 0 : (extents.y()>=extents.z() ? 1 : 2);
+    if (!(extents[_axis]>0.0f)) return false;
+
+    // bin the items by their centers along the axis of largest extent
+    BoundingBox binBounds[s_numBins];
+    unsigned int binCounts[s_numBins] = { 0 };
+
+    _binScale = float(s_numBins)*0.9999f/extents[_axis];
+    _binOrigin = centerBB._min[_axis];
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        unsigned int item = indices[i];
+        unsigned int b = bin(item);
+        ++binCounts[b];
+        binBounds[b].expandBy(_bounds[item]);
+    }
+
+    // sweep the bins from the right to compute the area and count on the right of each plane
+    float rightAreas[s_numBins];
+    unsigned int rightCounts[s_numBins];
+    BoundingBox sweepBB;
+    unsigned int sweepCount = 0;
+    for(unsigned int b=s_numBins-1; b>0; --b)
+    {
+        sweepBB.expandBy(binBounds[b]);
+        sweepCount += binCounts[b];
+        rightAreas[b] = surfaceArea(sweepBB);
+        rightCounts[b] = sweepCount;
+    }
+
+    // then from the left, evaluating the cost of splitting between bin b-1 and bin b
+    sweepBB.init();
+    sweepCount = 0;
+    for(unsigned int b=1; b<s_numBins; ++b)
+    {
+        sweepBB.expandBy(binBounds[b-1]);
+        sweepCount += binCounts[b-1];
+        if (sweepCount==0 || rightCounts[b]==0) continue;
+
+        float cost = surfaceArea(sweepBB)*float(sweepCount) + rightAreas[b]*float(rightCounts[b]);
+        if (cost<_cost)
+        {
+            _cost = cost;
+            _splitBin = b;
+        }
+    }
+
+    return _splitBin>0;
+}
+
+unsigned int SurfaceAreaHeuristicSplit::partition(Indices& indices, unsigned int begin, unsigned int end) const
+{
+    unsigned int mid = begin;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        if (bin(indices[i])<_splitBin) std::swap(indices[i], indices[mid++]);
+    }
+    return mid;
+}
+
+unsigned int SurfaceAreaHeuristicSplit::computeParallelSubtreeSize(unsigned int numItems, unsigned int numThreads, unsigned int minSize)
+{
+    if (numThreads<2 || numItems<minSize*2) return 0;
+    return std::max(numItems/(numThreads*4), minSize);
+}
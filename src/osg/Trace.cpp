@@ -0,0 +1,310 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/Trace>
+#include <osg/Notify>
+#include <osg/ApplicationUsage>
+#include <osg/os_utils>
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+
+#if defined(_MSC_VER)
+    #define OSG_TRACE_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+    #define OSG_TRACE_THREAD_LOCAL __thread
+#endif
+
+using namespace osg;
+
+static osg::ApplicationUsageProxy Trace_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE, "OSG_TRACE_FILE <filename>", "Enable the recording of trace zones and write them to the file as Chrome trace JSON on exit.");
+
+namespace
+{
+
+struct Zone
+{
+    const char*     name;
+    std::string     detail;
+    Timer_t         startTick;
+    Timer_t         endTick;
+};
+
+// Each thread appends to its own buffer, the buffer's mutex only being contended while the trace is written or cleared.
+struct TraceBuffer
+{
+    TraceBuffer(): threadIndex(0), numDropped(0) {}
+
+    OpenThreads::Mutex  mutex;
+    unsigned int        threadIndex;
+    std::string         threadName;
+    std::deque<Zone>    zones;
+    unsigned int        numDropped;
+};
+
+bool s_traceEnabled = false;
+
+struct TraceRegistry
+{
+    typedef std::vector<TraceBuffer*> TraceBuffers;
+
+    TraceRegistry():
+        maximumNumberOfZonesPerThread(1000000)
+    {
+        if (getEnvVar("OSG_TRACE_FILE", fileName) && !fileName.empty())
+        {
+            s_traceEnabled = true;
+        }
+    }
+
+    ~TraceRegistry()
+    {
+        if (!fileName.empty())
+        {
+            if (writeTraceFile(fileName))
+            {
+                OSG_NOTICE<<"Trace written to "<<fileName<<std::endl;
+            }
+        }
+        s_traceEnabled = false;
+
+        // the buffers are deliberately not deleted, threads that outlive the registry may still hold them.
+    }
+
+    OpenThreads::Mutex  mutex;
+    TraceBuffers        buffers;
+    unsigned int        maximumNumberOfZonesPerThread;
+    std::string         fileName;
+
+#ifndef OSG_TRACE_THREAD_LOCAL
+    typedef std::map<const OpenThreads::Thread*, TraceBuffer*> ThreadBufferMap;
+    ThreadBufferMap     threadBuffers;
+#endif
+};
+
+TraceRegistry& getTraceRegistry()
+{
+    // make sure the Timer outlives the registry, which uses it when writing the trace on exit.
+    Timer::instance();
+
+    static TraceRegistry s_traceRegistry;
+    return s_traceRegistry;
+}
+
+struct InitTraceRegistry
+{
+    InitTraceRegistry() { getTraceRegistry(); }
+};
+
+static InitTraceRegistry s_initTraceRegistry;
+
+TraceBuffer* createTraceBuffer(TraceRegistry& registry)
+{
+    TraceBuffer* buffer = new TraceBuffer;
+    buffer->threadIndex = static_cast<unsigned int>(registry.buffers.size());
+
+    std::stringstream sstr;
+    sstr<<"Thread "<<buffer->threadIndex;
+    buffer->threadName = sstr.str();
+
+    registry.buffers.push_back(buffer);
+    return buffer;
+}
+
+#ifdef OSG_TRACE_THREAD_LOCAL
+
+OSG_TRACE_THREAD_LOCAL TraceBuffer* s_threadTraceBuffer = 0;
+
+TraceBuffer* getThreadTraceBuffer()
+{
+    if (!s_threadTraceBuffer)
+    {
+        TraceRegistry& registry = getTraceRegistry();
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+        s_threadTraceBuffer = createTraceBuffer(registry);
+    }
+    return s_threadTraceBuffer;
+}
+
+#else
+
+// without compiler support for thread local storage the buffers are looked up by OpenThreads thread, all
+// the threads not started by OpenThreads, such as the application's main thread, sharing a single buffer.
+TraceBuffer* getThreadTraceBuffer()
+{
+    TraceRegistry& registry = getTraceRegistry();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+
+    TraceBuffer*& buffer = registry.threadBuffers[OpenThreads::Thread::CurrentThread()];
+    if (!buffer) buffer = createTraceBuffer(registry);
+    return buffer;
+}
+
+#endif
+
+}
+
+void osg::setTraceEnabled(bool enabled)
+{
+    getTraceRegistry();
+    s_traceEnabled = enabled;
+}
+
+#ifndef OSG_TRACE_DISABLED
+bool osg::isTraceEnabled()
+{
+    return s_traceEnabled;
+}
+#endif
+
+void osg::setTraceMaximumNumberOfZonesPerThread(unsigned int maximum)
+{
+    TraceRegistry& registry = getTraceRegistry();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+    registry.maximumNumberOfZonesPerThread = maximum;
+}
+
+void osg::setTraceThreadName(const std::string& name)
+{
+    TraceBuffer* buffer = getThreadTraceBuffer();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(buffer->mutex);
+    buffer->threadName = name;
+}
+
+void osg::addTraceZone(const char* name, const std::string& detail, Timer_t startTick, Timer_t endTick)
+{
+    TraceBuffer* buffer = getThreadTraceBuffer();
+    unsigned int maximumNumberOfZones = getTraceRegistry().maximumNumberOfZonesPerThread;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(buffer->mutex);
+    if (buffer->zones.size()>=maximumNumberOfZones)
+    {
+        ++(buffer->numDropped);
+        return;
+    }
+
+    buffer->zones.push_back(Zone());
+    Zone& zone = buffer->zones.back();
+    zone.name = name;
+    zone.detail = detail;
+    zone.startTick = startTick;
+    zone.endTick = endTick;
+}
+
+void osg::writeTrace(std::ostream& out)
+{
+    TraceRegistry& registry = getTraceRegistry();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+
+    const Timer* timer = Timer::instance();
+    Timer_t startTick = timer->getStartTick();
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out<<std::fixed<<std::setprecision(3);
+
+    out<<"{\"traceEvents\":[";
+
+    bool first = true;
+    for(TraceRegistry::TraceBuffers::const_iterator itr = registry.buffers.begin();
+        itr != registry.buffers.end();
+        ++itr)
+    {
+        TraceBuffer* buffer = *itr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> bufferLock(buffer->mutex);
+
+        if (!first) out<<",";
+        first = false;
+
+        out<<std::endl<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"<<buffer->threadIndex<<",\"args\":{\"name\":";
+        writeTraceString(out, buffer->threadName);
+        out<<"}}";
+
+        for(std::deque<Zone>::const_iterator zitr = buffer->zones.begin();
+            zitr != buffer->zones.end();
+            ++zitr)
+        {
+            out<<","<<std::endl<<"{\"name\":";
+            writeTraceString(out, zitr->name);
+            out<<",\"cat\":\"osg\",\"ph\":\"X\",\"pid\":0,\"tid\":"<<buffer->threadIndex
+               <<",\"ts\":"<<timer->delta_u(startTick, zitr->startTick)
+               <<",\"dur\":"<<(zitr->endTick>zitr->startTick ? timer->delta_u(zitr->startTick, zitr->endTick) : 0.0);
+            if (!zitr->detail.empty())
+            {
+                out<<",\"args\":{\"detail\":";
+                writeTraceString(out, zitr->detail);
+                out<<"}";
+            }
+            out<<"}";
+        }
+
+        if (buffer->numDropped>0)
+        {
+            OSG_NOTICE<<"Warning: trace of "<<buffer->threadName<<" dropped "<<buffer->numDropped<<" zones, see osg::setTraceMaximumNumberOfZonesPerThread()."<<std::endl;
+        }
+    }
+
+    out<<std::endl<<"]}"<<std::endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool osg::writeTraceFile(const std::string& fileName)
+{
+    std::ofstream fout(fileName.c_str());
+    if (!fout)
+    {
+        OSG_WARN<<"Warning: could not open "<<fileName<<" to write the trace to."<<std::endl;
+        return false;
+    }
+
+    writeTrace(fout);
+    return true;
+}
+
+void osg::clearTrace()
+{
+    TraceRegistry& registry = getTraceRegistry();
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(registry.mutex);
+
+    for(TraceRegistry::TraceBuffers::iterator itr = registry.buffers.begin();
+        itr != registry.buffers.end();
+        ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> bufferLock((*itr)->mutex);
+        (*itr)->zones.clear();
+        (*itr)->numDropped = 0;
+    }
+}
+
+void osg::writeTraceString(std::ostream& out, const std::string& str)
+{
+    out<<'"';
+    for(std::string::const_iterator itr = str.begin(); itr != str.end(); ++itr)
+    {
+        unsigned char c = static_cast<unsigned char>(*itr);
+        if (c=='"' || c=='\\') out<<'\\'<<*itr;
+        else if (c<0x20) out<<"\\u"<<std::hex<<std::setw(4)<<std::setfill('0')<<static_cast<unsigned int>(c)<<std::dec<<std::setfill(' ');
+        else out<<*itr;
+    }
+    out<<'"';
+}
@@ -8,6 +8,11 @@
 
 #include "dxtctool.h"
 
+#include <osg/Math>
+
+#include <float.h>
+#include <algorithm>
+
 
 namespace dxtc_tool {
 
@@ -655,4 +660,175 @@ void compressedBlockStripAlhpa(const GLenum format, const unsigned char *src_blo
     }
     }
 }
+namespace
+{
+
+inline unsigned short packColor565(const float color[3])
+{
+    int r = osg::clampBetween(static_cast<int>(color[0]*31.0f/255.0f+0.5f), 0, 31);
+    int g = osg::clampBetween(static_cast<int>(color[1]*63.0f/255.0f+0.5f), 0, 63);
+    int b = osg::clampBetween(static_cast<int>(color[2]*31.0f/255.0f+0.5f), 0, 31);
+    return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor565(unsigned short color16, float color[3])
+{
+    unsigned int r = (color16 >> 11) & 0x1F;
+    unsigned int g = (color16 >> 5) & 0x3F;
+    unsigned int b = color16 & 0x1F;
+    color[0] = float((r << 3) | (r >> 2));
+    color[1] = float((g << 2) | (g >> 4));
+    color[2] = float((b << 3) | (b >> 2));
+}
+
+// Fit the colour endpoints along the principal axis of the opaque pixels and pick the nearest palette entry for every pixel.
+void compressColorBlock(const unsigned char rgba[64], unsigned char *dst_block, bool useAlpha, bool allowThreeColorMode)
+{
+    bool transparent[16];
+    bool hasTransparent = false;
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    unsigned int numOpaque = 0;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        transparent[i] = useAlpha && rgba[i * 4 + 3] < 128;
+        if (transparent[i]) { hasTransparent = true; continue; }
+        for (unsigned int c = 0; c < 3; ++c) mean[c] += rgba[i * 4 + c];
+        ++numOpaque;
+    }
+
+    unsigned short color_0 = 0, color_1 = 0;
+    if (numOpaque > 0)
+    {
+        for (unsigned int c = 0; c < 3; ++c) mean[c] /= float(numOpaque);
+
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            if (transparent[i]) continue;
+            float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+
+        // power iteration for the principal axis
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (unsigned int iteration = 0; iteration < 8; ++iteration)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = osg::maximum(fabsf(x), osg::maximum(fabsf(y), fabsf(z)));
+            if (length == 0.0f) break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+        unsigned int minIndex = 0, maxIndex = 0;
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            if (transparent[i]) continue;
+            float projection = rgba[i * 4] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+            if (projection < minProjection) { minProjection = projection; minIndex = i; }
+            if (projection > maxProjection) { maxProjection = projection; maxIndex = i; }
+        }
+
+        float maxColor[3] = { float(rgba[maxIndex * 4]), float(rgba[maxIndex * 4 + 1]), float(rgba[maxIndex * 4 + 2]) };
+        float minColor[3] = { float(rgba[minIndex * 4]), float(rgba[minIndex * 4 + 1]), float(rgba[minIndex * 4 + 2]) };
+        color_0 = packColor565(maxColor);
+        color_1 = packColor565(minColor);
+    }
+
+    // the four colour mode requires color_0 > color_1, the three colour mode with transparency color_0 <= color_1
+    bool threeColorMode = allowThreeColorMode && hasTransparent;
+    if (threeColorMode ? color_0 > color_1 : color_0 < color_1) std::swap(color_0, color_1);
+
+    // identical endpoints can only be decoded in three colour mode, so only use their shared colour
+    unsigned int numColors = (threeColorMode || color_0 == color_1) ? 3 : 4;
+
+    float palette[4][3];
+    unpackColor565(color_0, palette[0]);
+    unpackColor565(color_1, palette[1]);
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+        if (numColors == 3)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) * 0.5f;
+        }
+        else
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+    }
+
+    unsigned int texels4x4 = 0;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        unsigned int index = 3;
+        if (!transparent[i])
+        {
+            float minDistance = FLT_MAX;
+            for (unsigned int p = 0; p < numColors; ++p)
+            {
+                float r = rgba[i * 4] - palette[p][0], g = rgba[i * 4 + 1] - palette[p][1], b = rgba[i * 4 + 2] - palette[p][2];
+                float distance = r * r + g * g + b * b;
+                if (distance < minDistance) { minDistance = distance; index = p; }
+            }
+        }
+        texels4x4 |= index << (2 * i);
+    }
+
+    dst_block[0] = static_cast<unsigned char>(color_0 & 0xFF);
+    dst_block[1] = static_cast<unsigned char>(color_0 >> 8);
+    dst_block[2] = static_cast<unsigned char>(color_1 & 0xFF);
+    dst_block[3] = static_cast<unsigned char>(color_1 >> 8);
+    for (unsigned int i = 0; i < 4; ++i) dst_block[4 + i] = static_cast<unsigned char>(texels4x4 >> (8 * i));
+}
+
+}
+
+void compressBlockDXT1(const unsigned char rgba[64], unsigned char *dst_block, bool useAlpha)
+{
+    compressColorBlock(rgba, dst_block, useAlpha, true);
+}
+
+void compressBlockDXT5(const unsigned char rgba[64], unsigned char *dst_block)
+{
+    compressBlockRGTC1(rgba + 3, 4, dst_block);
+    compressColorBlock(rgba, dst_block + 8, false, false);
+}
+
+void compressBlockRGTC1(const unsigned char *values, unsigned int stride, unsigned char *dst_block)
+{
+    unsigned char alpha_0 = 0, alpha_1 = 255;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        alpha_0 = osg::maximum(alpha_0, values[i * stride]);
+        alpha_1 = osg::minimum(alpha_1, values[i * stride]);
+    }
+
+    // eight value mode, alpha_0 >= alpha_1: indices 0 and 1 are the endpoints, 2 to 7 interpolate between them
+    float palette[8];
+    palette[0] = alpha_0;
+    palette[1] = alpha_1;
+    for (unsigned int i = 1; i < 7; ++i) palette[i + 1] = (float(7 - i) * alpha_0 + float(i) * alpha_1) / 7.0f;
+
+    dxtc_int64 indices = 0;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        unsigned int index = 0;
+        float minDistance = FLT_MAX;
+        for (unsigned int p = 0; p < 8; ++p)
+        {
+            float distance = fabsf(float(values[i * stride]) - palette[p]);
+            if (distance < minDistance) { minDistance = distance; index = p; }
+        }
+        indices |= static_cast<dxtc_int64>(index) << (3 * i);
+    }
+
+    dst_block[0] = alpha_0;
+    dst_block[1] = alpha_1;
+    for (unsigned int i = 0; i < 6; ++i) dst_block[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
 } // namespace dxtc_tool
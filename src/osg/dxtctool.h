@@ -91,6 +91,17 @@ bool CompressedImageGetColor(unsigned char color[4], unsigned int s, unsigned in
 void compressedBlockOrientationConversion(const GLenum format, const unsigned char *src_block, unsigned char *dst_block, const osg::Vec3i& srcOrigin, const osg::Vec3i& rowDelta, const osg::Vec3i& columnDelta);
 
 void compressedBlockStripAlhpa(const GLenum format, const unsigned char *src_block, unsigned char *dst_block);
+
+// Encode a 4x4 block of RGBA8 pixels, stored row by row, into an 8 byte DXT1 block.
+// When useAlpha is set pixels with alpha below 128 are encoded with the transparent DXT1 index.
+void compressBlockDXT1(const unsigned char rgba[64], unsigned char *dst_block, bool useAlpha);
+
+// Encode a 4x4 block of RGBA8 pixels, stored row by row, into a 16 byte DXT5 block.
+void compressBlockDXT5(const unsigned char rgba[64], unsigned char *dst_block);
+
+// Encode 16 single channel values, read with the given stride, into an 8 byte RGTC1 (BC4) block.
+// A BC5 (RGTC2) block is made of two consecutive RGTC1 blocks, red then green.
+void compressBlockRGTC1(const unsigned char *values, unsigned int stride, unsigned char *dst_block);
 // Class holding reference to DXTC image pixels
 class dxtc_pixels
 {
@@ -16,7 +16,13 @@
 #include <osgDB/Registry>
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
+#include <osg/ParallelFor>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <string.h>
 
 using namespace osgDB;
 
@@ -48,12 +54,478 @@ public:
 
 REGISTER_COMPRESSOR( "null", NullCompressor )
 
+// Base class of compressors splitting the stream into independent blocks, which are
+// compressed and decompressed in parallel with osg::parallelFor(). The block index, i.e.
+// the number of blocks followed by the original and compressed size of each block, is
+// written ahead of the compressed blocks.
+class BlockCompressor : public BaseCompressor
+{
+public:
+    BlockCompressor() : _blockSize(1<<20) {}
+
+    virtual bool compress( std::ostream& fout, const std::string& src )
+    {
+        unsigned int numBlocks = (src.size() + _blockSize - 1) / _blockSize;
+        std::vector<std::string> blocks( numBlocks );
+
+        CompressBlocks compressBlocks( this, src, blocks );
+        osg::parallelFor( numBlocks, compressBlocks );
+        if ( compressBlocks._numFailed>0 ) return false;
+
+        int value = numBlocks;
+        fout.write( (char*)&value, INT_SIZE );
+        for ( unsigned int i=0; i<numBlocks; ++i )
+        {
+            int sizes[2] = { static_cast<int>(blockSize(src, i)), static_cast<int>(blocks[i].size()) };
+            fout.write( (char*)sizes, 2*INT_SIZE );
+        }
+
+        for ( unsigned int i=0; i<numBlocks; ++i )
+        {
+            fout.write( blocks[i].data(), blocks[i].size() );
+        }
+        return !fout.fail();
+    }
+
+    virtual bool decompress( std::istream& fin, std::string& target )
+    {
+        DecompressionStreamBuffer buffer( this, fin );
+        return buffer.readAll( target );
+    }
+
+    virtual std::istream* createDecompressionStream( std::istream& fin )
+    {
+        return new DecompressionStream( this, fin );
+    }
+
+protected:
+    virtual bool compressBlock( const char* src, unsigned int srcSize, std::string& dst ) = 0;
+    virtual bool decompressBlock( const char* src, unsigned int srcSize, char* dst, unsigned int dstSize ) = 0;
+
+    // the largest size compressBlock() can produce for srcSize bytes, bounding the sizes read from a block index
+    virtual std::string::size_type compressedBlockBound( unsigned int srcSize ) const = 0;
+
+    unsigned int blockSize( const std::string& src, unsigned int block ) const
+    { return std::min<std::string::size_type>( src.size() - block*_blockSize, _blockSize ); }
+
+    typedef std::vector<std::string::size_type> Offsets;
+
+    struct CompressBlocks : public osg::ParallelForFunctor
+    {
+        CompressBlocks( BlockCompressor* compressor, const std::string& src, std::vector<std::string>& blocks )
+            : _compressor(compressor), _src(src), _blocks(blocks) {}
+
+        virtual void operator()( unsigned int begin, unsigned int end )
+        {
+            for ( unsigned int block=begin; block<end; ++block )
+            {
+                if ( !_compressor->compressBlock(_src.data() + block*_compressor->_blockSize,
+                                                 _compressor->blockSize(_src, block), _blocks[block]) ) ++_numFailed;
+            }
+        }
+
+        BlockCompressor* _compressor;
+        const std::string& _src;
+        std::vector<std::string>& _blocks;
+        OpenThreads::Atomic _numFailed;
+    };
+
+    struct DecompressBlocks : public osg::ParallelForFunctor
+    {
+        DecompressBlocks( BlockCompressor* compressor, const std::string& src, const Offsets& srcOffsets,
+                          std::vector<char>& dst, const Offsets& dstOffsets )
+            : _compressor(compressor), _src(src), _srcOffsets(srcOffsets), _dst(dst), _dstOffsets(dstOffsets) {}
+
+        virtual void operator()( unsigned int begin, unsigned int end )
+        {
+            for ( unsigned int block=begin; block<end; ++block )
+            {
+                unsigned int dstSize = _dstOffsets[block+1] - _dstOffsets[block];
+                if ( dstSize==0 ) continue;
+                if ( !_compressor->decompressBlock(_src.data() + _srcOffsets[block], _srcOffsets[block+1] - _srcOffsets[block],
+                                                   &_dst[0] + _dstOffsets[block], dstSize) ) ++_numFailed;
+            }
+        }
+
+        BlockCompressor* _compressor;
+        const std::string& _src;
+        const Offsets& _srcOffsets;
+        std::vector<char>& _dst;
+        const Offsets& _dstOffsets;
+        OpenThreads::Atomic _numFailed;
+    };
+
+    // Stream buffer decompressing the blocks of a source stream on demand, a batch of as many blocks
+    // as there are processors at a time, so that only the current batch is held in memory. As with
+    // ZLibInflateStreamBuffer, corrupt or truncated data throws, setting the reading istream's badbit.
+    class DecompressionStreamBuffer : public std::streambuf
+    {
+    public:
+        DecompressionStreamBuffer( BlockCompressor* compressor, std::istream& fin )
+            : _compressor(compressor), _fin(fin), _indexRead(false), _nextBlock(0), _bufferOffset(0),
+              _blocksPerBatch(std::max(OpenThreads::GetNumberOfProcessors(), 1))
+        {
+            setg( 0, 0, 0 );
+        }
+
+        bool readAll( std::string& target )
+        {
+            try
+            {
+                while ( fillBuffer() ) target.append( eback(), egptr() );
+            }
+            catch ( std::ios_base::failure& )
+            {
+                return false;
+            }
+            return true;
+        }
+
+    protected:
+        virtual int_type underflow()
+        {
+            if ( gptr()<egptr() || fillBuffer() )
+                return traits_type::to_int_type( *gptr() );
+            return traits_type::eof();
+        }
+
+        virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which )
+        {
+            if ( dir==std::ios_base::cur )
+                return seekpos( pos_type(_bufferOffset + (gptr()-eback()) + off), which );
+            else if ( dir==std::ios_base::beg )
+                return seekpos( pos_type(off), which );
+            return pos_type(off_type(-1));
+        }
+
+        virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which )
+        {
+            // only seeking within the current batch or forwards is possible
+            off_type target = off_type(pos);
+            if ( !(which&std::ios_base::in) || target<_bufferOffset ) return pos_type(off_type(-1));
+
+            while ( target>_bufferOffset+(egptr()-eback()) )
+            {
+                if ( !fillBuffer() ) return pos_type(off_type(-1));
+            }
+            setg( eback(), eback()+(target-_bufferOffset), egptr() );
+            return pos;
+        }
+
+        void readIndex()
+        {
+            _indexRead = true;
+
+            int numBlocks = 0; _fin.read( (char*)&numBlocks, INT_SIZE );
+            if ( _fin.fail() || numBlocks<0 ) throw std::ios_base::failure( "BlockCompressor: failed to read block index" );
+
+            // the index is untrusted, so it grows as entries are read rather than by the count up front, and sizes no block
+            // written by compress() could have are rejected before any buffer is sized by them
+            for ( int i=0; i<numBlocks; ++i )
+            {
+                int sizes[2] = { 0, 0 }; _fin.read( (char*)sizes, 2*INT_SIZE );
+                if ( _fin.fail() || sizes[0]<0 || sizes[1]<0 ) throw std::ios_base::failure( "BlockCompressor: failed to read block index" );
+
+                if ( static_cast<std::string::size_type>(sizes[0])>_compressor->_blockSize ||
+                     static_cast<std::string::size_type>(sizes[1])>_compressor->compressedBlockBound(sizes[0]) )
+                    throw std::ios_base::failure( "BlockCompressor: invalid block size in block index" );
+
+                _blockSizes.push_back( std::make_pair(sizes[0], sizes[1]) );
+            }
+        }
+
+        bool fillBuffer()
+        {
+            if ( !_indexRead ) readIndex();
+
+            _bufferOffset += egptr() - eback();
+            setg( 0, 0, 0 );
+            if ( _nextBlock>=_blockSizes.size() ) return false;
+
+            // read the compressed data of the next batch of blocks and decompress them in parallel
+            unsigned int numBlocks = std::min<std::size_t>( _blocksPerBatch, _blockSizes.size()-_nextBlock );
+            Offsets sourceOffsets( numBlocks+1, 0 ), targetOffsets( numBlocks+1, 0 );
+            for ( unsigned int i=0; i<numBlocks; ++i )
+            {
+                targetOffsets[i+1] = targetOffsets[i] + _blockSizes[_nextBlock+i].first;
+                sourceOffsets[i+1] = sourceOffsets[i] + _blockSizes[_nextBlock+i].second;
+            }
+            _nextBlock += numBlocks;
+
+            _source.resize( sourceOffsets.back() );
+            if ( !_source.empty() )
+            {
+                _fin.read( &_source[0], _source.size() );
+                if ( _fin.fail() ) throw std::ios_base::failure( "BlockCompressor: compressed stream ends prematurely" );
+            }
+
+            _window.resize( targetOffsets.back() );
+            DecompressBlocks decompressBlocks( _compressor, _source, sourceOffsets, _window, targetOffsets );
+            osg::parallelFor( numBlocks, decompressBlocks );
+            if ( decompressBlocks._numFailed>0 ) throw std::ios_base::failure( "BlockCompressor: failed to decompress block" );
+
+            if ( _window.empty() ) return fillBuffer();
+
+            setg( &_window[0], &_window[0], &_window[0]+_window.size() );
+            return true;
+        }
+
+        BlockCompressor* _compressor;
+        std::istream& _fin;
+        bool _indexRead;
+        std::vector< std::pair<int, int> > _blockSizes;
+        std::size_t _nextBlock;
+        std::streamoff _bufferOffset;
+        unsigned int _blocksPerBatch;
+        std::string _source;
+        std::vector<char> _window;
+    };
+
+    class DecompressionStream : public std::istream
+    {
+    public:
+        DecompressionStream( BlockCompressor* compressor, std::istream& fin ) : std::istream(0), _buffer(compressor, fin) { rdbuf(&_buffer); }
+
+    protected:
+        DecompressionStreamBuffer _buffer;
+    };
+
+    std::string::size_type _blockSize;
+};
+
+#ifdef USE_LZ4
+
+#include <lz4.h>
+
+// LZ4 compressor, much faster than zlib at a lower compression ratio
+class LZ4Compressor : public BlockCompressor
+{
+public:
+    LZ4Compressor() {}
+
+protected:
+    virtual bool compressBlock( const char* src, unsigned int srcSize, std::string& dst )
+    {
+        dst.resize( LZ4_compressBound(srcSize) );
+        int size = LZ4_compress_default( src, &dst[0], srcSize, dst.size() );
+        if ( size<=0 ) return false;
+
+        dst.resize( size );
+        return true;
+    }
+
+    virtual bool decompressBlock( const char* src, unsigned int srcSize, char* dst, unsigned int dstSize )
+    {
+        return LZ4_decompress_safe( src, dst, srcSize, dstSize )==static_cast<int>(dstSize);
+    }
+
+    virtual std::string::size_type compressedBlockBound( unsigned int srcSize ) const
+    {
+        return LZ4_compressBound( srcSize );
+    }
+};
+
+REGISTER_COMPRESSOR( "lz4", LZ4Compressor )
+
+#endif
+
+#ifdef USE_ZSTD
+
+#include <zstd.h>
+
+// Zstandard compressor, comparable ratio to zlib with much faster compression and decompression
+class ZstdCompressor : public BlockCompressor
+{
+public:
+    ZstdCompressor() {}
+
+protected:
+    virtual bool compressBlock( const char* src, unsigned int srcSize, std::string& dst )
+    {
+        int level = 3;
+        dst.resize( ZSTD_compressBound(srcSize) );
+        size_t size = ZSTD_compress( &dst[0], dst.size(), src, srcSize, level );
+        if ( ZSTD_isError(size) ) return false;
+
+        dst.resize( size );
+        return true;
+    }
+
+    virtual bool decompressBlock( const char* src, unsigned int srcSize, char* dst, unsigned int dstSize )
+    {
+        size_t size = ZSTD_decompress( dst, dstSize, src, srcSize );
+        return !ZSTD_isError(size) && size==dstSize;
+    }
+
+    virtual std::string::size_type compressedBlockBound( unsigned int srcSize ) const
+    {
+        return ZSTD_compressBound( srcSize );
+    }
+};
+
+REGISTER_COMPRESSOR( "zstd", ZstdCompressor )
+
+#endif
+
 #ifdef USE_ZLIB
 
 #include <zlib.h>
 
 #define CHUNK 32768
 
+// Stream buffer inflating the data of a source stream on demand, so that only a
+// CHUNK sized window of the decompressed data is held in memory at any time.
+class ZLibInflateStreamBuffer : public std::streambuf
+{
+public:
+    ZLibInflateStreamBuffer( std::istream& fin )
+        : _fin(fin), _bufferOffset(0), _initialized(false), _finished(false)
+    {
+        _strm.zalloc = Z_NULL;
+        _strm.zfree = Z_NULL;
+        _strm.opaque = Z_NULL;
+        _strm.avail_in = 0;
+        _strm.next_in = Z_NULL;
+        _initialized = ( inflateInit2( &_strm,
+                                       15 + 32 )==Z_OK ); // autodetect zlib or gzip header
+        if ( !_initialized ) OSG_INFO << "failed to init" << std::endl;
+
+        setg( _out, _out, _out );
+    }
+
+    virtual ~ZLibInflateStreamBuffer()
+    {
+        if ( _initialized ) (void)inflateEnd( &_strm );
+    }
+
+protected:
+    virtual int_type underflow()
+    {
+        if ( gptr()<egptr() || fillBuffer() )
+            return traits_type::to_int_type( *gptr() );
+        return traits_type::eof();
+    }
+
+    virtual std::streamsize xsgetn( char* s, std::streamsize n )
+    {
+        std::streamsize total = std::min<std::streamsize>( egptr()-gptr(), n );
+        if ( total>0 )
+        {
+            memcpy( s, gptr(), total );
+            gbump( static_cast<int>(total) );
+        }
+
+        if ( n-total>=CHUNK )
+        {
+            // large reads such as array contents are inflated straight into the target memory
+            _bufferOffset += egptr() - eback();
+            setg( _out, _out, _out );
+
+            std::streamsize have = inflateInto( s+total, n-total );
+            _bufferOffset += have;
+            total += have;
+        }
+        else
+        {
+            while ( total<n && (gptr()<egptr() || fillBuffer()) )
+            {
+                std::streamsize count = std::min<std::streamsize>( egptr()-gptr(), n-total );
+                memcpy( s+total, gptr(), count );
+                gbump( static_cast<int>(count) );
+                total += count;
+            }
+        }
+        return total;
+    }
+
+    virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which )
+    {
+        if ( dir==std::ios_base::cur )
+            return seekpos( pos_type(_bufferOffset + (gptr()-eback()) + off), which );
+        else if ( dir==std::ios_base::beg )
+            return seekpos( pos_type(off), which );
+        return pos_type(off_type(-1));
+    }
+
+    virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which )
+    {
+        // only seeking within the current window or forwards is possible, as used by
+        // InputIterator::advanceToCurrentEndBracket() to skip unknown objects
+        off_type target = off_type(pos);
+        if ( !(which&std::ios_base::in) || target<_bufferOffset ) return pos_type(off_type(-1));
+
+        while ( target>_bufferOffset+(egptr()-eback()) )
+        {
+            if ( !fillBuffer() ) return pos_type(off_type(-1));
+        }
+        setg( eback(), eback()+(target-_bufferOffset), egptr() );
+        return pos;
+    }
+
+    bool fillBuffer()
+    {
+        _bufferOffset += egptr() - eback();
+        std::streamsize have = inflateInto( _out, CHUNK );
+        setg( _out, _out, _out+have );
+        return have>0;
+    }
+
+    // a corrupt or truncated stream throws, which the istream reading from this buffer turns into its badbit,
+    // so that InputStream reports the failure rather than reading truncated data.
+    std::streamsize inflateInto( char* dest, std::streamsize size )
+    {
+        if ( _finished ) return 0;
+        if ( !_initialized ) throw std::ios_base::failure( "ZLibCompressor: failed to initialize inflate" );
+
+        _strm.next_out = (Bytef*)dest;
+        _strm.avail_out = static_cast<uInt>(size);
+        while ( _strm.avail_out>0 )
+        {
+            if ( _strm.avail_in==0 )
+            {
+                _fin.read( (char*)_in, CHUNK );
+                _strm.avail_in = _fin.gcount();
+                _strm.next_in = _in;
+                if ( _strm.avail_in==0 )
+                {
+                    _finished = true;
+                    throw std::ios_base::failure( "ZLibCompressor: compressed stream ends prematurely" );
+                }
+            }
+
+            int ret = inflate( &_strm, Z_NO_FLUSH );
+            if ( ret==Z_STREAM_END )
+            {
+                _finished = true;
+                break;
+            }
+            else if ( ret!=Z_OK )
+            {
+                _finished = true;
+                throw std::ios_base::failure( "ZLibCompressor: failed to inflate stream" );
+            }
+        }
+        return size - _strm.avail_out;
+    }
+
+    std::istream& _fin;
+    z_stream _strm;
+    unsigned char _in[CHUNK];
+    char _out[CHUNK];
+    std::streamoff _bufferOffset;
+    bool _initialized;
+    bool _finished;
+};
+
+class ZLibDecompressionStream : public std::istream
+{
+public:
+    ZLibDecompressionStream( std::istream& fin ) : std::istream(0), _buffer(fin) { rdbuf(&_buffer); }
+
+protected:
+    ZLibInflateStreamBuffer _buffer;
+};
+
 // ZLib compressor
 class ZLibCompressor : public BaseCompressor
 {
@@ -127,7 +599,7 @@ public:
         strm.avail_in = 0;
         strm.next_in = Z_NULL;
         ret = inflateInit2( &strm,
-                            15 + 32 ); // autodected zlib or gzip header
+                            15 + 32 ); // autodetect zlib or gzip header
 
         if ( ret!=Z_OK )
         {
@@ -169,8 +641,46 @@ public:
         (void)inflateEnd( &strm );
         return ret==Z_STREAM_END ? true : false;
     }
+
+    virtual std::istream* createDecompressionStream( std::istream& fin )
+    {
+        return new ZLibDecompressionStream( fin );
+    }
 };
 
 REGISTER_COMPRESSOR( "zlib", ZLibCompressor )
 
+// ZLib compressor deflating independent blocks in parallel, trading a slightly lower
+// compression ratio for throughput on multi-core machines
+class ZLibBlockCompressor : public BlockCompressor
+{
+public:
+    ZLibBlockCompressor() {}
+
+protected:
+    virtual bool compressBlock( const char* src, unsigned int srcSize, std::string& dst )
+    {
+        int level = 6;
+        uLongf size = compressBound( srcSize );
+        dst.resize( size );
+        if ( compress2((Bytef*)&dst[0], &size, (const Bytef*)src, srcSize, level)!=Z_OK ) return false;
+
+        dst.resize( size );
+        return true;
+    }
+
+    virtual bool decompressBlock( const char* src, unsigned int srcSize, char* dst, unsigned int dstSize )
+    {
+        uLongf size = dstSize;
+        return uncompress( (Bytef*)dst, &size, (const Bytef*)src, srcSize )==Z_OK && size==dstSize;
+    }
+
+    virtual std::string::size_type compressedBlockBound( unsigned int srcSize ) const
+    {
+        return compressBound( srcSize );
+    }
+};
+
+REGISTER_COMPRESSOR( "zlibmt", ZLibBlockCompressor )
+
 #endif
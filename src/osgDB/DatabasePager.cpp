@@ -16,9 +16,12 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
+#include <osgDB/fstream>
 
 #include <osg/Geode>
+#include <osg/Geometry>
 #include <osg/Timer>
+#include <osg/Trace>
 #include <osg/Texture>
 #include <osg/Notify>
 #include <osg/ProxyNode>
@@ -47,6 +50,8 @@ static osg::ApplicationUsageProxy DatabasePager_e0(osg::ApplicationUsage::ENVIRO
 static osg::ApplicationUsageProxy DatabasePager_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_DRAWABLE <mode>","Set the drawable policy for setting of loaded drawable to specified type.  mode can be one of DoNotModify, DisplayList, VBO or VertexArrays>.");
 static osg::ApplicationUsageProxy DatabasePager_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_PRIORITY <mode>", "Set the thread priority to DEFAULT, MIN, LOW, NOMINAL, HIGH or MAX.");
 static osg::ApplicationUsageProxy DatabasePager_e11(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD <num>","Set the target maximum number of PagedLOD to maintain.");
+static osg::ApplicationUsageProxy DatabasePager_e13(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD_CPU_MEMORY <megabytes>","Set the target maximum CPU memory the paged in subgraphs should occupy.");
+static osg::ApplicationUsageProxy DatabasePager_e14(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD_GPU_MEMORY <megabytes>","Set the target maximum GPU memory the paged in subgraphs should occupy.");
 static osg::ApplicationUsageProxy DatabasePager_e12(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_ASSIGN_PBO_TO_IMAGES <ON/OFF>","Set whether PixelBufferObjects should be assigned to Images to aid download to the GPU.");
 
 // Convert function objects that take pointer args into functions that a
@@ -287,6 +292,127 @@ public:
 };
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MemoryUsageVisitor
+//
+// Estimate the CPU and GPU memory a loaded subgraph will occupy once compiled. Arrays and primitive sets stay in
+// CPU memory and are copied to the GPU when drawn with vertex buffer objects or display lists, images are copied
+// to the GPU, with room for the generated mipmaps, and only stay in CPU memory when their textures keep them.
+// The images are listed separately, as they may be shared with other subgraphs.
+class DatabasePager::MemoryUsageVisitor : public osg::NodeVisitor
+{
+public:
+
+    MemoryUsageVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _cpuMemoryUsage(0),
+        _gpuMemoryUsage(0) {}
+
+    void add(const osg::BufferData* bufferData, bool onGPU)
+    {
+        if (!bufferData || !_bufferData.insert(bufferData).second) return;
+
+        std::size_t size = bufferData->getTotalDataSize();
+        _cpuMemoryUsage += size;
+        if (onGPU) _gpuMemoryUsage += size;
+    }
+
+    void add(const osg::Texture* texture)
+    {
+        if (!_textures.insert(texture).second) return;
+
+        osg::Texture::FilterMode minFilter = texture->getFilter(osg::Texture::MIN_FILTER);
+        bool generatesMipmaps = minFilter!=osg::Texture::LINEAR && minFilter!=osg::Texture::NEAREST;
+
+        for(unsigned int i=0; i<texture->getNumImages(); ++i)
+        {
+            const osg::Image* image = texture->getImage(i);
+            if (!image || !_bufferData.insert(image).second) continue;
+
+            std::size_t size = image->getTotalSizeInBytesIncludingMipmaps();
+            _images.push_back(ImageMemoryUsage(image,
+                                               texture->getUnRefImageDataAfterApply() ? 0 : size,
+                                               (generatesMipmaps && !image->isMipmap()) ? size + size/3 : size));
+        }
+    }
+
+    void add(const osg::StateSet* stateset)
+    {
+        if (!stateset) return;
+
+        const osg::StateSet::TextureAttributeList& textureAttributes = stateset->getTextureAttributeList();
+        for(osg::StateSet::TextureAttributeList::const_iterator litr = textureAttributes.begin();
+            litr != textureAttributes.end();
+            ++litr)
+        {
+            for(osg::StateSet::AttributeList::const_iterator aitr = litr->begin();
+                aitr != litr->end();
+                ++aitr)
+            {
+                const osg::Texture* texture = aitr->second.first->asTexture();
+                if (texture) add(texture);
+            }
+        }
+    }
+
+    virtual void apply(osg::Node& node)
+    {
+        add(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geometry& geometry)
+    {
+        add(geometry.getStateSet());
+
+        bool onGPU = geometry.getUseVertexBufferObjects() || geometry.getUseDisplayList();
+
+        osg::Geometry::ArrayList arrays;
+        geometry.getArrayList(arrays);
+        for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr) add(itr->get(), onGPU);
+
+        osg::Geometry::DrawElementsList drawElements;
+        geometry.getDrawElementsList(drawElements);
+        for(osg::Geometry::DrawElementsList::iterator itr = drawElements.begin(); itr != drawElements.end(); ++itr) add(*itr, onGPU);
+    }
+
+    std::size_t getCPUMemoryUsage() const { return _cpuMemoryUsage; }
+    std::size_t getGPUMemoryUsage() const { return _gpuMemoryUsage; }
+    ImageMemoryUsageList& getImageMemoryUsage() { return _images; }
+
+protected:
+
+    std::set<const osg::BufferData*>    _bufferData;
+    std::set<const osg::Texture*>       _textures;
+    std::size_t                         _cpuMemoryUsage;
+    std::size_t                         _gpuMemoryUsage;
+    ImageMemoryUsageList                _images;
+};
+
+namespace
+{
+
+// Collect the children of the PagedLODs of removed subgraphs, which are the roots of any paged in subgraphs nested within them.
+class CollectPagedLODChildrenVisitor : public osg::NodeVisitor
+{
+public:
+
+    CollectPagedLODChildrenVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    virtual void apply(osg::PagedLOD& plod)
+    {
+        for(unsigned int i=0; i<plod.getNumChildren(); ++i) _children.push_back(plod.getChild(i));
+        traverse(plod);
+    }
+
+    std::vector<const osg::Node*> _children;
+};
+
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  FindCompileableGLObjectsVisitor
@@ -395,22 +521,6 @@ protected:
 };
 
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-//  SortFileRequestFunctor
-//
-struct DatabasePager::SortFileRequestFunctor
-{
-    bool operator() (const osg::ref_ptr<DatabasePager::DatabaseRequest>& lhs,const osg::ref_ptr<DatabasePager::DatabaseRequest>& rhs) const
-    {
-        if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
-        else if (lhs->_timestampLastRequest<rhs->_timestampLastRequest) return false;
-        else return (lhs->_priorityLastRequest>rhs->_priorityLastRequest);
-    }
-};
-
-
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  DatabaseRequest
@@ -430,7 +540,9 @@ void DatabasePager::DatabaseRequest::invalidate()
 //
 DatabasePager::RequestQueue::RequestQueue(DatabasePager* pager):
     _pager(pager),
-    _frameNumberLastPruned(osg::UNINITIALIZED_FRAME_NUMBER)
+    _frameNumberLastPruned(osg::UNINITIALIZED_FRAME_NUMBER),
+    _priorityBucketsValid(false),
+    _frameNumberLastBucketed(osg::UNINITIALIZED_FRAME_NUMBER)
 {
 }
 
@@ -482,6 +594,7 @@ bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
 
                 OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<(*citr)<<std::endl;
                 citr = _requestList.erase(citr);
+                _priorityBucketsValid = false;
             }
         }
 
@@ -518,6 +631,8 @@ void DatabasePager::RequestQueue::clear()
     }
 
     _requestList.clear();
+    _priorityBuckets.clear();
+    _priorityBucketsValid = false;
 
     _frameNumberLastPruned = _pager->_frameNumber;
 
@@ -544,6 +659,7 @@ void DatabasePager::RequestQueue::remove(DatabasePager::DatabaseRequest* databas
         {
             // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
             _requestList.erase(citr);
+            _priorityBucketsValid = false;
             return;
         }
     }
@@ -553,6 +669,15 @@ void DatabasePager::RequestQueue::remove(DatabasePager::DatabaseRequest* databas
 void DatabasePager::RequestQueue::addNoLock(DatabasePager::DatabaseRequest* databaseRequest)
 {
     _requestList.push_back(databaseRequest);
+
+    if (_priorityBucketsValid)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+        RequestList::iterator itr = _requestList.end();
+        --itr;
+        _priorityBuckets[PriorityKey(databaseRequest->_timestampLastRequest, databaseRequest->_priorityLastRequest)].push_back(itr);
+    }
+
     updateBlock();
 }
 
@@ -560,6 +685,36 @@ void DatabasePager::RequestQueue::swap(RequestList& requestList)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
     _requestList.swap(requestList);
+    _priorityBuckets.clear();
+    _priorityBucketsValid = false;
+}
+
+void DatabasePager::RequestQueue::rebuildPriorityBuckets(int frameNumber)
+{
+    _priorityBuckets.clear();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    for(RequestQueue::RequestList::iterator citr = _requestList.begin();
+        citr != _requestList.end();
+        )
+    {
+        if ((*citr)->isRequestCurrent(frameNumber))
+        {
+            _priorityBuckets[PriorityKey((*citr)->_timestampLastRequest, (*citr)->_priorityLastRequest)].push_back(citr);
+            ++citr;
+        }
+        else
+        {
+            invalidate(citr->get());
+
+            OSG_INFO<<"DatabasePager::RequestQueue::rebuildPriorityBuckets(): Pruning "<<(*citr)<<std::endl;
+            citr = _requestList.erase(citr);
+        }
+    }
+
+    _priorityBucketsValid = true;
+    _frameNumberLastBucketed = frameNumber;
+    _frameNumberLastPruned = frameNumber;
 }
 
 void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
@@ -568,42 +723,42 @@ void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& datab
 
     if (!_requestList.empty())
     {
-        DatabasePager::SortFileRequestFunctor highPriority;
-
-        RequestQueue::RequestList::iterator selected_itr = _requestList.end();
-
         int frameNumber = _pager->_frameNumber;
 
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
+        // the requests are only pruned and bucketed by priority once per frame, or after the list has been modified
+        // other than by adding to it, rather than scanning the whole list on every take. Priorities updated by
+        // requestNodeFile() during a frame are picked up on the next frame.
+        if (!_priorityBucketsValid || _frameNumberLastBucketed != static_cast<unsigned int>(frameNumber))
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
+            rebuildPriorityBuckets(frameNumber);
+        }
+
+        while(!_priorityBuckets.empty() && !databaseRequest)
+        {
+            PriorityBuckets::iterator bitr = _priorityBuckets.begin();
+            RequestList::iterator citr = bitr->second.front();
+            bitr->second.pop_front();
+            if (bitr->second.empty()) _priorityBuckets.erase(bitr);
+
             {
-                if (selected_itr==_requestList.end() || highPriority(*citr, *selected_itr))
+                // requests whose group has been removed from the scene graph since the buckets were built are cancelled.
+                OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+                if ((*citr)->isRequestCurrent(frameNumber))
                 {
-                    selected_itr = citr;
+                    databaseRequest = *citr;
+                }
+                else
+                {
+                    invalidate(citr->get());
+                    OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<(*citr)<<std::endl;
                 }
-
-                ++citr;
-            }
-            else
-            {
-                invalidate(citr->get());
-
-                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
             }
 
+            _requestList.erase(citr);
         }
 
-        _frameNumberLastPruned = frameNumber;
-
-        if (selected_itr != _requestList.end())
+        if (databaseRequest.valid())
         {
-            databaseRequest = *selected_itr;
-            _requestList.erase(selected_itr);
             OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestList.size()<<std::endl;
         }
         else
@@ -636,6 +791,33 @@ void DatabasePager::ReadQueue::updateBlock()
 //
 //  DatabaseThread
 //
+namespace
+{
+
+// Read a local file into the OS file cache, so that the thread decoding it then reads it from memory.
+void prefetchFile(const std::string& fileName, const osgDB::Options* loadOptions)
+{
+    // remote files are left to the http threads.
+    if (containsServerAddress(fileName)) return;
+
+    osgDB::FileLocationCallback* fileLocationCallback = loadOptions && loadOptions->getFileLocationCallback() ?
+        loadOptions->getFileLocationCallback() :
+        Registry::instance()->getFileLocationCallback();
+    if (fileLocationCallback && fileLocationCallback->fileLocation(fileName, loadOptions)==FileLocationCallback::REMOTE_FILE) return;
+
+    // files the plugins locate themselves, such as pseudo loaders and files within archives, aren't found here and are simply decoded.
+    std::string foundFileName = findDataFile(fileName, loadOptions);
+    if (foundFileName.empty()) return;
+
+    osgDB::ifstream fin(foundFileName.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return;
+
+    std::vector<char> buffer(1<<20);
+    while(fin.read(&buffer.front(), buffer.size()) || fin.gcount()>0) {}
+}
+
+}
+
 DatabasePager::DatabaseThread::DatabaseThread(DatabasePager* pager, Mode mode, const std::string& name):
     _done(false),
     _active(false),
@@ -678,6 +860,9 @@ int DatabasePager::DatabaseThread::cancel()
             case(HANDLE_ONLY_HTTP):
                 _pager->_httpRequestQueue->release();
                 break;
+            case(HANDLE_FILE_IO):
+                _pager->_ioRequestQueue->release();
+                break;
         }
 
         join();
@@ -694,6 +879,7 @@ void DatabasePager::DatabaseThread::run()
 {
     OSG_INFO<<_name<<": DatabasePager::DatabaseThread::run"<<std::endl;
 
+    osg::setTraceThreadName(_name);
 
     bool firstTime = true;
 
@@ -712,6 +898,10 @@ void DatabasePager::DatabaseThread::run()
         case(HANDLE_ONLY_HTTP):
             read_queue = _pager->_httpRequestQueue;
             break;
+        case(HANDLE_FILE_IO):
+            read_queue = _pager->_ioRequestQueue;
+            out_queue = _pager->_fileRequestQueue;
+            break;
     }
 
 
@@ -737,6 +927,8 @@ void DatabasePager::DatabaseThread::run()
         //
         if (_pager->_deleteRemovedSubgraphsInDatabaseThread/* && !(read_queue->_childrenToDeleteList.empty())*/)
         {
+            OSG_TRACE_ZONE("DatabasePager::deleteRemovedSubgraphs");
+
             ObjectList deleteList;
             {
                 // Don't hold lock during destruction of deleteList
@@ -755,6 +947,40 @@ void DatabasePager::DatabaseThread::run()
         osg::ref_ptr<DatabaseRequest> databaseRequest;
         read_queue->takeFirst(databaseRequest);
 
+        if (_mode==HANDLE_FILE_IO)
+        {
+            if (databaseRequest.valid())
+            {
+                std::string fileName;
+                osg::ref_ptr<Options> loadOptions;
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+                    fileName = databaseRequest->_fileName;
+                    loadOptions = databaseRequest->_loadOptions;
+                }
+
+                {
+                    OSG_TRACE_ZONE_DETAIL("DatabasePager::prefetchFile", fileName);
+                    prefetchFile(fileName, loadOptions.get());
+                }
+
+                // pass the request on to be decoded, unless it went out of date while its file was being read.
+                bool requestCurrent = false;
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+                    requestCurrent = databaseRequest->isRequestCurrent(_pager->_frameNumber);
+                    if (!requestCurrent) databaseRequest->invalidate();
+                }
+
+                if (requestCurrent) out_queue->add(databaseRequest.get());
+            }
+            else
+            {
+                OpenThreads::Thread::YieldCurrentThread();
+            }
+            continue;
+        }
+
         bool readFromFileCache = false;
 
         osg::ref_ptr<FileCache> fileCache = osgDB::Registry::instance()->getFileCache();
@@ -804,10 +1030,16 @@ void DatabasePager::DatabaseThread::run()
                 {
                     //OSG_NOTICE<<"Found object in cache "<<fileName<<std::endl;
 
+                    MemoryUsageVisitor memoryUsage;
+                    if (_pager->isMemoryUsageTracked()) modelFromCache->accept(memoryUsage);
+
                     // assign the cached model to the request
                     {
                         OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
                         databaseRequest->_loadedModel = modelFromCache;
+                        databaseRequest->_cpuMemoryUsage = memoryUsage.getCPUMemoryUsage();
+                        databaseRequest->_gpuMemoryUsage = memoryUsage.getGPUMemoryUsage();
+                        databaseRequest->_imageMemoryUsage.swap(memoryUsage.getImageMemoryUsage());
                     }
 
                     // move the request to the dataToMerge list so it can be merged during the update phase of the frame.
@@ -887,6 +1119,11 @@ void DatabasePager::DatabaseThread::run()
                         // accept all requests, as we'll assume only high latency requests will have got here.
                         break;
                     }
+                    case(HANDLE_FILE_IO):
+                    {
+                        // handled before the requests reach here.
+                        break;
+                    }
                 }
             }
             else
@@ -935,6 +1172,8 @@ void DatabasePager::DatabaseThread::run()
 
             if (loadedModel.valid())
             {
+                OSG_TRACE_ZONE_DETAIL("DatabasePager::prepareLoadedModel", fileName);
+
                 loadedModel->getBound();
 
                 bool loadedObjectsNeedToBeCompiled = false;
@@ -966,11 +1205,17 @@ void DatabasePager::DatabaseThread::run()
                     OSG_NOTICE<<"Loaded from ObjectCache"<<std::endl;
                 }
 
+                // estimate after the drawable policy has been applied as it decides what ends up on the GPU.
+                MemoryUsageVisitor memoryUsage;
+                if (_pager->isMemoryUsageTracked()) loadedModel->accept(memoryUsage);
 
                 {
                     OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
                     databaseRequest->_loadedModel = loadedModel;
                     databaseRequest->_compileSet = compileSet;
+                    databaseRequest->_cpuMemoryUsage = memoryUsage.getCPUMemoryUsage();
+                    databaseRequest->_gpuMemoryUsage = memoryUsage.getGPUMemoryUsage();
+                    databaseRequest->_imageMemoryUsage.swap(memoryUsage.getImageMemoryUsage());
                 }
                 // Dereference the databaseRequest while the queue is
                 // locked. This prevents the request from being
@@ -1090,6 +1335,25 @@ DatabasePager::DatabasePager()
         OSG_NOTICE<<"_targetMaximumNumberOfPageLOD = "<<_targetMaximumNumberOfPageLOD<<std::endl;
     }
 
+    _targetMaximumCPUMemoryUsage = 0;
+    if( (str = getenv("OSG_MAX_PAGEDLOD_CPU_MEMORY")) != 0)
+    {
+        _targetMaximumCPUMemoryUsage = static_cast<std::size_t>(osg::asciiToDouble(str)*1024.0*1024.0);
+        OSG_NOTICE<<"_targetMaximumCPUMemoryUsage = "<<_targetMaximumCPUMemoryUsage<<std::endl;
+    }
+
+    _targetMaximumGPUMemoryUsage = 0;
+    if( (str = getenv("OSG_MAX_PAGEDLOD_GPU_MEMORY")) != 0)
+    {
+        _targetMaximumGPUMemoryUsage = static_cast<std::size_t>(osg::asciiToDouble(str)*1024.0*1024.0);
+        OSG_NOTICE<<"_targetMaximumGPUMemoryUsage = "<<_targetMaximumGPUMemoryUsage<<std::endl;
+    }
+
+    _cpuMemoryUsage = 0;
+    _gpuMemoryUsage = 0;
+    _memoryBudgetFrameNumber = 0;
+    _memoryBudgetInterval = 0;
+
 
     _doPreCompile = true;
     if( (str = getenv("OSG_DO_PRE_COMPILE")) != 0)
@@ -1101,6 +1365,8 @@ DatabasePager::DatabasePager()
     // initialize the stats variables
     resetStats();
 
+    _separateFileIO = false;
+    _ioRequestQueue = new ReadQueue(this,"ioRequestQueue");
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
@@ -1170,9 +1436,17 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
     _deleteRemovedSubgraphsInDatabaseThread = rhs._deleteRemovedSubgraphsInDatabaseThread;
 
     _targetMaximumNumberOfPageLOD = rhs._targetMaximumNumberOfPageLOD;
+    _targetMaximumCPUMemoryUsage = rhs._targetMaximumCPUMemoryUsage;
+    _targetMaximumGPUMemoryUsage = rhs._targetMaximumGPUMemoryUsage;
+    _cpuMemoryUsage = 0;
+    _gpuMemoryUsage = 0;
+    _memoryBudgetFrameNumber = 0;
+    _memoryBudgetInterval = 0;
 
     _doPreCompile = rhs._doPreCompile;
 
+    _separateFileIO = rhs._separateFileIO;
+    _ioRequestQueue = new ReadQueue(this,"ioRequestQueue");
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
@@ -1218,6 +1492,7 @@ DatabasePager::~DatabasePager()
     _databaseThreads.clear();
 
     // destruct all the queues
+    _ioRequestQueue = 0;
     _fileRequestQueue = 0;
     _httpRequestQueue = 0;
     _dataToCompileList = 0;
@@ -1260,6 +1535,7 @@ void DatabasePager::setProcessorAffinity(const OpenThreads::Affinity& affinity)
 void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numHttpThreads)
 {
     _databaseThreads.clear();
+    _separateFileIO = false;
 
     unsigned int numGeneralThreads = numHttpThreads < totalNumThreads ?
         totalNumThreads - numHttpThreads :
@@ -1286,6 +1562,34 @@ void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numH
     }
 }
 
+void DatabasePager::setUpThreadsWithSeparateIO(unsigned int numIOThreads, unsigned int numDecodeThreads, unsigned int numHttpThreads)
+{
+    _databaseThreads.clear();
+    _separateFileIO = false;
+
+    if (numDecodeThreads==0)
+    {
+        int numProcessors = OpenThreads::GetNumberOfProcessors();
+        numDecodeThreads = numProcessors>2 ? static_cast<unsigned int>(numProcessors-1) : 1;
+    }
+
+    for(unsigned int i=0; i<numIOThreads; ++i)
+    {
+        addDatabaseThread(DatabaseThread::HANDLE_FILE_IO, "HANDLE_FILE_IO");
+    }
+
+    for(unsigned int i=0; i<numDecodeThreads; ++i)
+    {
+        addDatabaseThread(numHttpThreads==0 ? DatabaseThread::HANDLE_ALL_REQUESTS : DatabaseThread::HANDLE_NON_HTTP,
+                          numHttpThreads==0 ? "HANDLE_ALL_REQUESTS" : "HANDLE_NON_HTTP");
+    }
+
+    for(unsigned int i=0; i<numHttpThreads; ++i)
+    {
+        addDatabaseThread(DatabaseThread::HANDLE_ONLY_HTTP, "HANDLE_ONLY_HTTP");
+    }
+}
+
 unsigned int DatabasePager::addDatabaseThread(DatabaseThread::Mode mode, const std::string& name)
 {
     OSG_INFO<<"DatabasePager::addDatabaseThread() "<<name<<std::endl;
@@ -1294,6 +1598,9 @@ unsigned int DatabasePager::addDatabaseThread(DatabaseThread::Mode mode, const s
 
     DatabaseThread* thread = new DatabaseThread(this, mode,name);
 
+    // once there is a thread to read the files new requests go through the I/O stage first.
+    if (mode==DatabaseThread::HANDLE_FILE_IO) _separateFileIO = true;
+
     thread->setProcessorAffinity(_affinity);
 
     _databaseThreads.push_back(thread);
@@ -1343,6 +1650,7 @@ int DatabasePager::cancel()
     }
 
     // release the queue blocks in case they are holding up thread cancellation.
+    _ioRequestQueue->release();
     _fileRequestQueue->release();
     _httpRequestQueue->release();
 
@@ -1361,6 +1669,7 @@ int DatabasePager::cancel()
 
 void DatabasePager::clear()
 {
+    _ioRequestQueue->clear();
     _fileRequestQueue->clear();
     _httpRequestQueue->clear();
 
@@ -1370,6 +1679,13 @@ void DatabasePager::clear()
     // note, no need to use a mutex as the list is only accessed from the update thread.
     _activePagedLODList->clear();
 
+    _loadedSubgraphs.clear();
+    _sharedImageMemoryUsage.clear();
+    _cpuMemoryUsage = 0;
+    _gpuMemoryUsage = 0;
+    _memoryBudgetFrameNumber = 0;
+    _memoryBudgetInterval = 0;
+
     // ??
     // _activeGraphicsContexts
 }
@@ -1504,14 +1820,15 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             }
         }
         if (requeue)
-            _fileRequestQueue->add(databaseRequest);
+            getQueueForNewRequests()->add(databaseRequest);
     }
 
     if (!foundEntry)
     {
         OSG_INFO<<"In DatabasePager::requestNodeFile("<<fileName<<")"<<std::endl;
 
-        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+        ReadQueue* requestQueue = getQueueForNewRequests();
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(requestQueue->_requestMutex);
 
         if (!databaseRequestRef.valid() || databaseRequestRef->referenceCount()==1)
         {
@@ -1532,7 +1849,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             databaseRequest->_loadOptions = loadOptions;
             databaseRequest->_objectCache = 0;
 
-            _fileRequestQueue->addNoLock(databaseRequest.get());
+            requestQueue->addNoLock(databaseRequest.get());
         }
     }
 
@@ -1596,6 +1913,10 @@ void DatabasePager::setDatabasePagerThreadPause(bool pause)
     if (_databasePagerThreadPaused == pause) return;
 
     _databasePagerThreadPaused = pause;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_ioRequestQueue->_requestMutex);
+        _ioRequestQueue->updateBlock();
+    }
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
         _fileRequestQueue->updateBlock();
@@ -1614,6 +1935,7 @@ bool DatabasePager::requiresUpdateSceneGraph() const
 
 void DatabasePager::updateSceneGraph(const osg::FrameStamp& frameStamp)
 {
+    OSG_TRACE_ZONE("DatabasePager::updateSceneGraph");
 
 #define UPDATE_TIMING 0
 #if UPDATE_TIMING
@@ -1657,6 +1979,8 @@ bool DatabasePager::requiresRedraw() const
 
 void DatabasePager::addLoadedDataToSceneGraph(const osg::FrameStamp &frameStamp)
 {
+    OSG_TRACE_ZONE("DatabasePager::addLoadedDataToSceneGraph");
+
     double timeStamp = frameStamp.getReferenceTime();
     unsigned int frameNumber = frameStamp.getFrameNumber();
 
@@ -1703,6 +2027,20 @@ void DatabasePager::addLoadedDataToSceneGraph(const osg::FrameStamp &frameStamp)
 
             group->addChild(databaseRequest->_loadedModel.get());
 
+            if (plod && isMemoryUsageTracked())
+            {
+                LoadedSubgraph& loadedSubgraph = _loadedSubgraphs[databaseRequest->_loadedModel.get()];
+                removeMemoryUsage(loadedSubgraph);
+
+                loadedSubgraph.pagedLOD = plod;
+                loadedSubgraph.node = databaseRequest->_loadedModel.get();
+                loadedSubgraph.cpuMemoryUsage = databaseRequest->_cpuMemoryUsage;
+                loadedSubgraph.gpuMemoryUsage = databaseRequest->_gpuMemoryUsage;
+                loadedSubgraph.images.swap(databaseRequest->_imageMemoryUsage);
+
+                addMemoryUsage(loadedSubgraph);
+            }
+
             // Check if parent plod was already registered if not start visitor from parent
             if( plod &&
                 !_activePagedLODList->containsPagedLOD( plod ) )
@@ -1757,6 +2095,7 @@ void DatabasePager::addLoadedDataToSceneGraph(const osg::FrameStamp &frameStamp)
 
 void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
 {
+    OSG_TRACE_ZONE("DatabasePager::removeExpiredSubgraphs");
 
     static double s_total_iter_stage_a = 0.0;
     static double s_total_time_stage_a = 0.0;
@@ -1791,30 +2130,57 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
     if (s_total_max_stage_a<time_a) s_total_max_stage_a = time_a;
 
 
-    if (numPagedLODs <= _targetMaximumNumberOfPageLOD)
+    bool overMemoryBudget = isOverMemoryBudget();
+    if (!overMemoryBudget) _memoryBudgetInterval = 0;
+    if (numPagedLODs <= _targetMaximumNumberOfPageLOD && !overMemoryBudget)
     {
         // nothing to do
         return;
     }
 
-    int numToPrune = numPagedLODs - _targetMaximumNumberOfPageLOD;
-
     ObjectList childrenRemoved;
 
     double expiryTime = frameStamp.getReferenceTime() - 0.1;
     unsigned int expiryFrame = frameStamp.getFrameNumber() - 1;
 
-    // First traverse inactive PagedLODs, as their children will
-    // certainly have expired. Then traverse active nodes if we still
-    // need to prune.
-    //OSG_NOTICE<<"numToPrune "<<numToPrune;
-    if (numToPrune>0)
-        _activePagedLODList->removeExpiredChildren(
-            numToPrune, expiryTime, expiryFrame, childrenRemoved, false);
-    numToPrune = _activePagedLODList->size() - _targetMaximumNumberOfPageLOD;
-    if (numToPrune>0)
-        _activePagedLODList->removeExpiredChildren(
-            numToPrune, expiryTime, expiryFrame, childrenRemoved, true);
+    if (numPagedLODs > _targetMaximumNumberOfPageLOD)
+    {
+        int numToPrune = numPagedLODs - _targetMaximumNumberOfPageLOD;
+
+        // First traverse inactive PagedLODs, as their children will
+        // certainly have expired. Then traverse active nodes if we still
+        // need to prune.
+        //OSG_NOTICE<<"numToPrune "<<numToPrune;
+        if (numToPrune>0)
+            _activePagedLODList->removeExpiredChildren(
+                numToPrune, expiryTime, expiryFrame, childrenRemoved, false);
+        numToPrune = _activePagedLODList->size() - _targetMaximumNumberOfPageLOD;
+        if (numToPrune>0)
+            _activePagedLODList->removeExpiredChildren(
+                numToPrune, expiryTime, expiryFrame, childrenRemoved, true);
+
+        forgetLoadedSubgraphs(childrenRemoved);
+    }
+
+    if (!isOverMemoryBudget())
+    {
+        _memoryBudgetInterval = 0;
+    }
+    else if (frameStamp.getFrameNumber() >= _memoryBudgetFrameNumber)
+    {
+        removeSubgraphsOverMemoryBudget(expiryTime, expiryFrame, childrenRemoved);
+
+        // the loaded subgraphs are still in view, space out the next attempts.
+        if (isOverMemoryBudget())
+        {
+            _memoryBudgetInterval = osg::clampBetween(_memoryBudgetInterval*2, 1u, 64u);
+            _memoryBudgetFrameNumber = frameStamp.getFrameNumber() + _memoryBudgetInterval;
+        }
+        else
+        {
+            _memoryBudgetInterval = 0;
+        }
+    }
 
     osg::Timer_t end_b_Tick = osg::Timer::instance()->tick();
     double time_b = osg::Timer::instance()->delta_m(end_a_Tick,end_b_Tick);
@@ -1854,6 +2220,143 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
                               " C="<<time_c<<" avg="<<s_total_time_stage_c/s_total_iter_stage_c<<" max = "<<s_total_max_stage_c<<std::endl;
 }
 
+void DatabasePager::addMemoryUsage(const LoadedSubgraph& loadedSubgraph)
+{
+    _cpuMemoryUsage += loadedSubgraph.cpuMemoryUsage;
+    _gpuMemoryUsage += loadedSubgraph.gpuMemoryUsage;
+
+    for(ImageMemoryUsageList::const_iterator itr = loadedSubgraph.images.begin();
+        itr != loadedSubgraph.images.end();
+        ++itr)
+    {
+        SharedImageMemoryUsage& shared = _sharedImageMemoryUsage[itr->image];
+        if (shared.numSubgraphs++ > 0) continue;
+
+        shared.cpuMemoryUsage = itr->cpuMemoryUsage;
+        shared.gpuMemoryUsage = itr->gpuMemoryUsage;
+        _cpuMemoryUsage += shared.cpuMemoryUsage;
+        _gpuMemoryUsage += shared.gpuMemoryUsage;
+    }
+}
+
+void DatabasePager::removeMemoryUsage(const LoadedSubgraph& loadedSubgraph)
+{
+    _cpuMemoryUsage -= loadedSubgraph.cpuMemoryUsage;
+    _gpuMemoryUsage -= loadedSubgraph.gpuMemoryUsage;
+
+    for(ImageMemoryUsageList::const_iterator itr = loadedSubgraph.images.begin();
+        itr != loadedSubgraph.images.end();
+        ++itr)
+    {
+        SharedImageMemoryUsageMap::iterator sitr = _sharedImageMemoryUsage.find(itr->image);
+        if (sitr == _sharedImageMemoryUsage.end() || --(sitr->second.numSubgraphs) > 0) continue;
+
+        _cpuMemoryUsage -= sitr->second.cpuMemoryUsage;
+        _gpuMemoryUsage -= sitr->second.gpuMemoryUsage;
+        _sharedImageMemoryUsage.erase(sitr);
+    }
+}
+
+void DatabasePager::forgetLoadedSubgraphs(const ObjectList& childrenRemoved)
+{
+    if (_loadedSubgraphs.empty()) return;
+
+    CollectPagedLODChildrenVisitor cpcv;
+    for(ObjectList::const_iterator itr = childrenRemoved.begin();
+        itr != childrenRemoved.end();
+        ++itr)
+    {
+        osg::Node* node = (*itr)->asNode();
+        if (!node) continue;
+
+        cpcv._children.push_back(node);
+        node->accept(cpcv);
+    }
+
+    for(std::vector<const osg::Node*>::iterator itr = cpcv._children.begin();
+        itr != cpcv._children.end();
+        ++itr)
+    {
+        LoadedSubgraphMap::iterator litr = _loadedSubgraphs.find(*itr);
+        if (litr == _loadedSubgraphs.end()) continue;
+
+        removeMemoryUsage(litr->second);
+        _loadedSubgraphs.erase(litr);
+    }
+}
+
+void DatabasePager::removeSubgraphsOverMemoryBudget(double expiryTime, unsigned int expiryFrame, ObjectList& childrenRemoved)
+{
+    // gather the expirable children, ordered by the frame they were last traversed, dropping the entries of
+    // subgraphs that have been removed from, or no longer sit at the end of, their PagedLOD by other means.
+    typedef std::pair<unsigned int, const osg::Node*> Candidate;
+    std::vector<Candidate> candidates;
+    for(LoadedSubgraphMap::iterator itr = _loadedSubgraphs.begin();
+        itr != _loadedSubgraphs.end();
+        )
+    {
+        osg::ref_ptr<osg::PagedLOD> plod;
+        osg::ref_ptr<osg::Node> node;
+        unsigned int childNo = 0;
+        if (!itr->second.pagedLOD.lock(plod) ||
+            !itr->second.node.lock(node) ||
+            (childNo = plod->getChildIndex(node.get())) >= plod->getNumChildren())
+        {
+            removeMemoryUsage(itr->second);
+            _loadedSubgraphs.erase(itr++);
+            continue;
+        }
+
+        // PagedLOD only expires its last child, the subgraphs nested within it go first.
+        if (childNo+1 == plod->getNumChildren() &&
+            childNo >= plod->getNumChildrenThatCannotBeExpired() &&
+            plod->getFrameNumber(childNo) < expiryFrame)
+        {
+            candidates.push_back(Candidate(plod->getFrameNumber(childNo), itr->first));
+        }
+        ++itr;
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    osg::NodeList expiredPagedLODs;
+    for(std::vector<Candidate>::iterator citr = candidates.begin();
+        citr != candidates.end() && isOverMemoryBudget();
+        ++citr)
+    {
+        // already forgotten as part of an earlier removed subgraph.
+        LoadedSubgraphMap::iterator litr = _loadedSubgraphs.find(citr->second);
+        if (litr == _loadedSubgraphs.end()) continue;
+
+        osg::ref_ptr<osg::PagedLOD> plod;
+        if (!litr->second.pagedLOD.lock(plod)) continue;
+
+        ExpirePagedLODsVisitor expirePagedLODsVisitor;
+        osg::NodeList expiredChildren;
+        if (!expirePagedLODsVisitor.removeExpiredChildrenAndFindPagedLODs(plod.get(), expiryTime, expiryFrame, expiredChildren)) continue;
+
+        for(ExpirePagedLODsVisitor::PagedLODset::iterator pitr = expirePagedLODsVisitor._childPagedLODs.begin();
+            pitr != expirePagedLODsVisitor._childPagedLODs.end();
+            ++pitr)
+        {
+            expiredPagedLODs.push_back(pitr->get());
+        }
+
+        ObjectList removed;
+        for(osg::NodeList::iterator eitr = expiredChildren.begin(); eitr != expiredChildren.end(); ++eitr)
+        {
+            removed.push_back(eitr->get());
+        }
+
+        forgetLoadedSubgraphs(removed);
+        childrenRemoved.splice(childrenRemoved.end(), removed);
+    }
+
+    if (!expiredPagedLODs.empty()) _activePagedLODList->removeNodes(expiredPagedLODs);
+
+    OSG_INFO<<"DatabasePager::removeSubgraphsOverMemoryBudget() cpu="<<_cpuMemoryUsage<<" gpu="<<_gpuMemoryUsage<<" tracked="<<_loadedSubgraphs.size()<<std::endl;
+}
+
 class DatabasePager::FindPagedLODsVisitor : public osg::NodeVisitor
 {
 public:
@@ -20,6 +20,9 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/ObjectWrapper>
 #include <osgDB/ConvertBase64>
+#include <osgDB/MappedFileStream>
+
+#include <string.h>
 
 using namespace osgDB;
 
@@ -1043,11 +1046,15 @@ void InputStream::decompress()
             return;
         }
 
-        if ( !compressor->decompress(*(_in->getStream()), data) )
-            throwException( "InputStream: Failed to decompress stream." );
-        if ( getException() ) return;
+        _dataDecompress = compressor->createDecompressionStream(*(_in->getStream()));
+        if ( !_dataDecompress )
+        {
+            if ( !compressor->decompress(*(_in->getStream()), data) )
+                throwException( "InputStream: Failed to decompress stream." );
+            if ( getException() ) return;
 
-        _dataDecompress = new std::stringstream(data);
+            _dataDecompress = new std::stringstream(data);
+        }
         _in->setStream( _dataDecompress );
         _fields.pop_back();
     }
@@ -1116,7 +1123,18 @@ void InputStream::readArrayImplementation( T* a, unsigned int numComponentsPerEl
         a->resize( size );
         if ( isBinary() )
         {
-            readComponentArray( (char*)&((*a)[0]), size, numComponentsPerElements, componentSizeInBytes );
+            // an uncompressed file read through a memory mapping, with no byte swap needed, is copied straight out of the mapped pages
+            MappedFileStreamBuffer* mapped = _in->getByteSwap() ? 0 : dynamic_cast<MappedFileStreamBuffer*>(_in->getStream()->rdbuf());
+            std::streamsize numBytes = static_cast<std::streamsize>(size) * numComponentsPerElements * componentSizeInBytes;
+            if ( mapped && mapped->getNumBytesRemaining()>=numBytes )
+            {
+                memcpy( &((*a)[0]), mapped->getReadPosition(), numBytes );
+                mapped->advance( numBytes );
+            }
+            else
+            {
+                readComponentArray( (char*)&((*a)[0]), size, numComponentsPerElements, componentSizeInBytes );
+            }
             checkStream();
         }
         else
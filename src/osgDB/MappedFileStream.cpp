@@ -0,0 +1,181 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2008 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/MappedFileStream>
+#include <osgDB/ConvertUTF>
+
+#include <osg/Config>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace osgDB;
+
+MappedFileStreamBuffer::MappedFileStreamBuffer():
+    _data(0),
+    _size(0),
+    _mappingHandle(0)
+{
+}
+
+MappedFileStreamBuffer::~MappedFileStreamBuffer()
+{
+    close();
+}
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+
+bool MappedFileStreamBuffer::open(const char* filename)
+{
+    close();
+
+#ifdef OSG_USE_UTF8_FILENAME
+    HANDLE file = CreateFileW(convertUTF8toUTF16(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#endif
+    if (file==INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart==0 || static_cast<unsigned long long>(size.QuadPart)>static_cast<std::size_t>(-1))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // the mapping keeps the file open, so the file handle itself isn't needed once the mapping exists
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    _data = static_cast<char*>(data);
+    _size = static_cast<std::size_t>(size.QuadPart);
+    _mappingHandle = mapping;
+    setg(_data, _data, _data+_size);
+    return true;
+}
+
+void MappedFileStreamBuffer::close()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+        CloseHandle(static_cast<HANDLE>(_mappingHandle));
+    }
+    _data = 0;
+    _size = 0;
+    _mappingHandle = 0;
+    setg(0, 0, 0);
+}
+
+#else
+
+bool MappedFileStreamBuffer::open(const char* filename)
+{
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd<0) return false;
+
+    struct stat status;
+    if (fstat(fd, &status)!=0 || status.st_size<=0 || static_cast<unsigned long long>(status.st_size)>static_cast<std::size_t>(-1))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // the mapping keeps its own reference to the file, so the descriptor isn't needed once it exists
+    void* data = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data==MAP_FAILED) return false;
+
+    _data = static_cast<char*>(data);
+    _size = static_cast<std::size_t>(status.st_size);
+    setg(_data, _data, _data+_size);
+    return true;
+}
+
+void MappedFileStreamBuffer::close()
+{
+    if (_data) munmap(_data, _size);
+    _data = 0;
+    _size = 0;
+    setg(0, 0, 0);
+}
+
+#endif
+
+MappedFileStreamBuffer::pos_type MappedFileStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    off_type base = 0;
+    if (dir==std::ios_base::cur) base = gptr()-eback();
+    else if (dir==std::ios_base::end) base = egptr()-eback();
+    return seekpos(pos_type(base+off), which);
+}
+
+MappedFileStreamBuffer::pos_type MappedFileStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    off_type target = off_type(pos);
+    if (!(which&std::ios_base::in) || !_data || target<0 || target>off_type(egptr()-eback())) return pos_type(off_type(-1));
+
+    setg(eback(), eback()+target, egptr());
+    return pos;
+}
+
+MappedFileStream::MappedFileStream():
+    std::istream(0)
+{
+    rdbuf(&_buffer);
+    setstate(std::ios_base::failbit);
+}
+
+MappedFileStream::MappedFileStream(const char* filename):
+    std::istream(0)
+{
+    rdbuf(&_buffer);
+    open(filename);
+}
+
+MappedFileStream::~MappedFileStream()
+{
+}
+
+void MappedFileStream::open(const char* filename)
+{
+    if (_buffer.open(filename)) clear();
+    else setstate(std::ios_base::failbit);
+}
+
+void MappedFileStream::close()
+{
+    _buffer.close();
+    setstate(std::ios_base::failbit);
+}
@@ -14,6 +14,17 @@
 #include <osgDB/ObjectCache>
 #include <osgDB/Options>
 
+#include <osg/Geometry>
+#include <osg/Texture>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <set>
+
+#if __cplusplus >= 201103L
+#include <thread>
+#endif
+
 using namespace osgDB;
 
 bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair& lhs, const ObjectCache::FileNameOptionsPair& rhs) const
@@ -36,12 +47,162 @@ bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair&
     return lhs.second < rhs.second;
 }
 
+namespace
+{
+
+#if __cplusplus >= 201103L
+typedef std::thread::id ThreadKey;
+inline ThreadKey currentThreadKey() { return std::this_thread::get_id(); }
+
+// the number of loads the current thread has begun and not yet ended, over all the ObjectCaches.
+thread_local unsigned int s_numLoadsInProgress = 0;
+
+inline void beginCurrentThreadLoad() { ++s_numLoadsInProgress; }
+inline void endCurrentThreadLoad() { --s_numLoadsInProgress; }
+inline bool isCurrentThreadLoading() { return s_numLoadsInProgress>0; }
+#else
+// threads not created through OpenThreads all map to NULL, so can only be told apart from OpenThreads ones.
+typedef OpenThreads::Thread* ThreadKey;
+inline ThreadKey currentThreadKey() { return OpenThreads::Thread::CurrentThread(); }
+
+// the number of loads each thread has begun and not yet ended, over all the ObjectCaches.
+typedef std::map<ThreadKey, unsigned int> NumLoadsInProgressMap;
+
+OpenThreads::Mutex& getNumLoadsInProgressMutex()
+{
+    static OpenThreads::Mutex s_mutex;
+    return s_mutex;
+}
+
+NumLoadsInProgressMap& getNumLoadsInProgressMap()
+{
+    static NumLoadsInProgressMap s_numLoadsInProgress;
+    return s_numLoadsInProgress;
+}
+
+inline void beginCurrentThreadLoad()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getNumLoadsInProgressMutex());
+    ++getNumLoadsInProgressMap()[currentThreadKey()];
+}
+
+inline void endCurrentThreadLoad()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getNumLoadsInProgressMutex());
+    NumLoadsInProgressMap::iterator itr = getNumLoadsInProgressMap().find(currentThreadKey());
+    if (itr!=getNumLoadsInProgressMap().end() && --(itr->second)==0) getNumLoadsInProgressMap().erase(itr);
+}
+
+inline bool isCurrentThreadLoading()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getNumLoadsInProgressMutex());
+    return getNumLoadsInProgressMap().count(currentThreadKey())>0;
+}
+#endif
+
+class MemoryUsageVisitor : public osg::NodeVisitor
+{
+public:
+
+    MemoryUsageVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _memoryUsage(0) {}
+
+    void add(const osg::BufferData* bufferData)
+    {
+        if (bufferData && _bufferData.insert(bufferData).second) _memoryUsage += bufferData->getTotalDataSize();
+    }
+
+    void add(const osg::StateSet* stateset)
+    {
+        if (!stateset) return;
+
+        const osg::StateSet::TextureAttributeList& textureAttributes = stateset->getTextureAttributeList();
+        for(osg::StateSet::TextureAttributeList::const_iterator litr = textureAttributes.begin();
+            litr != textureAttributes.end();
+            ++litr)
+        {
+            for(osg::StateSet::AttributeList::const_iterator aitr = litr->begin();
+                aitr != litr->end();
+                ++aitr)
+            {
+                const osg::Texture* texture = aitr->second.first->asTexture();
+                if (!texture) continue;
+                for(unsigned int i=0; i<texture->getNumImages(); ++i) add(texture->getImage(i));
+            }
+        }
+    }
+
+    virtual void apply(osg::Node& node)
+    {
+        add(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geometry& geometry)
+    {
+        add(geometry.getStateSet());
+
+        osg::Geometry::ArrayList arrays;
+        geometry.getArrayList(arrays);
+        for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr) add(itr->get());
+
+        osg::Geometry::DrawElementsList drawElements;
+        geometry.getDrawElementsList(drawElements);
+        for(osg::Geometry::DrawElementsList::iterator itr = drawElements.begin(); itr != drawElements.end(); ++itr) add(*itr);
+    }
+
+    std::size_t getMemoryUsage() const { return _memoryUsage; }
+
+protected:
+
+    std::set<const osg::BufferData*>    _bufferData;
+    std::size_t                         _memoryUsage;
+};
+
+struct LessAccess
+{
+    template<typename P>
+    bool operator() (const P& lhs, const P& rhs) const { return lhs.first<rhs.first; }
+};
+
+std::size_t estimateMemoryUsage(osg::Object* object)
+{
+    MemoryUsageVisitor muv;
+    if (osg::Node* node = object->asNode()) node->accept(muv);
+    else if (osg::StateSet* stateset = dynamic_cast<osg::StateSet*>(object)) muv.add(stateset);
+    else muv.add(dynamic_cast<osg::BufferData*>(object));
+    return muv.getMemoryUsage();
+}
+
+}
+
+struct ObjectCache::PendingLoad : public osg::Referenced
+{
+    PendingLoad(): owner(currentThreadKey()), completed(false) {}
+
+    ThreadKey                   owner;
+    bool                        completed;
+    osg::ref_ptr<osg::Object>   object;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 // ObjectCache
 //
+ObjectCache::Shard::Shard():
+    memoryUsage(0),
+    accessCount(0)
+{
+}
+
+ObjectCache::Shard::~Shard()
+{
+}
+
 ObjectCache::ObjectCache():
-    osg::Referenced(true)
+    osg::Referenced(true),
+    _maximumMemoryUsage(0)
 {
 //    OSG_NOTICE<<"Constructed ObjectCache"<<std::endl;
 }
@@ -51,54 +212,143 @@ ObjectCache::~ObjectCache()
 //    OSG_NOTICE<<"Destructed ObjectCache"<<std::endl;
 }
 
-void ObjectCache::addObjectCache(ObjectCache* objectCache)
+ObjectCache::Shard& ObjectCache::getShard(const std::string& fileName)
 {
-    // don't allow a cache to be added to itself.
-    if (objectCache==this) return;
+    // FNV-1a hash of the file name, the Options are left out so that all the entries of a file share a shard.
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr = fileName.begin(); itr != fileName.end(); ++itr)
+    {
+        hash ^= static_cast<unsigned char>(*itr);
+        hash *= 16777619u;
+    }
+    return _shards[hash % NUM_SHARDS];
+}
 
-    // lock both ObjectCache to prevent their contents from being modified by other threads while we merge.
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(_objectCacheMutex);
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(objectCache->_objectCacheMutex);
+ObjectCache::ObjectCacheMap::iterator ObjectCache::find(Shard& shard, const std::string& fileName, const osgDB::Options* options)
+{
+    // the entries are sorted by file name, with the one without Options first.
+    for(ObjectCacheMap::iterator itr = shard.objects.lower_bound(FileNameOptionsPair(fileName, 0));
+        itr != shard.objects.end() && itr->first.first==fileName;
+        ++itr)
+    {
+        if (itr->first.second.valid())
+        {
+            if (options && *(itr->first.second)==*options) return itr;
+        }
+        else if (!options) return itr;
+    }
+    return shard.objects.end();
+}
 
-    OSG_DEBUG<<"Inserting objects to main ObjectCache "<<objectCache->_objectCache.size()<<std::endl;
+void ObjectCache::addEntry(Shard& shard, const std::string& fileName, osg::Object* object, double timestamp, const Options* options)
+{
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr != shard.objects.end()) removeEntry(shard, itr);
+
+    CacheEntry& entry = shard.objects[FileNameOptionsPair(fileName, options ? osg::clone(options) : 0)];
+    entry = CacheEntry(object, timestamp, estimateMemoryUsage(object));
+    entry.lastAccess = ++shard.accessCount;
+    shard.memoryUsage += entry.memoryUsage;
+
+    OSG_DEBUG<<"Adding "<<fileName<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
 
-    _objectCache.insert(objectCache->_objectCache.begin(), objectCache->_objectCache.end());
+    applyMemoryBudget(shard);
 }
 
+void ObjectCache::removeEntry(Shard& shard, ObjectCacheMap::iterator itr)
+{
+    shard.memoryUsage -= itr->second.memoryUsage;
+    shard.objects.erase(itr);
+}
 
-void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp, const Options *options)
+void ObjectCache::applyMemoryBudget(Shard& shard)
 {
-    if (!object) return;
+    if (_maximumMemoryUsage==0) return;
+
+    const std::size_t shardBudget = _maximumMemoryUsage / NUM_SHARDS;
+    if (shard.memoryUsage<=shardBudget) return;
+
+    // only objects not referenced elsewhere free memory when removed, oldest access first.
+    typedef std::vector< std::pair<unsigned int, ObjectCacheMap::iterator> > Candidates;
+    Candidates candidates;
+    for(ObjectCacheMap::iterator itr = shard.objects.begin(); itr != shard.objects.end(); ++itr)
+    {
+        if (itr->second.object->referenceCount()==1) candidates.push_back(Candidates::value_type(itr->second.lastAccess, itr));
+    }
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[FileNameOptionsPair(filename, options ? osg::clone(options) : 0)] = ObjectTimeStampPair(object,timestamp);
-    OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
+    std::sort(candidates.begin(), candidates.end(), LessAccess());
+
+    for(Candidates::iterator citr = candidates.begin();
+        citr != candidates.end() && shard.memoryUsage>shardBudget;
+        ++citr)
+    {
+        OSG_DEBUG<<"Removing "<<citr->second->first.first<<" from ObjectCache "<<this<<" to stay within its memory budget"<<std::endl;
+        removeEntry(shard, citr->second);
+    }
 }
 
-ObjectCache::ObjectCacheMap::iterator ObjectCache::find(const std::string& fileName, const osgDB::Options* options)
+std::size_t ObjectCache::getMemoryUsage() const
 {
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
+    std::size_t memoryUsage = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i].mutex);
+        memoryUsage += _shards[i].memoryUsage;
+    }
+    return memoryUsage;
+}
+
+void ObjectCache::addObjectCache(ObjectCache* objectCache)
+{
+    // don't allow a cache to be added to itself.
+    if (objectCache==this) return;
+
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        if (itr->first.first==fileName)
+        // lock both shards to prevent their contents from being modified by other threads while we merge,
+        // entries hash to the same shard index in both caches.
+        Shard& shard = _shards[i];
+        Shard& otherShard = objectCache->_shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(shard.mutex);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(otherShard.mutex);
+
+        OSG_DEBUG<<"Inserting objects to main ObjectCache "<<otherShard.objects.size()<<std::endl;
+
+        for(ObjectCacheMap::iterator itr = otherShard.objects.begin(); itr != otherShard.objects.end(); ++itr)
         {
-            if (itr->first.second.valid())
-            {
-                if (options && *(itr->first.second)==*options) return itr;
-            }
-            else if (!options) return itr;
+            std::pair<ObjectCacheMap::iterator, bool> result = shard.objects.insert(*itr);
+            if (!result.second) continue;
+
+            CacheEntry& entry = result.first->second;
+            entry.lastAccess = ++shard.accessCount;
+            shard.memoryUsage += entry.memoryUsage;
         }
+
+        applyMemoryBudget(shard);
     }
-    return _objectCache.end();
 }
 
 
+void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp, const Options *options)
+{
+    if (!object) return;
+
+    Shard& shard = getShard(filename);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+    addEntry(shard, filename, object, timestamp, options);
+}
+
 osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    return getRefFromObjectCache(fileName, options).get();
+}
+
+osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName, const Options *options)
+{
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard.objects.end())
     {
         osg::ref_ptr<const osgDB::Options> o = itr->first.second;
         if (o.valid())
@@ -109,94 +359,158 @@ osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+        itr->second.lastAccess = ++shard.accessCount;
+        return itr->second.object.get();
     }
     else return 0;
 }
 
-osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName, const Options *options)
+osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCacheOrBeginLoad(const std::string& fileName, const Options *options, bool& loadStarted)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    loadStarted = false;
+
+    // a thread already loading another file mustn't wait, as the loads it waits on could in turn wait on its own.
+    bool currentThreadLoading = isCurrentThreadLoading();
+
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard.objects.end())
     {
-        osg::ref_ptr<const osgDB::Options> o = itr->first.second;
-        if (o.valid())
-        {
-            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< o->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
-        }
-        else
+        itr->second.lastAccess = ++shard.accessCount;
+        return itr->second.object.get();
+    }
+
+    // the pending loads use the same ordering as the entries, so look them up the same way.
+    osg::ref_ptr<PendingLoad> pendingLoad;
+    for(PendingLoadMap::iterator pitr = shard.pendingLoads.lower_bound(FileNameOptionsPair(fileName, 0));
+        pitr != shard.pendingLoads.end() && pitr->first.first==fileName && !pendingLoad;
+        ++pitr)
+    {
+        if (pitr->first.second.valid() ? (options && *(pitr->first.second)==*options) : !options) pendingLoad = pitr->second;
+    }
+
+    if (!pendingLoad)
+    {
+        shard.pendingLoads[FileNameOptionsPair(fileName, options ? osg::clone(options) : 0)] = new PendingLoad;
+        beginCurrentThreadLoad();
+        loadStarted = true;
+        return 0;
+    }
+
+    if (currentThreadLoading) return 0;
+
+    while(!pendingLoad->completed) shard.loadCompleted.wait(&shard.mutex);
+
+    // a failed load is left to the caller to retry so that it gets the reader's error message.
+    return pendingLoad->object;
+}
+
+osg::ref_ptr<osg::Object> ObjectCache::endLoad(const std::string& fileName, osg::Object* object, const Options *options, double timestamp)
+{
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+    osg::ref_ptr<osg::Object> cachedObject = object;
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard.objects.end()) cachedObject = itr->second.object;
+    else if (object) addEntry(shard, fileName, object, timestamp, options);
+
+    ThreadKey key = currentThreadKey();
+    for(PendingLoadMap::iterator pitr = shard.pendingLoads.lower_bound(FileNameOptionsPair(fileName, 0));
+        pitr != shard.pendingLoads.end() && pitr->first.first==fileName;
+        ++pitr)
+    {
+        PendingLoad* pendingLoad = pitr->second.get();
+        if (pendingLoad->owner==key && (pitr->first.second.valid() ? (options && *(pitr->first.second)==*options) : !options))
         {
-            OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
+            pendingLoad->completed = true;
+            pendingLoad->object = cachedObject;
+            shard.pendingLoads.erase(pitr);
+            shard.loadCompleted.broadcast();
+            endCurrentThreadLoad();
+            break;
         }
-        return itr->second.first.get();
     }
-    else return 0;
+
+    return cachedObject;
 }
 
 void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // look for objects with external references and update their time stamp.
-    for(ObjectCacheMap::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        // look for objects with external references and update their time stamp.
+        for(ObjectCacheMap::iterator itr=shard.objects.begin();
+            itr!=shard.objects.end();
+            ++itr)
         {
-            // so update it time stamp.
-            itr->second.second = referenceTime;
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->second.object->referenceCount()>1)
+            {
+                // so update it time stamp.
+                itr->second.timestamp = referenceTime;
+            }
         }
     }
 }
 
 void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // Remove expired entries from object cache
-    ObjectCacheMap::iterator oitr = _objectCache.begin();
-    while(oitr != _objectCache.end())
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        if (oitr->second.second<=expiryTime)
-        {
-#if __cplusplus > 199711L
-            oitr = _objectCache.erase(oitr);
-#else
-            _objectCache.erase(oitr++);
-#endif
-        }
-        else
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        // Remove expired entries from object cache
+        ObjectCacheMap::iterator oitr = shard.objects.begin();
+        while(oitr != shard.objects.end())
         {
-            ++oitr;
+            if (oitr->second.timestamp<=expiryTime)
+            {
+                removeEntry(shard, oitr++);
+            }
+            else
+            {
+                ++oitr;
+            }
         }
     }
 }
 
 void ObjectCache::removeFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end()) _objectCache.erase(itr);
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard.objects.end()) removeEntry(shard, itr);
 }
 
 void ObjectCache::clear()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i].mutex);
+        _shards[i].objects.clear();
+        _shards[i].memoryUsage = 0;
+    }
 }
 
 void ObjectCache::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        osg::Object* object = itr->second.first.get();
-        object->releaseGLObjects(state);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i].mutex);
+
+        for(ObjectCacheMap::iterator itr = _shards[i].objects.begin();
+            itr != _shards[i].objects.end();
+            ++itr)
+        {
+            osg::Object* object = itr->second.object.get();
+            object->releaseGLObjects(state);
+        }
     }
 }
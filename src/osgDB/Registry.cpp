@@ -24,6 +24,7 @@
 #include <osg/ApplicationUsage>
 #include <osg/Version>
 #include <osg/Timer>
+#include <osg/Trace>
 
 #include <osgDB/Registry>
 #include <osgDB/FileUtils>
@@ -72,9 +73,19 @@ extern const char* builtinMimeTypeExtMappings[];
 class Registry::AvailableReaderWriterIterator
 {
 public:
-    AvailableReaderWriterIterator(Registry::ReaderWriterList& rwList, OpenThreads::ReentrantMutex& pluginMutex):
-        _rwList(rwList),
-        _pluginMutex(pluginMutex) {}
+    AvailableReaderWriterIterator(const OpenThreads::AtomicPtr& rwSnapshot, OpenThreads::Atomic& rwSnapshotReaders):
+        _rwSnapshot(rwSnapshot),
+        _rwSnapshotReaders(rwSnapshotReaders)
+    {
+        // count this iterator as a reader before fetching any snapshot so that the snapshots it fetches,
+        // and the ReaderWriters they reference, are kept until it is destructed.
+        ++_rwSnapshotReaders;
+    }
+
+    ~AvailableReaderWriterIterator()
+    {
+        --_rwSnapshotReaders;
+    }
 
 
     ReaderWriter& operator * () { return *get(); }
@@ -92,16 +103,19 @@ protected:
 
     AvailableReaderWriterIterator& operator = (const AvailableReaderWriterIterator&) { return *this; }
 
-    Registry::ReaderWriterList&     _rwList;
-    OpenThreads::ReentrantMutex&    _pluginMutex;
+    const OpenThreads::AtomicPtr&   _rwSnapshot;
+    OpenThreads::Atomic&            _rwSnapshotReaders;
 
     std::set<ReaderWriter*>         _rwUsed;
 
     ReaderWriter* get()
     {
-        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
-        Registry::ReaderWriterList::iterator itr=_rwList.begin();
-        for(;itr!=_rwList.end();++itr)
+        // the latest snapshot is fetched each time so that ReaderWriters added by plugins loaded meanwhile are seen.
+        const Registry::ReaderWriterSnapshot* snapshot = static_cast<const Registry::ReaderWriterSnapshot*>(_rwSnapshot.get());
+        if (!snapshot) return 0;
+
+        Registry::ReaderWriterSnapshot::const_iterator itr=snapshot->begin();
+        for(;itr!=snapshot->end();++itr)
         {
             if (_rwUsed.find(itr->get())==_rwUsed.end())
             {
@@ -507,6 +521,12 @@ void Registry::destruct()
 
     clearArchiveCache();
 
+    // release the earlier ReaderWriter snapshots kept for reads that were in progress when they were replaced,
+    // so the ReaderWriters removed from _rwList aren't kept beyond the plugins that implement them.
+    {
+        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
+        if (!_rwSnapshots.empty()) _rwSnapshots.erase(_rwSnapshots.begin(), --_rwSnapshots.end());
+    }
 
     // unload all the plugin before we finally destruct.
     closeAllLibraries();
@@ -614,6 +634,7 @@ void Registry::addReaderWriter(ReaderWriter* rw)
 
     _rwList.push_back(rw);
 
+    updateReaderWriterSnapshot();
 }
 
 
@@ -629,10 +650,45 @@ void Registry::removeReaderWriter(ReaderWriter* rw)
     if (rwitr!=_rwList.end())
     {
         _rwList.erase(rwitr);
+
+        updateReaderWriterSnapshot();
     }
 
 }
 
+void Registry::updateReaderWriterSnapshot()
+{
+    // called with _pluginMutex held, so there is only ever one writer.
+    _rwSnapshots.push_back(ReaderWriterSnapshot(_rwList.begin(), _rwList.end()));
+    ReaderWriterSnapshot& snapshot = _rwSnapshots.back();
+
+    _rwSnapshot.assign(&snapshot, _rwSnapshot.get());
+
+    // reads count themselves before fetching the snapshot, so when there are no readers once the new snapshot
+    // is published no read can still be using the earlier ones, and they can release their ReaderWriters.
+    if (_rwSnapshotReaders==0)
+    {
+        _rwSnapshots.erase(_rwSnapshots.begin(), --_rwSnapshots.end());
+    }
+}
+
+bool Registry::isReaderWriterSnapshotCurrent() const
+{
+    // called with _pluginMutex held.
+    const ReaderWriterSnapshot* snapshot = static_cast<const ReaderWriterSnapshot*>(_rwSnapshot.get());
+    if (!snapshot) return _rwList.empty();
+    if (snapshot->size()!=_rwList.size()) return false;
+
+    ReaderWriterSnapshot::const_iterator sitr = snapshot->begin();
+    for(ReaderWriterList::const_iterator itr=_rwList.begin();
+        itr!=_rwList.end();
+        ++itr, ++sitr)
+    {
+        if (*itr!=*sitr) return false;
+    }
+    return true;
+}
+
 ImageProcessor* Registry::getImageProcessor()
 {
     {
@@ -870,11 +926,34 @@ DynamicLibrary* Registry::getLibrary(const std::string& fileName)
 
 ReaderWriter* Registry::getReaderWriterForExtension(const std::string& ext)
 {
+    // look through the installed loaders without locking first, as they will handle most requests,
+    // counted as a reader of the snapshot so that its ReaderWriters can't be released during the scan.
+    ++_rwSnapshotReaders;
+    const ReaderWriterSnapshot* snapshot = static_cast<const ReaderWriterSnapshot*>(_rwSnapshot.get());
+    if (snapshot)
+    {
+        for(ReaderWriterSnapshot::const_iterator itr=snapshot->begin();
+            itr!=snapshot->end();
+            ++itr)
+        {
+            if((*itr)->acceptsExtension(ext))
+            {
+                ReaderWriter* rw = itr->get();
+                --_rwSnapshotReaders;
+                return rw;
+            }
+        }
+    }
+    --_rwSnapshotReaders;
+
     // record the existing reader writer.
     std::set<ReaderWriter*> rwOriginal;
 
     OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
 
+    // pick up any changes made directly to the list returned by the deprecated non const getReaderWriterList().
+    if (!isReaderWriterSnapshotCurrent()) updateReaderWriterSnapshot();
+
     // first attempt one of the installed loaders
     for(ReaderWriterList::iterator itr=_rwList.begin();
         itr!=_rwList.end();
@@ -1187,7 +1266,7 @@ ReaderWriter::ReadResult Registry::read(const ReadFunctor& readFunctor)
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::ReadResult rr = readFunctor.doRead(*itr);
@@ -1252,8 +1331,47 @@ ReaderWriter::ReadResult Registry::read(const ReadFunctor& readFunctor)
     return result;
 }
 
+namespace
+{
+
+/** Ends a load begun with ObjectCache::getRefFromObjectCacheOrBeginLoad() when going out of scope without end() having been called,
+  * so that the threads waiting on the load are woken even when the read throws.*/
+class ScopedObjectCacheLoad
+{
+public:
+
+    ScopedObjectCacheLoad(ObjectCache* objectCache, const std::string& fileName, const Options* options):
+        _objectCache(objectCache),
+        _fileName(fileName),
+        _options(options) {}
+
+    ~ScopedObjectCacheLoad()
+    {
+        if (_objectCache) _objectCache->endLoad(_fileName, 0, _options);
+    }
+
+    osg::ref_ptr<osg::Object> end(osg::Object* object)
+    {
+        ObjectCache* objectCache = _objectCache;
+        _objectCache = 0;
+        return objectCache->endLoad(_fileName, object, _options);
+    }
+
+protected:
+
+    ScopedObjectCacheLoad& operator = (const ScopedObjectCacheLoad&) { return *this; }
+
+    ObjectCache*        _objectCache;
+    const std::string&  _fileName;
+    const Options*      _options;
+};
+
+}
+
 ReaderWriter::ReadResult Registry::readImplementation(const ReadFunctor& readFunctor,Options::CacheHintOptions cacheHint)
 {
+    OSG_TRACE_ZONE_DETAIL("Registry::readImplementation", readFunctor._filename);
+
     std::string file(readFunctor._filename);
 
     bool useObjectCache = false;
@@ -1268,10 +1386,19 @@ ReaderWriter::ReadResult Registry::readImplementation(const ReadFunctor& readFun
 
     if (useObjectCache)
     {
+        // new entries go into the Options' cache when there is one.
+        ObjectCache* loadCache = optionsCache ? optionsCache : _objectCache.get();
+
         // search for entry in the object cache.
         osg::ref_ptr<osg::Object> object = optionsCache ? optionsCache->getRefFromObjectCache(file, options) : 0;
 
-        if (!object && _objectCache.valid()) object = _objectCache->getRefFromObjectCache(file, options);
+        if (!object && _objectCache.valid() && loadCache!=_objectCache.get()) object = _objectCache->getRefFromObjectCache(file, options);
+
+        // coalesce with any thread already loading the same file.
+        bool loadStarted = false;
+        if (!object) object = loadCache->getRefFromObjectCacheOrBeginLoad(file, options, loadStarted);
+
+        ScopedObjectCacheLoad scopedLoad(loadStarted ? loadCache : 0, file, options);
 
         if (object.valid())
         {
@@ -1280,27 +1407,27 @@ ReaderWriter::ReadResult Registry::readImplementation(const ReadFunctor& readFun
         }
 
         ReaderWriter::ReadResult rr = read(readFunctor);
-        if (rr.validObject())
-        {
-            // search AGAIN for entry in the object cache.
-            object = _objectCache->getRefFromObjectCache(file, options);
-            if (object.valid())
-            {
-                if (readFunctor.isValid(object.get())) return ReaderWriter::ReadResult(object.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
-                else
-                {
-                    return ReaderWriter::ReadResult("Error file does not contain an osg::Object");
-                }
-            }
 
-            // update cache with new entry.
-            if (optionsCache) optionsCache->addEntryToObjectCache(file, rr.getObject(), 0.0, options);
-            else if (_objectCache.valid()) _objectCache->addEntryToObjectCache(file, rr.getObject(), 0.0, options);
+        // update cache with new entry, or pick up the entry another thread added in the meantime.
+        if (loadStarted)
+        {
+            object = scopedLoad.end(rr.validObject() ? rr.getObject() : 0);
         }
-        else
+        else if (rr.validObject())
+        {
+            object = loadCache->getRefFromObjectCache(file, options);
+            if (!object) loadCache->addEntryToObjectCache(file, rr.getObject(), 0.0, options);
+        }
+
+        if (!rr.validObject())
         {
             OSG_INFO<<"No valid object found for "<<file<<std::endl;
         }
+        else if (object.valid() && object!=rr.getObject())
+        {
+            if (readFunctor.isValid(object.get())) return ReaderWriter::ReadResult(object.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
+            else return ReaderWriter::ReadResult("Error file does not contain an osg::Object");
+        }
 
         return rr;
 
@@ -1343,7 +1470,7 @@ ReaderWriter::WriteResult Registry::writeObjectImplementation(const Object& obj,
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeObject(obj,fileName,options);
@@ -1389,7 +1516,7 @@ ReaderWriter::WriteResult Registry::writeImageImplementation(const Image& image,
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeImage(image,fileName,options);
@@ -1434,7 +1561,7 @@ ReaderWriter::WriteResult Registry::writeHeightFieldImplementation(const HeightF
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeHeightField(HeightField,fileName,options);
@@ -1491,7 +1618,7 @@ ReaderWriter::WriteResult Registry::writeNodeImplementation(const Node& node,con
     Results results;
 
     // first attempt to write the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeNode(node,fileName,options);
@@ -1537,7 +1664,7 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeShader(shader,fileName,options);
@@ -1584,7 +1711,7 @@ ReaderWriter::WriteResult Registry::writeScriptImplementation(const Script& imag
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(_rwSnapshot, _rwSnapshotReaders);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeScript(image,fileName,options);
@@ -18,7 +18,7 @@ using namespace osgDB;
 
 void InputIterator::checkStream() const
 {
-    if (_in->rdstate()&_in->failbit)
+    if (!_failed && (_in->rdstate()&(_in->failbit|_in->badbit)))
     {
         OSG_NOTICE<<"InputIterator::checkStream() : _in->rdstate() "<<_in->rdstate()<<", "<<_in->failbit<<std::endl;
         OSG_NOTICE<<"                               _in->tellg() = "<<_in->tellg()<<std::endl;
@@ -35,14 +35,24 @@ void InputIterator::readComponentArray( char* s, unsigned int numElements, unsig
 
         if (_byteSwap && componentSizeInBytes>1)
         {
+            // swap the whole array as one flat run of components, using the fixed size
+            // swaps for the common sizes so the compiler can unroll and vectorize them
             char* ptr = s;
-            for(unsigned int i=0; i<numElements; ++i)
+            char* end = s + size;
+            switch(componentSizeInBytes)
             {
-                for(unsigned int j=0; j<numComponentsPerElements; ++j)
-                {
-                    osg::swapBytes( ptr, componentSizeInBytes );
-                    ptr += componentSizeInBytes;
-                }
+                case 2:
+                    for(; ptr<end; ptr+=2) osg::swapBytes2( ptr );
+                    break;
+                case 4:
+                    for(; ptr<end; ptr+=4) osg::swapBytes4( ptr );
+                    break;
+                case 8:
+                    for(; ptr<end; ptr+=8) osg::swapBytes8( ptr );
+                    break;
+                default:
+                    for(; ptr<end; ptr+=componentSizeInBytes) osg::swapBytes( ptr, componentSizeInBytes );
+                    break;
             }
         }
     }
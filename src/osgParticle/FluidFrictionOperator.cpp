@@ -54,3 +54,13 @@ void osgParticle::FluidFrictionOperator::operate(Particle* P, double dt)
 
     P->addVelocity(dv);
 }
+
+void osgParticle::FluidFrictionOperator::operateRange(ParticleSystem* ps, unsigned int begin, unsigned int end, double dt)
+{
+    if (!isEnabled()) return;
+    for (unsigned int i=begin; i<end; ++i)
+    {
+        Particle* P = ps->getParticle(i);
+        if (P->isAlive()) FluidFrictionOperator::operate(P, dt);
+    }
+}
@@ -3,6 +3,9 @@
 #include <osgParticle/ParticleSystem>
 #include <osgParticle/Particle>
 
+#include <osg/ParallelFor>
+#include <osg/Trace>
+
 osgParticle::ModularProgram::ModularProgram()
 : Program()
 {
@@ -23,9 +26,55 @@ void osgParticle::ModularProgram::execute(double dt)
     Operator_vector::iterator ci_end = _operators.end();
 
     ParticleSystem* ps = getParticleSystem();
+    if (ps && ps->useParallelUpdate()) {
+        executeInParallel(ps, dt);
+        return;
+    }
+
     for (ci=_operators.begin(); ci!=ci_end; ++ci) {
         (*ci)->beginOperate(this);
         (*ci)->operateParticles(ps, dt);
         (*ci)->endOperate();
     }
 }
+
+namespace
+{
+    struct OperateParticleChunks : public osg::ParallelForFunctor
+    {
+        typedef std::vector< osg::ref_ptr<osgParticle::Operator> > Operator_vector;
+
+        OperateParticleChunks(Operator_vector& operators, osgParticle::ParticleSystem* ps, double dt):
+            _operators(operators), _ps(ps), _dt(dt) {}
+
+        virtual void operator() (unsigned int begin, unsigned int end)
+        {
+            // run all the operators on a chunk while its particles are still in cache.
+            Operator_vector::iterator ci;
+            for (ci=_operators.begin(); ci!=_operators.end(); ++ci) {
+                (*ci)->operateRange(_ps, begin, end, _dt);
+            }
+        }
+
+        Operator_vector& _operators;
+        osgParticle::ParticleSystem* _ps;
+        double _dt;
+    };
+}
+
+void osgParticle::ModularProgram::executeInParallel(ParticleSystem* ps, double dt)
+{
+    OSG_TRACE_ZONE("ModularProgram::executeInParallel");
+
+    Operator_vector::iterator ci;
+    for (ci=_operators.begin(); ci!=_operators.end(); ++ci) {
+        (*ci)->beginOperate(this);
+    }
+
+    OperateParticleChunks functor(_operators, ps, dt);
+    osg::parallelFor(ps->numParticles(), functor, ps->getParallelUpdateChunkSize(), ps->getNumParallelUpdateThreads());
+
+    for (ci=_operators.begin(); ci!=_operators.end(); ++ci) {
+        (*ci)->endOperate();
+    }
+}
@@ -1,6 +1,7 @@
 #include <osgParticle/ParticleSystem>
 
 #include <vector>
+#include <stdlib.h>
 
 #include <osg/Drawable>
 #include <osg/CopyOp>
@@ -15,6 +16,8 @@
 #include <osg/PointSprite>
 #include <osg/Program>
 #include <osg/Notify>
+#include <osg/ParallelFor>
+#include <osg/Trace>
 #include <osg/io_utils>
 
 #include <osgDB/FileUtils>
@@ -55,11 +58,17 @@ osgParticle::ParticleSystem::ParticleSystem()
     _detail(1),
     _sortMode(NO_SORT),
     _visibilityDistance(-1.0),
-    _estimatedMaxNumOfParticles(0)
+    _estimatedMaxNumOfParticles(0),
+    _parallelUpdateThreshold(0),
+    _numParallelUpdateThreads(0),
+    _parallelUpdateChunkSize(4096)
 {
     // we don't support display lists because particle systems
     // are dynamic, and they always changes between frames
     setSupportsDisplayList(false);
+
+    const char* str = getenv("OSG_PARALLEL_PARTICLE_UPDATE");
+    if (str) _parallelUpdateThreshold = atoi(str);
 }
 
 osgParticle::ParticleSystem::ParticleSystem(const ParticleSystem& copy, const osg::CopyOp& copyop)
@@ -87,7 +96,10 @@ osgParticle::ParticleSystem::ParticleSystem(const ParticleSystem& copy, const os
     _detail(copy._detail),
     _sortMode(copy._sortMode),
     _visibilityDistance(copy._visibilityDistance),
-    _estimatedMaxNumOfParticles(0)
+    _estimatedMaxNumOfParticles(0),
+    _parallelUpdateThreshold(copy._parallelUpdateThreshold),
+    _numParallelUpdateThreads(copy._numParallelUpdateThreads),
+    _parallelUpdateChunkSize(copy._parallelUpdateChunkSize)
 {
 }
 
@@ -152,18 +164,25 @@ void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
         }
     }
 
-    for(unsigned int i=0; i<_particles.size(); ++i)
+    if (useParallelUpdate())
+    {
+        updateParticlesInParallel(dt);
+    }
+    else
     {
-        Particle& particle = _particles[i];
-        if (particle.isAlive())
+        for(unsigned int i=0; i<_particles.size(); ++i)
         {
-            if (particle.update(dt, _useShaders))
-            {
-                update_bounds(particle.getPosition(), particle.getCurrentSize());
-            }
-            else
+            Particle& particle = _particles[i];
+            if (particle.isAlive())
             {
-                reuseParticle(i);
+                if (particle.update(dt, _useShaders))
+                {
+                    update_bounds(particle.getPosition(), particle.getCurrentSize());
+                }
+                else
+                {
+                    reuseParticle(i);
+                }
             }
         }
     }
@@ -209,6 +228,103 @@ void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
     dirtyBound();
 }
 
+namespace
+{
+
+struct UpdateParticleChunks : public osg::ParallelForFunctor
+{
+    struct Chunk
+    {
+        Chunk(): bounds_computed(false) {}
+
+        osg::Vec3                   bmin;
+        osg::Vec3                   bmax;
+        bool                        bounds_computed;
+        std::vector<unsigned int>   dead;
+    };
+
+    UpdateParticleChunks(std::vector<osgParticle::Particle>& particles, double dt, bool onlyTimeStamp, unsigned int chunkSize):
+        _particles(particles),
+        _dt(dt),
+        _onlyTimeStamp(onlyTimeStamp),
+        _chunkSize(chunkSize),
+        _chunks((particles.size()+chunkSize-1)/chunkSize) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        Chunk& chunk = _chunks[begin/_chunkSize];
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            osgParticle::Particle& particle = _particles[i];
+            if (!particle.isAlive()) continue;
+
+            if (particle.update(_dt, _onlyTimeStamp))
+            {
+                const osg::Vec3& p = particle.getPosition();
+                float r = particle.getCurrentSize();
+                osg::Vec3 pmin(p.x()-r, p.y()-r, p.z()-r);
+                osg::Vec3 pmax(p.x()+r, p.y()+r, p.z()+r);
+                if (chunk.bounds_computed)
+                {
+                    if (pmin.x() < chunk.bmin.x()) chunk.bmin.x() = pmin.x();
+                    if (pmin.y() < chunk.bmin.y()) chunk.bmin.y() = pmin.y();
+                    if (pmin.z() < chunk.bmin.z()) chunk.bmin.z() = pmin.z();
+                    if (pmax.x() > chunk.bmax.x()) chunk.bmax.x() = pmax.x();
+                    if (pmax.y() > chunk.bmax.y()) chunk.bmax.y() = pmax.y();
+                    if (pmax.z() > chunk.bmax.z()) chunk.bmax.z() = pmax.z();
+                }
+                else
+                {
+                    chunk.bmin = pmin;
+                    chunk.bmax = pmax;
+                    chunk.bounds_computed = true;
+                }
+            }
+            else
+            {
+                chunk.dead.push_back(i);
+            }
+        }
+    }
+
+    std::vector<osgParticle::Particle>& _particles;
+    double                              _dt;
+    bool                                _onlyTimeStamp;
+    unsigned int                        _chunkSize;
+    std::vector<Chunk>                  _chunks;
+};
+
+}
+
+void osgParticle::ParticleSystem::updateParticlesInParallel(double dt)
+{
+    OSG_TRACE_ZONE("ParticleSystem::updateParticlesInParallel");
+
+    UpdateParticleChunks functor(_particles, dt, _useShaders, _parallelUpdateChunkSize);
+    osg::parallelFor(_particles.size(), functor, _parallelUpdateChunkSize, _numParallelUpdateThreads);
+
+    // merge in particle order so the bounds and the death stack end up as the serial update leaves them,
+    // reuseParticle() being virtual and not safe to call from several threads.
+    for(std::vector<UpdateParticleChunks::Chunk>::iterator itr = functor._chunks.begin();
+        itr != functor._chunks.end();
+        ++itr)
+    {
+        if (itr->bounds_computed)
+        {
+            // the chunk's corners already include the particles' sizes.
+            update_bounds(itr->bmin, 0.0f);
+            update_bounds(itr->bmax, 0.0f);
+        }
+
+        for(std::vector<unsigned int>::iterator ditr = itr->dead.begin();
+            ditr != itr->dead.end();
+            ++ditr)
+        {
+            reuseParticle(*ditr);
+        }
+    }
+}
+
 void osgParticle::ParticleSystem::drawImplementation(osg::RenderInfo& renderInfo) const
 {
     ScopedReadLock lock(_readWriteMutex);
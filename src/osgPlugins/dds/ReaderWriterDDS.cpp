@@ -25,6 +25,7 @@
 *
 **********************************************************************/
 #include <osg/Texture>
+#include <osg/ImageUtils>
 #include <osg/Notify>
 
 #include <osgDB/Registry>
@@ -1326,6 +1327,8 @@ public:
         supportsOption("dds_dxt1_detect_rgba","For DXT1 encode images set the pixel format according to presence of transparent pixels");
         supportsOption("dds_flip","Flip the image about the horizontal axis");
         supportsOption("ddsNoAutoFlipWrite", "(Write option) Avoid automatically flipping the image vertically when writing, depending on the origin (Image::getOrigin()).");
+        supportsOption("ddsGenerateMipmaps", "(Write option) Generate the mipmaps of uncompressed images without mipmaps on the CPU before writing.");
+        supportsOption("ddsCompress=<DXT1|DXT1a|DXT5|BC5>", "(Write option) Encode uncompressed 8 bit images to the given block compressed format before writing.");
     }
 
     virtual const char* className() const
@@ -1458,7 +1461,51 @@ public:
     virtual WriteResult writeImage(const osg::Image& image,std::ostream& fout,const Options* options) const
     {
         bool noAutoFlipDDSWrite = options && options->getOptionString().find("ddsNoAutoFlipWrite")!=std::string::npos;
-        bool success = WriteDDSFile(&image, fout, !noAutoFlipDDSWrite);
+
+        bool generateMipmaps = false;
+        GLenum compressedFormat = 0;
+        if (options)
+        {
+            std::istringstream iss(options->getOptionString());
+            std::string opt;
+            while (iss >> opt)
+            {
+                if (opt == "ddsGenerateMipmaps") generateMipmaps = true;
+                if (opt == "ddsCompress=DXT1") compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                if (opt == "ddsCompress=DXT1a") compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+                if (opt == "ddsCompress=DXT5") compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                if (opt == "ddsCompress=BC5") compressedFormat = GL_COMPRESSED_RED_GREEN_RGTC2_EXT;
+            }
+        }
+
+        osg::ref_ptr<const osg::Image> source = &image;
+        if ((generateMipmaps || compressedFormat) && !image.isCompressed())
+        {
+            osg::ref_ptr<osg::Image> copy = new osg::Image(image, osg::CopyOp::DEEP_COPY_ALL);
+
+            // flip before encoding rather than flipping the encoded blocks afterwards
+            if (!noAutoFlipDDSWrite && copy->getOrigin() == osg::Image::BOTTOM_LEFT)
+            {
+                copy->flipVertical();
+                copy->setOrigin(osg::Image::TOP_LEFT);
+            }
+
+            if (generateMipmaps && !copy->isMipmap() && !osg::generateMipmaps(copy.get()))
+            {
+                OSG_WARN<<"Warning: ReaderWriterDDS unable to generate mipmaps for image data type 0x"<<std::hex<<copy->getDataType()<<std::dec<<std::endl;
+            }
+
+            source = copy;
+
+            if (compressedFormat)
+            {
+                osg::ref_ptr<osg::Image> compressed = osg::compressImage(copy.get(), compressedFormat);
+                if (compressed.valid()) source = compressed;
+                else OSG_WARN<<"Warning: ReaderWriterDDS unable to compress image, writing it uncompressed."<<std::endl;
+            }
+        }
+
+        bool success = WriteDDSFile(source.get(), fout, !noAutoFlipDDSWrite);
 
         if(success)
             return WriteResult::FILE_SAVED;
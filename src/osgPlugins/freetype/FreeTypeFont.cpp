@@ -23,6 +23,8 @@
 #include <osg/io_utils>
 #include <osgDB/WriteFile>
 
+#include <sstream>
+
 namespace FreeType
 {
 
@@ -234,6 +236,13 @@ FreeTypeFont::FreeTypeFont(FT_Byte* buffer, FT_Face face, unsigned int flags):
     init();
 }
 
+std::string FreeTypeFont::getGlyphCacheKey() const
+{
+    std::stringstream sstr;
+    sstr<<"freetype_face"<<_face->face_index<<"_flags"<<std::hex<<_flags;
+    return sstr.str();
+}
+
 FreeTypeFont::~FreeTypeFont()
 {
     if(_face)
@@ -31,6 +31,8 @@ public:
 
     virtual std::string getFileName() const { return _filename; }
 
+    virtual std::string getGlyphCacheKey() const;
+
     virtual bool supportsMultipleFontResolutions() const { return true; }
 
     virtual osgText::Glyph* getGlyph(const osgText::FontResolution& fontRes, unsigned int charcode);
@@ -16,6 +16,7 @@
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
+#include <osgDB/MappedFileStream>
 #include <stdlib.h>
 #include "AsciiStreamOperator.h"
 #include "BinaryStreamOperator.h"
@@ -79,6 +80,19 @@ InputIterator* readInputIterator( std::istream& fin, const Options* options )
     return NULL;
 }
 
+bool useMemoryMap( const Options* options )
+{
+    if ( !options ) return false;
+
+    std::istringstream iss( options->getOptionString() );
+    std::string opt;
+    while ( iss >> opt )
+    {
+        if ( opt=="MemoryMap" ) return true;
+    }
+    return false;
+}
+
 OutputIterator* writeOutputIterator( std::ostream& fout, const Options* options )
 {
     // Read precision parameter, for text & XML formats
@@ -131,6 +145,7 @@ public:
         supportsOption( "SchemaData", "Export option: Record inbuilt schema data into a binary file" );
         supportsOption( "SchemaFile=<file>", "Import/Export option: Use/Record an ascii schema file" );
         supportsOption( "Compressor=<name>", "Export option: Use an inbuilt or user-defined compressor" );
+        supportsOption( "MemoryMap", "Import option: Read the file through a memory mapping, uncompressed binary arrays being copied straight out of it" );
         supportsOption( "WriteImageHint=<hint>", "Export option: Hint of writing image to stream: "
                         "<IncludeData> writes Image::data() directly; "
                         "<IncludeFile> writes the image file itself to stream; "
@@ -182,6 +197,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMap(local_opt) )
+        {
+            osgDB::MappedFileStream mappedStream( fileName.c_str() );
+            if ( mappedStream ) return readObject( mappedStream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readObject( istream, local_opt );
     }
@@ -213,6 +234,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMap(local_opt) )
+        {
+            osgDB::MappedFileStream mappedStream( fileName.c_str() );
+            if ( mappedStream ) return readImage( mappedStream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readImage( istream, local_opt );
     }
@@ -244,6 +271,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMap(local_opt) )
+        {
+            osgDB::MappedFileStream mappedStream( fileName.c_str() );
+            if ( mappedStream ) return readNode( mappedStream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readNode( istream, local_opt );
     }
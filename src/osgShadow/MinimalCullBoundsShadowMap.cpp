@@ -61,10 +61,12 @@ void MinimalCullBoundsShadowMap::ViewData::cullShadowReceivingScene( )
 {
     RenderLeafList rllOld, rllNew;
 
+    _cv->addDeferredRenderLeaves();
     GetRenderLeaves( _cv->getRenderStage(), rllOld );
 
     MinimalShadowMap::ViewData::cullShadowReceivingScene( );
 
+    _cv->addDeferredRenderLeaves();
     GetRenderLeaves( _cv->getRenderStage(), rllNew );
 
     RemoveOldRenderLeaves( rllNew, rllOld );
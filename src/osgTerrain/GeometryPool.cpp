@@ -770,6 +770,145 @@ osg::StateSet* GeometryPool::getRootStateSetForTerrain(Terrain* /*terrain*/)
     return _rootStateSet.get();
 }
 
+namespace
+{
+
+// the grid vertices the skirt hangs from, side by side anticlockwise from the bottom left corner, returning the number on each side.
+void computeGridSkirtVertices(unsigned int numColumns, unsigned int numRows, std::vector<unsigned int>& skirtVertices, unsigned int sideSizes[4])
+{
+    int nc = static_cast<int>(numColumns);
+    int nr = static_cast<int>(numRows);
+    int c, r;
+
+    skirtVertices.clear();
+    skirtVertices.reserve((nc+nr)*2);
+
+    for(c=0; c<nc; ++c) skirtVertices.push_back(c);
+    for(r=0; r<nr; ++r) skirtVertices.push_back(r*nc+nc-1);
+    for(c=nc-1; c>=0; --c) skirtVertices.push_back((nr-1)*nc+c);
+    for(r=nr-1; r>=0; --r) skirtVertices.push_back(r*nc);
+
+    sideSizes[0] = numColumns;
+    sideSizes[1] = numRows;
+    sideSizes[2] = numColumns;
+    sideSizes[3] = numRows;
+}
+
+osg::DrawElements* createDrawElements(GLenum mode, bool smallGrid)
+{
+    return smallGrid ? static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(mode)) :
+                       static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(mode));
+}
+
+}
+
+osg::ref_ptr<osg::Vec2Array> GeometryPool::getOrCreateGridTexCoords(unsigned int numColumns, unsigned int numRows, bool createSkirt)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_gridMapMutex);
+
+    osg::ref_ptr<osg::Vec2Array>& texcoords = _gridTexCoordsMap[GridKey(numColumns, numRows, createSkirt, false)];
+    if (texcoords.valid()) return texcoords;
+
+    texcoords = new osg::Vec2Array;
+    texcoords->reserve(numColumns*numRows + (createSkirt ? (numColumns+numRows)*2 : 0));
+
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            texcoords->push_back(osg::Vec2(double(c)/double(numColumns-1), double(r)/double(numRows-1)));
+        }
+    }
+
+    if (createSkirt)
+    {
+        std::vector<unsigned int> skirtVertices;
+        unsigned int sideSizes[4];
+        computeGridSkirtVertices(numColumns, numRows, skirtVertices, sideSizes);
+
+        for(std::vector<unsigned int>::iterator itr = skirtVertices.begin();
+            itr != skirtVertices.end();
+            ++itr)
+        {
+            texcoords->push_back((*texcoords)[*itr]);
+        }
+    }
+
+    // give the array its own buffer object so the geometries sharing it don't each assign their own.
+    texcoords->setVertexBufferObject(new osg::VertexBufferObject);
+
+    return texcoords;
+}
+
+void GeometryPool::getOrCreateGridPrimitiveSets(unsigned int numColumns, unsigned int numRows, bool createSkirt, bool swapOrientation, osg::Geometry::PrimitiveSetList& primitiveSets)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_gridMapMutex);
+
+    osg::Geometry::PrimitiveSetList& gridPrimitiveSets = _gridPrimitiveSetsMap[GridKey(numColumns, numRows, createSkirt, swapOrientation)];
+    if (gridPrimitiveSets.empty())
+    {
+        unsigned int numVertices = numColumns*numRows + (createSkirt ? (numColumns+numRows)*2 : 0);
+        bool smallGrid = numVertices < 65536;
+
+        osg::ref_ptr<osg::ElementBufferObject> ebo = new osg::ElementBufferObject;
+
+        osg::ref_ptr<osg::DrawElements> elements = createDrawElements(GL_TRIANGLES, smallGrid);
+        elements->reserveElements((numRows-1) * (numColumns-1) * 6);
+
+        for(unsigned int j=0; j<numRows-1; ++j)
+        {
+            for(unsigned int i=0; i<numColumns-1; ++i)
+            {
+                unsigned int i00 = j*numColumns+i;
+                unsigned int i01 = (j+1)*numColumns+i;
+                unsigned int i10 = i00+1;
+                unsigned int i11 = i01+1;
+
+                if (swapOrientation)
+                {
+                    std::swap(i00,i01);
+                    std::swap(i10,i11);
+                }
+
+                elements->addElement(i01);
+                elements->addElement(i00);
+                elements->addElement(i11);
+
+                elements->addElement(i00);
+                elements->addElement(i10);
+                elements->addElement(i11);
+            }
+        }
+
+        elements->setElementBufferObject(ebo.get());
+        gridPrimitiveSets.push_back(elements.get());
+
+        if (createSkirt)
+        {
+            std::vector<unsigned int> skirtVertices;
+            unsigned int sideSizes[4];
+            computeGridSkirtVertices(numColumns, numRows, skirtVertices, sideSizes);
+
+            unsigned int skirt_i = 0;
+            for(unsigned int side=0; side<4; ++side)
+            {
+                osg::ref_ptr<osg::DrawElements> skirtDrawElements = createDrawElements(GL_QUAD_STRIP, smallGrid);
+                skirtDrawElements->reserveElements(sideSizes[side]*2);
+                for(unsigned int k=0; k<sideSizes[side]; ++k, ++skirt_i)
+                {
+                    skirtDrawElements->addElement(skirtVertices[skirt_i]);
+                    skirtDrawElements->addElement(numColumns*numRows+skirt_i);
+                }
+
+                skirtDrawElements->setElementBufferObject(ebo.get());
+                gridPrimitiveSets.push_back(skirtDrawElements.get());
+            }
+        }
+    }
+
+    primitiveSets = gridPrimitiveSets;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  SharedGeometry
@@ -25,19 +25,32 @@
 #include <osg/Program>
 #include <osg/Math>
 #include <osg/Timer>
+#include <osg/ParallelFor>
+#include <osg/Trace>
+
+#include <stdlib.h>
+#include <set>
 
 using namespace osgTerrain;
 
-GeometryTechnique::GeometryTechnique()
+GeometryTechnique::GeometryTechnique():
+    _parallelBuildThreshold(4096),
+    _numParallelBuildThreads(0),
+    _shareGridIndices(false)
 {
     setFilterBias(0);
     setFilterWidth(0.1);
     setFilterMatrixAs(GAUSSIAN);
 
+    const char* str = getenv("OSG_PARALLEL_TERRAIN_BUILD");
+    if (str) _parallelBuildThreshold = atoi(str);
 }
 
 GeometryTechnique::GeometryTechnique(const GeometryTechnique& gt,const osg::CopyOp& copyop):
-    TerrainTechnique(gt,copyop)
+    TerrainTechnique(gt,copyop),
+    _parallelBuildThreshold(gt._parallelBuildThreshold),
+    _numParallelBuildThreads(gt._numParallelBuildThreads),
+    _shareGridIndices(gt._shareGridIndices)
 {
     setFilterBias(gt._filterBias);
     setFilterWidth(gt._filterWidth);
@@ -239,18 +252,23 @@ class VertexNormalGenerator
         typedef std::pair< osg::ref_ptr<osg::Vec2Array>, Locator* > TexCoordLocatorPair;
         typedef std::map< Layer*, TexCoordLocatorPair > LayerToTexCoordMap;
 
-        VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColmns, float scaleHeight, bool createSkirt);
+        VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColmns, float scaleHeight, bool createSkirt, unsigned int numThreads);
 
-        void populateCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap);
+        bool sampleCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap);
+        void sampleRows(osgTerrain::Layer* elevationLayer, bool sampled, LayerToTexCoordMap& layerToTexCoordMap, int beginRow, int endRow);
+        void populateCenter(LayerToTexCoordMap& layerToTexCoordMap);
         void populateLeftBoundary(osgTerrain::Layer* elevationLayer);
         void populateRightBoundary(osgTerrain::Layer* elevationLayer);
         void populateAboveBoundary(osgTerrain::Layer* elevationLayer);
         void populateBelowBoundary(osgTerrain::Layer* elevationLayer);
 
         void computeNormals();
+        void computeNormals(int beginRow, int endRow);
 
         unsigned int capacity() const { return _vertices->capacity(); }
 
+        int numRowsPerChunk() const { return osg::maximum(1, 1024/_numColumns); }
+
         inline void setVertex(int c, int r, const osg::Vec3& v, const osg::Vec3& n)
         {
             int& i = index(c,r);
@@ -417,14 +435,70 @@ class VertexNormalGenerator
 
         osg::ref_ptr<osg::Vec3Array>    _boundaryVertices;
 
+        unsigned int                    _numThreads;
+
+        struct Sample
+        {
+            Sample(): valid(false) {}
+
+            osg::Vec3d  ndc;
+            osg::Vec3d  model;
+            osg::Vec3d  normal;
+            bool        valid;
+        };
+
+        typedef std::vector<Sample> Samples;
+        typedef std::vector< std::vector<osg::Vec2> > SampleTexCoords;
+        typedef std::set<osg::Vec2Array*> SharedTexCoords;
+
+        // the center vertices and the texture coordinates of each layer, computed by sampleCenter() and added by populateCenter()
+        Samples                         _samples;
+        SampleTexCoords                 _sampleTexCoords;
+
+        // texture coordinate arrays shared with other tiles, to which populateCenter() and the skirts add nothing
+        SharedTexCoords                 _sharedTexCoords;
+};
+
+namespace
+{
+
+struct SampleRowsFunctor : public osg::ParallelForFunctor
+{
+    SampleRowsFunctor(VertexNormalGenerator& vng, osgTerrain::Layer* elevationLayer, bool sampled, VertexNormalGenerator::LayerToTexCoordMap& layerToTexCoordMap):
+        _vng(vng), _elevationLayer(elevationLayer), _sampled(sampled), _layerToTexCoordMap(layerToTexCoordMap) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        _vng.sampleRows(_elevationLayer, _sampled, _layerToTexCoordMap, begin, end);
+    }
+
+    VertexNormalGenerator&                      _vng;
+    osgTerrain::Layer*                          _elevationLayer;
+    bool                                        _sampled;
+    VertexNormalGenerator::LayerToTexCoordMap&  _layerToTexCoordMap;
 };
 
-VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColumns, float scaleHeight, bool createSkirt):
+struct ComputeNormalsFunctor : public osg::ParallelForFunctor
+{
+    ComputeNormalsFunctor(VertexNormalGenerator& vng): _vng(vng) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        _vng.computeNormals(begin, end);
+    }
+
+    VertexNormalGenerator& _vng;
+};
+
+}
+
+VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColumns, float scaleHeight, bool createSkirt, unsigned int numThreads):
     _masterLocator(masterLocator),
     _centerModel(centerModel),
     _numRows(numRows),
     _numColumns(numColumns),
-    _scaleHeight(scaleHeight)
+    _scaleHeight(scaleHeight),
+    _numThreads(numThreads)
 {
     int numVerticesInBody = numColumns*numRows;
     int numVerticesInSkirt = createSkirt ? numColumns*2 + numRows*2 - 4 : 0;
@@ -445,19 +519,40 @@ VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::
     _boundaryVertices->reserve(_numRows*2 + _numColumns*2 + 4);
 }
 
-void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap)
+bool VertexNormalGenerator::sampleCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap)
 {
-    // OSG_NOTICE<<std::endl<<"VertexNormalGenerator::populateCenter("<<elevationLayer<<")"<<std::endl;
-
     bool sampled = elevationLayer &&
                    ( (elevationLayer->getNumRows()!=static_cast<unsigned int>(_numRows)) ||
                      (elevationLayer->getNumColumns()!=static_cast<unsigned int>(_numColumns)) );
 
-    for(int j=0; j<_numRows; ++j)
+    _samples.clear();
+    _samples.resize(_numRows*_numColumns);
+
+    _sampleTexCoords.clear();
+    _sampleTexCoords.resize(layerToTexCoordMap.size(), std::vector<osg::Vec2>(_numRows*_numColumns));
+
+    // the rows are independent so are sampled in parallel, leaving populateCenter() to add the valid samples in order.
+    SampleRowsFunctor functor(*this, elevationLayer, sampled, layerToTexCoordMap);
+    osg::parallelFor(_numRows, functor, numRowsPerChunk(), _numThreads);
+
+    for(Samples::const_iterator itr = _samples.begin();
+        itr != _samples.end();
+        ++itr)
+    {
+        if (!itr->valid) return false;
+    }
+    return true;
+}
+
+void VertexNormalGenerator::sampleRows(osgTerrain::Layer* elevationLayer, bool sampled, LayerToTexCoordMap& layerToTexCoordMap, int beginRow, int endRow)
+{
+    for(int j=beginRow; j<endRow; ++j)
     {
         for(int i=0; i<_numColumns; ++i)
         {
-            osg::Vec3d ndc( ((double)i)/(double)(_numColumns-1), ((double)j)/(double)(_numRows-1), 0.0);
+            Sample& sample = _samples[j*_numColumns+i];
+            osg::Vec3d& ndc = sample.ndc;
+            ndc.set( ((double)i)/(double)(_numColumns-1), ((double)j)/(double)(_numRows-1), 0.0);
 
             bool validValue = true;
             if (elevationLayer)
@@ -470,14 +565,17 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, La
 
             if (validValue)
             {
-                osg::Vec3d model;
+                sample.valid = true;
+
+                osg::Vec3d& model = sample.model;
                 _masterLocator->convertLocalToModel(ndc, model);
 
+                unsigned int layerIndex = 0;
                 for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
                     itr != layerToTexCoordMap.end();
-                    ++itr)
+                    ++itr, ++layerIndex)
                 {
-                    osg::Vec2Array* texcoords = itr->second.first.get();
+                    osg::Vec2& texcoord = _sampleTexCoords[layerIndex][j*_numColumns+i];
                     osgTerrain::ImageLayer* imageLayer(dynamic_cast<osgTerrain::ImageLayer*>(itr->first));
 
                     if (imageLayer != NULL)
@@ -487,11 +585,11 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, La
                         {
                             osg::Vec3d color_ndc;
                             Locator::convertLocalCoordBetween(*_masterLocator, ndc, *colorLocator, color_ndc);
-                            (*texcoords).push_back(osg::Vec2(color_ndc.x(), color_ndc.y()));
+                            texcoord.set(color_ndc.x(), color_ndc.y());
                         }
                         else
                         {
-                            (*texcoords).push_back(osg::Vec2(ndc.x(), ndc.y()));
+                            texcoord.set(ndc.x(), ndc.y());
                         }
                     }
                     else
@@ -521,32 +619,55 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, La
 
                                     color_ndc[2] /= _scaleHeight;
 
-                                    (*texcoords).push_back(osg::Vec2((color_ndc[2]-transferFunction->getMinimum())/difference,0.0f));
+                                    texcoord.set((color_ndc[2]-transferFunction->getMinimum())/difference,0.0f);
                                     texCoordSet = true;
                                 }
                             }
                         }
                         if (!texCoordSet)
                         {
-                            (*texcoords).push_back(osg::Vec2(0.0f,0.0f));
+                            texcoord.set(0.0f,0.0f);
                         }
                     }
                 }
 
-                if (_elevations.valid())
-                {
-                    (*_elevations).push_back(ndc.z());
-                }
-
                 // compute the local normal
                 osg::Vec3d ndc_one = ndc; ndc_one.z() += 1.0;
-                osg::Vec3d model_one;
+                osg::Vec3d& model_one = sample.normal;
                 _masterLocator->convertLocalToModel(ndc_one, model_one);
                 model_one = model_one - model;
                 model_one.normalize();
+            }
+        }
+    }
+}
 
-                setVertex(i, j, osg::Vec3(model-_centerModel), model_one);
+void VertexNormalGenerator::populateCenter(LayerToTexCoordMap& layerToTexCoordMap)
+{
+    // OSG_NOTICE<<std::endl<<"VertexNormalGenerator::populateCenter()"<<std::endl;
+
+    for(int j=0; j<_numRows; ++j)
+    {
+        for(int i=0; i<_numColumns; ++i)
+        {
+            const Sample& sample = _samples[j*_numColumns+i];
+            if (!sample.valid) continue;
+
+            unsigned int layerIndex = 0;
+            for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
+                itr != layerToTexCoordMap.end();
+                ++itr, ++layerIndex)
+            {
+                osg::Vec2Array* texcoords = itr->second.first.get();
+                if (_sharedTexCoords.count(texcoords)==0) texcoords->push_back(_sampleTexCoords[layerIndex][j*_numColumns+i]);
+            }
+
+            if (_elevations.valid())
+            {
+                (*_elevations).push_back(sample.ndc.z());
             }
+
+            setVertex(i, j, osg::Vec3(sample.model-_centerModel), sample.normal);
         }
     }
 }
@@ -734,9 +855,16 @@ void VertexNormalGenerator::populateBelowBoundary(osgTerrain::Layer* elevationLa
 
 
 void VertexNormalGenerator::computeNormals()
+{
+    // each normal only reads the vertices, so the rows can be computed in parallel.
+    ComputeNormalsFunctor functor(*this);
+    osg::parallelFor(_numRows, functor, numRowsPerChunk(), _numThreads);
+}
+
+void VertexNormalGenerator::computeNormals(int beginRow, int endRow)
 {
     // compute normals for the center section
-    for(int j=0; j<_numRows; ++j)
+    for(int j=beginRow; j<endRow; ++j)
     {
         for(int i=0; i<_numColumns; ++i)
         {
@@ -747,8 +875,84 @@ void VertexNormalGenerator::computeNormals()
     }
 }
 
+class SkirtGenerator
+{
+    public:
+
+        SkirtGenerator(VertexNormalGenerator& vng, VertexNormalGenerator::LayerToTexCoordMap& layerToTexCoordMap, const osg::Vec3Array& skirtVectors, float skirtHeight, osg::Geometry* geometry, bool smallTile):
+            _vng(vng),
+            _layerToTexCoordMap(layerToTexCoordMap),
+            _skirtVectors(skirtVectors),
+            _skirtHeight(skirtHeight),
+            _geometry(geometry),
+            _smallTile(smallTile) {}
+
+        /** Add a skirt vertex below the vertex at column c and row r, and to the current quad strip when there is a geometry
+          * to add the strips to. Where there is no vertex the current quad strip is ended instead.*/
+        void addVertex(int c, int r)
+        {
+            int orig_i = _vng.vertex_index(c,r); // index of original vertex of grid
+            if (orig_i<0)
+            {
+                endStrip();
+                return;
+            }
+
+            osg::Vec3Array& vertices = *(_vng._vertices);
+            osg::Vec3Array& normals = *(_vng._normals);
+
+            unsigned int new_i = vertices.size(); // index of new index of added skirt point
+            osg::Vec3 new_v = vertices[orig_i] - _skirtVectors[orig_i]*_skirtHeight;
+            vertices.push_back(new_v);
+            normals.push_back(normals[orig_i]);
+
+            for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = _layerToTexCoordMap.begin();
+                itr != _layerToTexCoordMap.end();
+                ++itr)
+            {
+                osg::Vec2Array* texcoords = itr->second.first.get();
+                if (_vng._sharedTexCoords.count(texcoords)==0) texcoords->push_back((*texcoords)[orig_i]);
+            }
+
+            if (_geometry)
+            {
+                if (!_drawElements)
+                {
+                    _drawElements = _smallTile ?
+                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
+                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
+                }
+
+                _drawElements->addElement(orig_i);
+                _drawElements->addElement(new_i);
+            }
+        }
+
+        /** Add the current quad strip to the geometry, if it isn't empty.*/
+        void endStrip()
+        {
+            if (_drawElements.valid() && _drawElements->getNumIndices()!=0)
+            {
+                _geometry->addPrimitiveSet(_drawElements.get());
+            }
+            _drawElements = 0;
+        }
+
+    protected:
+
+        VertexNormalGenerator&                      _vng;
+        VertexNormalGenerator::LayerToTexCoordMap&  _layerToTexCoordMap;
+        const osg::Vec3Array&                       _skirtVectors;
+        float                                       _skirtHeight;
+        osg::Geometry*                              _geometry;
+        bool                                        _smallTile;
+        osg::ref_ptr<osg::DrawElements>             _drawElements;
+};
+
 void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLocator, const osg::Vec3d& centerModel)
 {
+    OSG_TRACE_ZONE("GeometryTechnique::generateGeometry");
+
     Terrain* terrain = _terrainTile->getTerrain();
     osgTerrain::Layer* elevationLayer = _terrainTile->getElevationLayer();
 
@@ -804,8 +1008,10 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
 
     float scaleHeight = terrain ? terrain->getVerticalScale() : 1.0f;
 
+    unsigned int numBuildThreads = (_parallelBuildThreshold>0 && numRows*numColumns>=_parallelBuildThreshold) ? _numParallelBuildThreads : 1;
+
     // construct the VertexNormalGenerator which will manage the generation and the vertices and normals
-    VertexNormalGenerator VNG(masterLocator, centerModel, numRows, numColumns, scaleHeight, createSkirt);
+    VertexNormalGenerator VNG(masterLocator, centerModel, numRows, numColumns, scaleHeight, createSkirt, numBuildThreads);
 
     unsigned int numVertices = VNG.capacity();
 
@@ -867,7 +1073,32 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
     //
     // populate vertex and tex coord arrays
     //
-    VNG.populateCenter(elevationLayer, layerToTexCoordMap);
+    bool regularGrid = VNG.sampleCenter(elevationLayer, layerToTexCoordMap);
+
+    // without invalid height values the vertices are laid out row by row, so the texture coordinates of the
+    // layers using the master locator are the same for all tiles of the same size and can be shared.
+    GeometryPool* geometryPool = terrain ? terrain->getGeometryPool() : 0;
+    if (regularGrid && geometryPool)
+    {
+        for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
+            itr != layerToTexCoordMap.end();
+            ++itr)
+        {
+            if (dynamic_cast<osgTerrain::ImageLayer*>(itr->first) && itr->second.second==masterLocator)
+            {
+                itr->second.first = geometryPool->getOrCreateGridTexCoords(numColumns, numRows, createSkirt);
+                VNG._sharedTexCoords.insert(itr->second.first.get());
+            }
+        }
+
+        for(unsigned int layerNum=0; layerNum<_terrainTile->getNumColorLayers(); ++layerNum)
+        {
+            VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.find(_terrainTile->getColorLayer(layerNum));
+            if (itr!=layerToTexCoordMap.end()) geometry->setTexCoordArray(layerNum, itr->second.first.get());
+        }
+    }
+
+    VNG.populateCenter(layerToTexCoordMap);
 
     if (terrain && terrain->getEqualizeBoundaries())
     {
@@ -997,249 +1228,129 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
 
     // OSG_NOTICE<<"smallTile = "<<smallTile<<std::endl;
 
-    osg::ref_ptr<osg::DrawElements> elements = smallTile ?
-        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_TRIANGLES)) :
-        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_TRIANGLES));
+    bool sharedIndices = regularGrid && geometryPool && _shareGridIndices;
+    if (sharedIndices)
+    {
+        osg::Geometry::PrimitiveSetList primitiveSets;
+        geometryPool->getOrCreateGridPrimitiveSets(numColumns, numRows, createSkirt, swapOrientation, primitiveSets);
+        for(osg::Geometry::PrimitiveSetList::iterator itr = primitiveSets.begin();
+            itr != primitiveSets.end();
+            ++itr)
+        {
+            geometry->addPrimitiveSet(itr->get());
+        }
+    }
+    else
+    {
+        osg::ref_ptr<osg::DrawElements> elements = smallTile ?
+            static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_TRIANGLES)) :
+            static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_TRIANGLES));
 
-    elements->reserveElements((numRows-1) * (numColumns-1) * 6);
+        elements->reserveElements((numRows-1) * (numColumns-1) * 6);
 
-    geometry->addPrimitiveSet(elements.get());
+        geometry->addPrimitiveSet(elements.get());
 
 
-    unsigned int i, j;
-    for(j=0; j<numRows-1; ++j)
-    {
-        for(i=0; i<numColumns-1; ++i)
+        unsigned int i, j;
+        for(j=0; j<numRows-1; ++j)
         {
-            // remap indices to final vertex positions
-            int i00 = VNG.vertex_index(i,   j);
-            int i01 = VNG.vertex_index(i,   j+1);
-            int i10 = VNG.vertex_index(i+1, j);
-            int i11 = VNG.vertex_index(i+1, j+1);
-
-            if (swapOrientation)
+            for(i=0; i<numColumns-1; ++i)
             {
-                std::swap(i00,i01);
-                std::swap(i10,i11);
-            }
+                // remap indices to final vertex positions
+                int i00 = VNG.vertex_index(i,   j);
+                int i01 = VNG.vertex_index(i,   j+1);
+                int i10 = VNG.vertex_index(i+1, j);
+                int i11 = VNG.vertex_index(i+1, j+1);
+
+                if (swapOrientation)
+                {
+                    std::swap(i00,i01);
+                    std::swap(i10,i11);
+                }
 
-            unsigned int numValid = 0;
-            if (i00>=0) ++numValid;
-            if (i01>=0) ++numValid;
-            if (i10>=0) ++numValid;
-            if (i11>=0) ++numValid;
+                unsigned int numValid = 0;
+                if (i00>=0) ++numValid;
+                if (i01>=0) ++numValid;
+                if (i10>=0) ++numValid;
+                if (i11>=0) ++numValid;
 
-            if (numValid==4)
-            {
-                // optimize which way to put the diagonal by choosing to
-                // place it between the two corners that have the least curvature
-                // relative to each other.
-                float dot_00_11 = (*VNG._normals)[i00] * (*VNG._normals)[i11];
-                float dot_01_10 = (*VNG._normals)[i01] * (*VNG._normals)[i10];
-                if (dot_00_11 > dot_01_10)
+                if (numValid==4)
                 {
-                    elements->addElement(i01);
-                    elements->addElement(i00);
-                    elements->addElement(i11);
+                    // optimize which way to put the diagonal by choosing to
+                    // place it between the two corners that have the least curvature
+                    // relative to each other.
+                    float dot_00_11 = (*VNG._normals)[i00] * (*VNG._normals)[i11];
+                    float dot_01_10 = (*VNG._normals)[i01] * (*VNG._normals)[i10];
+                    if (dot_00_11 > dot_01_10)
+                    {
+                        elements->addElement(i01);
+                        elements->addElement(i00);
+                        elements->addElement(i11);
 
-                    elements->addElement(i00);
-                    elements->addElement(i10);
-                    elements->addElement(i11);
+                        elements->addElement(i00);
+                        elements->addElement(i10);
+                        elements->addElement(i11);
+                    }
+                    else
+                    {
+                        elements->addElement(i01);
+                        elements->addElement(i00);
+                        elements->addElement(i10);
+
+                        elements->addElement(i01);
+                        elements->addElement(i10);
+                        elements->addElement(i11);
+                    }
                 }
-                else
+                else if (numValid==3)
                 {
-                    elements->addElement(i01);
-                    elements->addElement(i00);
-                    elements->addElement(i10);
-
-                    elements->addElement(i01);
-                    elements->addElement(i10);
-                    elements->addElement(i11);
+                    if (i00>=0) elements->addElement(i00);
+                    if (i01>=0) elements->addElement(i01);
+                    if (i11>=0) elements->addElement(i11);
+                    if (i10>=0) elements->addElement(i10);
                 }
             }
-            else if (numValid==3)
-            {
-                if (i00>=0) elements->addElement(i00);
-                if (i01>=0) elements->addElement(i01);
-                if (i11>=0) elements->addElement(i11);
-                if (i10>=0) elements->addElement(i10);
-            }
         }
     }
 
 
     if (createSkirt)
     {
-        osg::ref_ptr<osg::Vec3Array> vertices = VNG._vertices.get();
-        osg::ref_ptr<osg::Vec3Array> normals = VNG._normals.get();
-
-        osg::ref_ptr<osg::DrawElements> skirtDrawElements = smallTile ?
-            static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-            static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
+        // the skirt vertices are still added when the indices are shared, in the order the shared quad strips expect.
+        SkirtGenerator skirt(VNG, layerToTexCoordMap, *skirtVectors, skirtHeight, sharedIndices ? 0 : geometry, smallTile);
 
         // create bottom skirt vertices
         int r,c;
         r=0;
         for(c=0;c<static_cast<int>(numColumns);++c)
         {
-            int orig_i = VNG.vertex_index(c,r);
-            if (orig_i>=0)
-            {
-                unsigned int new_i = vertices->size(); // index of new index of added skirt point
-                osg::Vec3 new_v = (*vertices)[orig_i] - ((*skirtVectors)[orig_i])*skirtHeight;
-                (*vertices).push_back(new_v);
-                if (normals.valid()) (*normals).push_back((*normals)[orig_i]);
-
-                for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
-                    itr != layerToTexCoordMap.end();
-                    ++itr)
-                {
-                    itr->second.first->push_back((*itr->second.first)[orig_i]);
-                }
-
-                skirtDrawElements->addElement(orig_i);
-                skirtDrawElements->addElement(new_i);
-            }
-            else
-            {
-                if (skirtDrawElements->getNumIndices()!=0)
-                {
-                    geometry->addPrimitiveSet(skirtDrawElements.get());
-                    skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
-                }
-
-            }
-        }
-
-        if (skirtDrawElements->getNumIndices()!=0)
-        {
-            geometry->addPrimitiveSet(skirtDrawElements.get());
-            skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
+            skirt.addVertex(c,r);
         }
+        skirt.endStrip();
 
         // create right skirt vertices
         c=numColumns-1;
         for(r=0;r<static_cast<int>(numRows);++r)
         {
-            int orig_i = VNG.vertex_index(c,r); // index of original vertex of grid
-            if (orig_i>=0)
-            {
-                unsigned int new_i = vertices->size(); // index of new index of added skirt point
-                osg::Vec3 new_v = (*vertices)[orig_i] - ((*skirtVectors)[orig_i])*skirtHeight;
-                (*vertices).push_back(new_v);
-                if (normals.valid()) (*normals).push_back((*normals)[orig_i]);
-                for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
-                    itr != layerToTexCoordMap.end();
-                    ++itr)
-                {
-                    itr->second.first->push_back((*itr->second.first)[orig_i]);
-                }
-
-                skirtDrawElements->addElement(orig_i);
-                skirtDrawElements->addElement(new_i);
-            }
-            else
-            {
-                if (skirtDrawElements->getNumIndices()!=0)
-                {
-                    geometry->addPrimitiveSet(skirtDrawElements.get());
-                    skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
-                }
-
-            }
-        }
-
-        if (skirtDrawElements->getNumIndices()!=0)
-        {
-            geometry->addPrimitiveSet(skirtDrawElements.get());
-            skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
+            skirt.addVertex(c,r);
         }
+        skirt.endStrip();
 
         // create top skirt vertices
         r=numRows-1;
         for(c=numColumns-1;c>=0;--c)
         {
-            int orig_i = VNG.vertex_index(c,r); // index of original vertex of grid
-            if (orig_i>=0)
-            {
-                unsigned int new_i = vertices->size(); // index of new index of added skirt point
-                osg::Vec3 new_v = (*vertices)[orig_i] - ((*skirtVectors)[orig_i])*skirtHeight;
-                (*vertices).push_back(new_v);
-                if (normals.valid()) (*normals).push_back((*normals)[orig_i]);
-                for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
-                    itr != layerToTexCoordMap.end();
-                    ++itr)
-                {
-                    itr->second.first->push_back((*itr->second.first)[orig_i]);
-                }
-
-                skirtDrawElements->addElement(orig_i);
-                skirtDrawElements->addElement(new_i);
-            }
-            else
-            {
-                if (skirtDrawElements->getNumIndices()!=0)
-                {
-                    geometry->addPrimitiveSet(skirtDrawElements.get());
-                    skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
-                }
-
-            }
-        }
-
-        if (skirtDrawElements->getNumIndices()!=0)
-        {
-            geometry->addPrimitiveSet(skirtDrawElements.get());
-            skirtDrawElements = smallTile ?
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_QUAD_STRIP)) :
-                        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_QUAD_STRIP));
+            skirt.addVertex(c,r);
         }
+        skirt.endStrip();
 
         // create left skirt vertices
         c=0;
         for(r=numRows-1;r>=0;--r)
         {
-            int orig_i = VNG.vertex_index(c,r); // index of original vertex of grid
-            if (orig_i>=0)
-            {
-                unsigned int new_i = vertices->size(); // index of new index of added skirt point
-                osg::Vec3 new_v = (*vertices)[orig_i] - ((*skirtVectors)[orig_i])*skirtHeight;
-                (*vertices).push_back(new_v);
-                if (normals.valid()) (*normals).push_back((*normals)[orig_i]);
-                for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
-                    itr != layerToTexCoordMap.end();
-                    ++itr)
-                {
-                    itr->second.first->push_back((*itr->second.first)[orig_i]);
-                }
-
-                skirtDrawElements->addElement(orig_i);
-                skirtDrawElements->addElement(new_i);
-            }
-            else
-            {
-                if (skirtDrawElements->getNumIndices()!=0)
-                {
-                    geometry->addPrimitiveSet(skirtDrawElements.get());
-                    skirtDrawElements = new osg::DrawElementsUShort(GL_QUAD_STRIP);
-                }
-            }
-        }
-
-        if (skirtDrawElements->getNumIndices()!=0)
-        {
-            geometry->addPrimitiveSet(skirtDrawElements.get());
+            skirt.addVertex(c,r);
         }
+        skirt.endStrip();
     }
 
 
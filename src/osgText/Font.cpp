@@ -17,6 +17,8 @@
 #include <osg/State>
 #include <osg/Notify>
 #include <osg/ApplicationUsage>
+#include <osg/ParallelFor>
+#include <osg/Trace>
 
 #include <osgDB/ReadFile>
 #include <osgDB/FileUtils>
@@ -24,14 +26,18 @@
 #include <osg/GLU>
 
 #include <string.h>
+#include <algorithm>
 
 #include <OpenThreads/ReentrantMutex>
 
 #include "DefaultFont.h"
+#include "GlyphCache.h"
 
 using namespace osgText;
 using namespace std;
 
+static osg::ApplicationUsageProxy Font_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE, "OSG_GLYPH_CACHE <directory>", "Keep the glyphs rendered by fonts in the directory so that later runs can reuse them.");
+
 osg::ref_ptr<Font>& Font::getDefaultFont()
 {
     static OpenThreads::Mutex s_DefaultFontMutex;
@@ -232,9 +238,11 @@ Font::Font(FontImplementation* implementation):
     _depth(1),
     _numCurveSamples(10)
 {
+    char *ptr;
+    if ((ptr = getenv("OSG_GLYPH_CACHE")) != 0) _glyphCacheDirectory = ptr;
+
     setImplementation(implementation);
 
-    char *ptr;
     if ((ptr = getenv("OSG_MAX_TEXTURE_SIZE")) != 0)
     {
         unsigned int osg_max_size = atoi(ptr);
@@ -246,14 +254,21 @@ Font::Font(FontImplementation* implementation):
 
 Font::~Font()
 {
+    if (_glyphCache.valid()) writeGlyphCache();
+
     if (_implementation.valid()) _implementation->_facade = 0;
 }
 
 void Font::setImplementation(FontImplementation* implementation)
 {
+    // write out the glyphs of the outgoing implementation, the font plugins detach their implementations when unloaded.
+    if (_glyphCache.valid()) writeGlyphCache();
+
     if (_implementation.valid()) _implementation->_facade = 0;
     _implementation = implementation;
     if (_implementation.valid()) _implementation->_facade = this;
+
+    createGlyphCache();
 }
 
 Font::FontImplementation* Font::getImplementation()
@@ -337,6 +352,15 @@ Glyph* Font::getGlyph(const FontResolution& fontRes, unsigned int charcode)
             GlyphMap::iterator gitr = glyphmap.find(charcode);
             if (gitr!=glyphmap.end()) return gitr->second.get();
         }
+
+        if (_glyphCache.valid())
+        {
+            readGlyphCache(fontResUsed);
+
+            GlyphMap& glyphmap = _sizeGlyphMap[fontResUsed];
+            GlyphMap::iterator gitr = glyphmap.find(charcode);
+            if (gitr!=glyphmap.end()) return gitr->second.get();
+        }
     }
 
     Glyph* glyph = _implementation->getGlyph(fontResUsed, charcode);
@@ -448,6 +472,16 @@ void Font::addGlyph(const FontResolution& fontRes, unsigned int charcode, Glyph*
 }
 
 void Font::assignGlyphToGlyphTexture(Glyph* glyph, ShaderTechnique shaderTechnique)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphTextureMutex);
+
+    // another thread may have assigned the glyph while this one waited for the lock.
+    if (glyph->getTextureInfo(shaderTechnique)) return;
+
+    addGlyphToGlyphTexture(glyph, shaderTechnique, 0);
+}
+
+void Font::addGlyphToGlyphTexture(Glyph* glyph, ShaderTechnique shaderTechnique, const osg::Image* glyphImage)
 {
     int posX=0,posY=0;
 
@@ -491,6 +525,215 @@ void Font::assignGlyphToGlyphTexture(Glyph* glyph, ShaderTechnique shaderTechniq
 
     }
 
+    // use the glyph's texels from the glyph cache when they haven't been generated already.
+    osg::ref_ptr<osg::Image> cachedGlyphImage;
+    if (!glyphImage && _glyphCache.valid())
+    {
+        cachedGlyphImage = _glyphCache->takeGlyphImage(glyph, shaderTechnique);
+        glyphImage = cachedGlyphImage.get();
+    }
+
     // add the glyph into the texture.
-    glyphTexture->addGlyph(glyph,posX,posY);
+    glyphTexture->addGlyph(glyph,posX,posY,glyphImage);
+}
+
+namespace
+{
+
+struct PreparedGlyph
+{
+    PreparedGlyph(unsigned int c, Glyph* g): charcode(c), glyph(g) {}
+
+    unsigned int                charcode;
+    osg::ref_ptr<Glyph>         glyph;
+    osg::ref_ptr<osg::Image>    glyphImage;
+};
+
+typedef std::vector<PreparedGlyph> PreparedGlyphs;
+
+struct PrepareGlyphs : public osg::ParallelForFunctor
+{
+    PrepareGlyphs(Font* font, GlyphCache* glyphCache, const FontResolution& fontRes, ShaderTechnique shaderTechnique, PreparedGlyphs& glyphs):
+        _font(font),
+        _glyphCache(glyphCache),
+        _fontRes(fontRes),
+        _shaderTechnique(shaderTechnique),
+        _glyphs(glyphs) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            PreparedGlyph& prepared = _glyphs[i];
+            if (!prepared.glyph)
+            {
+                // FontImplementations aren't required to be thread safe, so only rasterize one glyph at a time,
+                // leaving the other threads generating the texture images of the glyphs already rasterized.
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_implementationMutex);
+                prepared.glyph = _font->getGlyph(_fontRes, prepared.charcode);
+            }
+
+            if (prepared.glyph.valid())
+            {
+                if (_glyphCache) prepared.glyphImage = _glyphCache->takeGlyphImage(prepared.glyph.get(), _shaderTechnique);
+                if (!prepared.glyphImage) prepared.glyphImage = GlyphTexture::createGlyphImage(prepared.glyph.get(), _shaderTechnique);
+            }
+        }
+    }
+
+    Font*                   _font;
+    GlyphCache*             _glyphCache;
+    FontResolution          _fontRes;
+    ShaderTechnique         _shaderTechnique;
+    PreparedGlyphs&         _glyphs;
+    OpenThreads::Mutex      _implementationMutex;
+};
+
+}
+
+void Font::prepareGlyphs(const FontResolution& fontRes, const std::vector<unsigned int>& charcodes, ShaderTechnique shaderTechnique, unsigned int numThreads)
+{
+    if (!_implementation || charcodes.empty()) return;
+
+    std::vector<unsigned int> uniqueCharcodes(charcodes);
+    std::sort(uniqueCharcodes.begin(), uniqueCharcodes.end());
+    uniqueCharcodes.erase(std::unique(uniqueCharcodes.begin(), uniqueCharcodes.end()), uniqueCharcodes.end());
+
+    FontResolution fontResUsed(0,0);
+    if (_implementation->supportsMultipleFontResolutions()) fontResUsed = fontRes;
+
+    // pick out the charcodes without a glyph and the glyphs not yet in a texture of the shader technique.
+    PreparedGlyphs glyphs;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphMapMutex);
+
+        if (_glyphCache.valid()) readGlyphCache(fontResUsed);
+
+        const GlyphMap* glyphmap = 0;
+        FontSizeGlyphMap::const_iterator itr = _sizeGlyphMap.find(fontResUsed);
+        if (itr!=_sizeGlyphMap.end()) glyphmap = &(itr->second);
+
+        for(std::vector<unsigned int>::const_iterator citr = uniqueCharcodes.begin();
+            citr != uniqueCharcodes.end();
+            ++citr)
+        {
+            Glyph* glyph = 0;
+            if (glyphmap)
+            {
+                GlyphMap::const_iterator gitr = glyphmap->find(*citr);
+                if (gitr!=glyphmap->end()) glyph = gitr->second.get();
+            }
+            glyphs.push_back(PreparedGlyph(*citr, glyph));
+        }
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphTextureMutex);
+
+        PreparedGlyphs::iterator last = glyphs.begin();
+        for(PreparedGlyphs::iterator itr = glyphs.begin();
+            itr != glyphs.end();
+            ++itr)
+        {
+            if (!itr->glyph || !itr->glyph->getTextureInfo(shaderTechnique)) *(last++) = *itr;
+        }
+        glyphs.erase(last, glyphs.end());
+    }
+
+    if (glyphs.empty()) return;
+
+    OSG_TRACE_ZONE("Font::prepareGlyphs");
+
+    // glyphs are cheap enough individually that only large batches are worth sharing out between threads.
+    PrepareGlyphs functor(this, _glyphCache.get(), fontRes, shaderTechnique, glyphs);
+    osg::parallelFor(glyphs.size(), functor, 16, numThreads);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphTextureMutex);
+    for(PreparedGlyphs::iterator itr = glyphs.begin();
+        itr != glyphs.end();
+        ++itr)
+    {
+        if (itr->glyph.valid() && !itr->glyph->getTextureInfo(shaderTechnique))
+        {
+            addGlyphToGlyphTexture(itr->glyph.get(), shaderTechnique, itr->glyphImage.get());
+        }
+    }
+}
+
+void Font::setGlyphCacheDirectory(const std::string& directory)
+{
+    if (_glyphCacheDirectory==directory) return;
+
+    if (_glyphCache.valid()) writeGlyphCache();
+
+    _glyphCacheDirectory = directory;
+    createGlyphCache();
+}
+
+void Font::createGlyphCache()
+{
+    _glyphCache = 0;
+
+    if (_glyphCacheDirectory.empty() || !_implementation) return;
+
+    std::string fileName = _implementation->getFileName();
+    if (!fileName.empty()) _glyphCache = new GlyphCache(_glyphCacheDirectory, fileName, _implementation->getGlyphCacheKey());
+}
+
+void Font::readGlyphCache(const FontResolution& fontRes)
+{
+    // called with _glyphMapMutex locked.
+    GlyphCache::GlyphList glyphs;
+    if (!_glyphCache->readGlyphs(this, fontRes, glyphs)) return;
+
+    GlyphMap& glyphmap = _sizeGlyphMap[fontRes];
+    for(GlyphCache::GlyphList::iterator itr = glyphs.begin();
+        itr != glyphs.end();
+        ++itr)
+    {
+        glyphmap.insert(GlyphMap::value_type((*itr)->getGlyphCode(), *itr));
+    }
+}
+
+void Font::writeGlyphCache()
+{
+    if (!_glyphCache) return;
+
+    typedef std::vector< std::pair< FontResolution, std::vector< osg::ref_ptr<Glyph> > > > ResolutionGlyphs;
+    ResolutionGlyphs resolutionGlyphs;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphMapMutex);
+        for(FontSizeGlyphMap::iterator itr = _sizeGlyphMap.begin();
+            itr != _sizeGlyphMap.end();
+            ++itr)
+        {
+            resolutionGlyphs.push_back(ResolutionGlyphs::value_type(itr->first, std::vector< osg::ref_ptr<Glyph> >()));
+            for(GlyphMap::iterator gitr = itr->second.begin();
+                gitr != itr->second.end();
+                ++gitr)
+            {
+                resolutionGlyphs.back().second.push_back(gitr->second);
+            }
+        }
+    }
+
+    // the glyphs that have been assigned to a glyph texture are cached, along with their texels, added to those already cached.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphTextureMutex);
+    for(ResolutionGlyphs::iterator itr = resolutionGlyphs.begin();
+        itr != resolutionGlyphs.end();
+        ++itr)
+    {
+        std::vector<Glyph*> glyphs;
+        for(std::vector< osg::ref_ptr<Glyph> >::iterator gitr = itr->second.begin();
+            gitr != itr->second.end();
+            ++gitr)
+        {
+            glyphs.push_back(gitr->get());
+        }
+
+        for(unsigned int technique=NO_TEXT_SHADER; technique<=ALL_FEATURES; ++technique)
+        {
+            _glyphCache->writeGlyphs(itr->first, static_cast<ShaderTechnique>(technique), glyphs);
+        }
+    }
 }
@@ -51,6 +51,108 @@ using namespace std;
 #endif
 
 
+namespace
+{
+
+const float s_distanceTransformInfinity = 1e20f;
+
+// One dimensional squared Euclidean distance transform of the sampled function f, computed as the lower envelope
+// of the parabolas rooted at each sample, following Felzenszwalb and Huttenlocher's "Distance Transforms of Sampled
+// Functions". Along with the distance the sample each position's distance comes from is returned.
+// v and z are workspace of n and n+1 entries respectively.
+void distanceTransform(const float* f, int n, float* d, int* nearest, int* v, float* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -s_distanceTransformInfinity;
+    z[1] = s_distanceTransformInfinity;
+    for(int q=1; q<n; ++q)
+    {
+        float s = ((f[q]+float(q*q)) - (f[v[k]]+float(v[k]*v[k]))) / float(2*(q-v[k]));
+        while(s<=z[k])
+        {
+            --k;
+            s = ((f[q]+float(q*q)) - (f[v[k]]+float(v[k]*v[k]))) / float(2*(q-v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = s_distanceTransformInfinity;
+    }
+
+    k = 0;
+    for(int q=0; q<n; ++q)
+    {
+        while(z[k+1]<float(q)) ++k;
+        float delta = float(q-v[k]);
+        d[q] = delta*delta + f[v[k]];
+        nearest[q] = v[k];
+    }
+}
+
+// Two dimensional squared Euclidean distance transform, giving for each pixel of a width x height grid the
+// squared distance to, and position of, the nearest seed pixel. Runs in time linear in the number of pixels.
+struct DistanceTransform2D
+{
+    DistanceTransform2D(int width, int height):
+        _width(width),
+        _height(height),
+        _columnDistance(width*height),
+        _columnNearest(width*height),
+        distance2(width*height),
+        nearestX(width*height),
+        nearestY(width*height)
+    {
+        int n = osg::maximum(width, height);
+        _f.resize(n);
+        _d.resize(n);
+        _nearest.resize(n);
+        _v.resize(n);
+        _z.resize(n+1);
+    }
+
+    void compute(const std::vector<unsigned char>& seeds)
+    {
+        // transform each column, then each row of the column results.
+        for(int c=0; c<_width; ++c)
+        {
+            for(int r=0; r<_height; ++r) _f[r] = seeds[r*_width+c] ? 0.0f : s_distanceTransformInfinity;
+
+            distanceTransform(&_f.front(), _height, &_d.front(), &_nearest.front(), &_v.front(), &_z.front());
+
+            for(int r=0; r<_height; ++r)
+            {
+                _columnDistance[r*_width+c] = _d[r];
+                _columnNearest[r*_width+c] = _nearest[r];
+            }
+        }
+
+        for(int r=0; r<_height; ++r)
+        {
+            int rowStart = r*_width;
+            distanceTransform(&_columnDistance[rowStart], _width, &distance2[rowStart], &nearestX[rowStart], &_v.front(), &_z.front());
+
+            for(int c=0; c<_width; ++c) nearestY[rowStart+c] = _columnNearest[rowStart+nearestX[rowStart+c]];
+        }
+    }
+
+    int                             _width;
+    int                             _height;
+    std::vector<float>              _f;
+    std::vector<float>              _d;
+    std::vector<int>                _nearest;
+    std::vector<int>                _v;
+    std::vector<float>              _z;
+    std::vector<float>              _columnDistance;
+    std::vector<int>                _columnNearest;
+
+    std::vector<float>              distance2;
+    std::vector<int>                nearestX;
+    std::vector<int>                nearestY;
+};
+
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // GlyphTexture
@@ -77,10 +179,15 @@ int GlyphTexture::compare(const osg::StateAttribute& rhs) const
     return 0;
 }
 
+int GlyphTexture::computeEffectMargin(const FontResolution& fontRes, ShaderTechnique technique)
+{
+    if (technique==GREYSCALE) return 0;
+    else return osg::maximum(fontRes.second/6, 2u);
+}
+
 int GlyphTexture::getEffectMargin(const Glyph* glyph)
 {
-    if (_shaderTechnique==GREYSCALE) return 0;
-    else return osg::maximum(glyph->getFontResolution().second/6, 2u);
+    return computeEffectMargin(glyph->getFontResolution(), _shaderTechnique);
 }
 
 int GlyphTexture::getTexelMargin(const Glyph* glyph)
@@ -150,7 +257,7 @@ bool GlyphTexture::getSpaceForGlyph(Glyph* glyph, int& posX, int& posY)
     return false;
 }
 
-void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY)
+void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY, const osg::Image* glyphImage)
 {
 
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
@@ -168,10 +275,10 @@ void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY)
 
     glyph->setTextureInfo(_shaderTechnique, info.get());
 
-    copyGlyphImage(glyph, info.get());
+    copyGlyphImage(glyph, info.get(), glyphImage);
 }
 
-void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
+void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info, const osg::Image* glyphImage)
 {
     _image->dirty();
 
@@ -185,55 +292,96 @@ void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
         return;
     }
 
-    // OSG_NOTICE<<"GlyphTexture::copyGlyphImage() generating signed distance field. glyphTexture="<<this<<", glyph="<<glyph->getGlyphCode()<<std::endl;
-
-    int src_columns = glyph->s();
-    int src_rows = glyph->t();
-    unsigned char* src_data = glyph->data();
-
-    int dest_columns = _image->s();
-    int dest_rows = _image->t();
-    unsigned char* dest_data = _image->data(info->texturePositionX, info->texturePositionY);
+    // OSG_NOTICE<<"GlyphTexture::copyGlyphImage() copying signed distance field. glyphTexture="<<this<<", glyph="<<glyph->getGlyphCode()<<std::endl;
 
     int search_distance = getEffectMargin(glyph);
 
-    int left = -search_distance;
-    int right = glyph->s()+search_distance;
-    int lower = -search_distance;
-    int upper = glyph->t()+search_distance;
+    // generate the signed distance field unless one matching the glyph has been provided, such as from a glyph cache.
+    osg::ref_ptr<const osg::Image> sdfImage = glyphImage;
+    if (!sdfImage ||
+        sdfImage->s()!=glyph->s()+2*search_distance+1 ||
+        sdfImage->t()!=glyph->t()+2*search_distance+1 ||
+        sdfImage->getPixelFormat()!=_image->getPixelFormat() ||
+        sdfImage->getDataType()!=_image->getDataType())
+    {
+        sdfImage = createGlyphImage(glyph, _shaderTechnique);
+    }
 
-    float multiplier = 1.0/255.0f;
+    // clip the glyph's block, which extends search_distance beyond the glyph on each side, to the texture.
+    int left = osg::maximum(0, search_distance-info->texturePositionX);
+    int right = osg::minimum(sdfImage->s(), _image->s()-info->texturePositionX+search_distance);
+    int lower = osg::maximum(0, search_distance-info->texturePositionY);
+    int upper = osg::minimum(sdfImage->t(), _image->t()-info->texturePositionY+search_distance);
+    if (left>=right || lower>=upper) return;
 
-    float max_distance = sqrtf(float(search_distance)*float(search_distance)*2.0);
+    unsigned int bytes_per_pixel = osg::Image::computePixelSizeInBits(_image->getPixelFormat(),_image->getDataType())/8;
+    for(int r=lower; r<upper; ++r)
+    {
+        memcpy(_image->data(info->texturePositionX-search_distance+left, info->texturePositionY-search_distance+r),
+               sdfImage->data(left, r),
+               (right-left)*bytes_per_pixel);
+    }
+}
+
+osg::Image* GlyphTexture::createGlyphImage(const Glyph* glyph, ShaderTechnique technique)
+{
+    if (technique<=GREYSCALE) return 0;
 
-    if ((left+info->texturePositionX)<0) left = -info->texturePositionX;
-    if ((right+info->texturePositionX)>=dest_columns) right = dest_columns-info->texturePositionX-1;
+    int src_columns = glyph->s();
+    int src_rows = glyph->t();
+    const unsigned char* src_data = glyph->data();
 
-    if ((lower+info->texturePositionY)<0) lower = -info->texturePositionY;
-    if ((upper+info->texturePositionY)>=dest_rows) upper = dest_rows-info->texturePositionY-1;
+    int search_distance = computeEffectMargin(glyph->getFontResolution(), technique);
 
+    int columns = src_columns+2*search_distance+1;
+    int rows = src_rows+2*search_distance+1;
 
-    int num_components = osg::Image::computeNumComponents(_image->getPixelFormat());
-    int bytes_per_pixel = osg::Image::computePixelSizeInBits(_image->getPixelFormat(),_image->getDataType())/8;
-    int alpha_offset = (_image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 1 : 0;
-    int sdf_offset = (_image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 0 : 1;
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(columns, rows, 1, OSGTEXT_GLYPH_SDF_FORMAT, GL_UNSIGNED_BYTE);
+    image->setInternalTextureFormat(OSGTEXT_GLYPH_SDF_INTERNALFORMAT);
 
+    int bytes_per_pixel = osg::Image::computePixelSizeInBits(image->getPixelFormat(),image->getDataType())/8;
+    int alpha_offset = (image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 1 : 0;
+    int sdf_offset = (image->getPixelFormat()==GL_LUMINANCE_ALPHA) ? 0 : 1;
 
+    // the glyph's alpha padded out to the size of the field, with the seeds of the two distance transforms,
+    // the pixels with any coverage for the pixels outside the glyph and those without full coverage for the inside.
     unsigned char full_on = 255;
+    std::vector<unsigned char> coverage(columns*rows, 0);
+    std::vector<unsigned char> inside_seeds(columns*rows, 0);
+    std::vector<unsigned char> outside_seeds(columns*rows, 1);
+    for(int r=0; r<src_rows; ++r)
+    {
+        for(int c=0; c<src_columns; ++c)
+        {
+            int i = (r+search_distance)*columns + c+search_distance;
+            coverage[i] = *(src_data + r*src_columns + c);
+            inside_seeds[i] = coverage[i]>0 ? 1 : 0;
+            outside_seeds[i] = coverage[i]<full_on ? 1 : 0;
+        }
+    }
+
+    DistanceTransform2D distanceToCovered(columns, rows);
+    distanceToCovered.compute(inside_seeds);
+
+    DistanceTransform2D distanceToUncovered(columns, rows);
+    distanceToUncovered.compute(outside_seeds);
+
+    float multiplier = 1.0/255.0f;
+    float max_distance = sqrtf(float(search_distance)*float(search_distance)*2.0);
     unsigned char mid_point = full_on/2;
     float mid_point_f = float(mid_point)*multiplier;
 
-    for(int dr=lower; dr<=upper; ++dr)
+    for(int r=0; r<rows; ++r)
     {
-        for(int dc=left; dc<=right; ++dc)
+        unsigned char* dest_ptr = image->data(0, r);
+        for(int c=0; c<columns; ++c, dest_ptr += bytes_per_pixel)
         {
-            unsigned char value = 0;
-
-            unsigned char center_value = 0;
-            if (dr>=0 && dr<src_rows && dc>=0 && dc<src_columns) center_value = *(src_data + dr*src_columns + dc);
-
+            int i = r*columns + c;
+            unsigned char center_value = coverage[i];
             float center_value_f = center_value*multiplier;
             float min_distance = max_distance;
+            unsigned char value = 0;
 
             if (center_value>0 && center_value<full_on)
             {
@@ -250,109 +398,33 @@ void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
             }
             else
             {
-                for(int radius=1; radius<search_distance; ++radius)
+                // the distance to where the coverage of a pixel of differing coverage crosses the mid point, along the
+                // line between the two pixel centers. A less covered pixel may be nearest while the edge passes closer
+                // through one of its neighbours, so the neighbours of the nearest pixel are considered too.
+                const DistanceTransform2D& dt = (center_value==0) ? distanceToCovered : distanceToUncovered;
+                if (dt.distance2[i]<max_distance*max_distance)
                 {
-                    for(int span=-radius; span<=radius; ++span)
+                    int nearest_c = dt.nearestX[i];
+                    int nearest_r = dt.nearestY[i];
+                    for(int lr=osg::maximum(nearest_r-1, 0); lr<=osg::minimum(nearest_r+1, rows-1); ++lr)
                     {
+                        for(int lc=osg::maximum(nearest_c-1, 0); lc<=osg::minimum(nearest_c+1, columns-1); ++lc)
                         {
-                            // left
-                            int dx = -radius;
-                            int dy = span;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // top
-                            int dx = span;
-                            int dy = radius;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
+                            unsigned char local_value = coverage[lr*columns + lc];
+                            if (local_value==center_value) continue;
 
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
+                            int dx = lc-c;
+                            int dy = lr-r;
+                            float local_value_f = float(local_value)*multiplier;
 
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
+                            float D = sqrtf(float(dx*dx) + float(dy*dy));
+                            float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
 
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
+                            float local_distance = D;
+                            if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
+                            else local_distance += (local_value_f - mid_point_f)*local_multiplier;
 
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // right
-                            int dx = radius;
-                            int dy = span;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
-                        }
-
-                        {
-                            // bottom
-                            int dx = span;
-                            int dy = -radius;
-
-                            int c = dc+dx;
-                            int r = dr+dy;
-
-                            unsigned char local_value = 0;
-                            if (r>=0 && r<src_rows && c>=0 && c<src_columns) local_value = *(src_data + r*src_columns + c);
-                            if (local_value!=center_value)
-                            {
-                                float local_value_f = float(local_value)*multiplier;
-
-                                float D = sqrtf(float(dx*dx) + float(dy*dy));
-                                float local_multiplier = (abs(dx)>abs(dy)) ? D/float(abs(dx)) : D/float(abs(dy));
-
-                                float local_distance = sqrtf(float(radius*radius)+float(span*span));
-                                if (center_value==0) local_distance += (mid_point_f-local_value_f)*local_multiplier;
-                                else local_distance += (local_value_f - mid_point_f)*local_multiplier;
-
-                                if (local_distance<min_distance) min_distance = local_distance;
-                            }
+                            if (local_distance<min_distance) min_distance = local_distance;
                         }
                     }
                 }
@@ -367,22 +439,15 @@ void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
                 }
             }
 
+            // signed distance field value
+            *(dest_ptr+sdf_offset) = value;
 
-            unsigned char* dest_ptr = dest_data + (dr*dest_columns + dc)*bytes_per_pixel;
-            if (num_components==2)
-            {
-                // signed distance field value
-                *(dest_ptr+sdf_offset) = value;
-
-                // original alpha value from glyph image
-                *(dest_ptr+alpha_offset) = center_value;
-            }
-            else
-            {
-                *(dest_ptr) = value;
-            }
+            // original alpha value from glyph image
+            *(dest_ptr+alpha_offset) = center_value;
         }
     }
+
+    return image.release();
 }
 
 void GlyphTexture::setThreadSafeRefUnref(bool threadSafe)
@@ -478,13 +543,17 @@ const Glyph::TextureInfo* Glyph::getTextureInfo(ShaderTechnique technique) const
 
 Glyph::TextureInfo* Glyph::getOrCreateTextureInfo(ShaderTechnique technique)
 {
+    // Font::prepareGlyphs() reads the texture infos of glyphs from other threads with the font's glyph texture
+    // mutex held, so the list is only checked and resized with it held here too.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_font->_glyphTextureMutex);
+
     if (technique>=_textureInfoList.size())
     {
         _textureInfoList.resize(technique+1);
     }
     if (!_textureInfoList[technique])
     {
-        _font->assignGlyphToGlyphTexture(this, technique);
+        _font->addGlyphToGlyphTexture(this, technique, 0);
     }
     return  _textureInfoList[technique].get();
 }
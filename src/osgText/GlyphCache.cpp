@@ -0,0 +1,412 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "GlyphCache.h"
+
+#include <osgText/Font>
+
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <osgDB/fstream>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+
+#include <OpenThreads/ScopedLock>
+
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
+#include <iomanip>
+
+using namespace osgText;
+
+namespace
+{
+
+const char s_glyphCacheMagic[8] = { 'O', 'S', 'G', 'G', 'L', 'Y', 'P', 'H' };
+const unsigned int s_glyphCacheVersion = 2;
+const unsigned int s_glyphCacheByteOrder = 0x01020304;
+
+template<typename T>
+void writeValue(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return !in.fail();
+}
+
+void writeImage(std::ostream& out, const osg::Image& image)
+{
+    writeValue(out, static_cast<int>(image.s()));
+    writeValue(out, static_cast<int>(image.t()));
+    writeValue(out, static_cast<unsigned int>(image.getPixelFormat()));
+    writeValue(out, static_cast<unsigned int>(image.getInternalTextureFormat()));
+    writeValue(out, static_cast<unsigned int>(image.getDataType()));
+
+    unsigned int rowSize = osg::Image::computeRowWidthInBytes(image.s(), image.getPixelFormat(), image.getDataType(), 1);
+    for(int r=0; r<image.t(); ++r)
+    {
+        out.write(reinterpret_cast<const char*>(image.data(0, r)), rowSize);
+    }
+}
+
+bool readImage(std::istream& in, osg::Image& image)
+{
+    int s=0, t=0;
+    unsigned int pixelFormat=0, internalTextureFormat=0, dataType=0;
+    if (!readValue(in, s) || !readValue(in, t) ||
+        !readValue(in, pixelFormat) || !readValue(in, internalTextureFormat) || !readValue(in, dataType)) return false;
+
+    if (s<0 || t<0 || s>65536 || t>65536) return false;
+
+    unsigned int rowSize = osg::Image::computeRowWidthInBytes(s, pixelFormat, dataType, 1);
+    unsigned int dataSize = rowSize*t;
+    if (dataSize>64*1024*1024) return false;
+
+    unsigned char* data = new unsigned char[dataSize];
+    in.read(reinterpret_cast<char*>(data), dataSize);
+    if (in.fail())
+    {
+        delete [] data;
+        return false;
+    }
+
+    image.setImage(s, t, 1, internalTextureFormat, pixelFormat, dataType, data, osg::Image::USE_NEW_DELETE, 1);
+    return true;
+}
+
+// the texels the glyph occupies in its texture, as created by GlyphTexture::createGlyphImage().
+osg::Image* copyGlyphTexels(Glyph* glyph, ShaderTechnique technique)
+{
+    const Glyph::TextureInfo* info = glyph->getTextureInfo(technique);
+    if (!info || !info->texture) return 0;
+
+    const osg::Image* textureImage = info->texture->getImage();
+    if (!textureImage || !textureImage->data()) return 0;
+
+    int margin = info->texture->getEffectMargin(glyph);
+    int columns = glyph->s()+2*margin+1;
+    int rows = glyph->t()+2*margin+1;
+    int x = info->texturePositionX-margin;
+    int y = info->texturePositionY-margin;
+    if (x<0 || y<0 || (x+columns)>textureImage->s() || (y+rows)>textureImage->t()) return 0;
+
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(columns, rows, 1, textureImage->getPixelFormat(), textureImage->getDataType());
+    image->setInternalTextureFormat(textureImage->getInternalTextureFormat());
+
+    unsigned int rowSize = image->getRowSizeInBytes();
+    for(int r=0; r<rows; ++r)
+    {
+        memcpy(image->data(0, r), textureImage->data(x, y+r), rowSize);
+    }
+
+    return image.release();
+}
+
+}
+
+GlyphCache::GlyphCache(const std::string& directory, const std::string& fontFileName, const std::string& fontKey):
+    _directory(directory),
+    _fontFileName(fontFileName)
+{
+    // keep the key to characters safe in file names.
+    for(std::string::const_iterator itr = fontKey.begin(); itr != fontKey.end(); ++itr)
+    {
+        char c = *itr;
+        bool safe = (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='_' || c=='-';
+        _fontKey.push_back(safe ? c : '_');
+    }
+}
+
+std::string GlyphCache::getCacheFileName(const FontResolution& fontRes, ShaderTechnique technique)
+{
+    if (_fontHash.empty())
+    {
+        osgDB::ifstream fin(_fontFileName.c_str(), std::ios::in | std::ios::binary);
+        if (!fin) return std::string();
+
+        // 64 bit FNV-1a of the font file's contents.
+        unsigned long long hash = 14695981039346656037ULL;
+        char buffer[65536];
+        while(fin.read(buffer, sizeof(buffer)) || fin.gcount()>0)
+        {
+            std::streamsize count = fin.gcount();
+            for(std::streamsize i=0; i<count; ++i)
+            {
+                hash ^= static_cast<unsigned char>(buffer[i]);
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        std::stringstream sstr;
+        sstr<<std::hex<<std::setw(16)<<std::setfill('0')<<hash;
+        _fontHash = sstr.str();
+    }
+
+    std::stringstream sstr;
+    sstr<<_fontHash;
+    if (!_fontKey.empty()) sstr<<"_"<<_fontKey;
+    sstr<<"_"<<fontRes.first<<"x"<<fontRes.second<<"_"<<static_cast<unsigned int>(technique)
+        <<"_m"<<GlyphTexture::computeEffectMargin(fontRes, technique)<<".glyphs";
+    return osgDB::concatPaths(_directory, sstr.str());
+}
+
+bool GlyphCache::readGlyphs(Font* font, const FontResolution& fontRes, GlyphList& glyphs)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (!_fontResolutionsRead.insert(fontRes).second) return false;
+
+    std::map< unsigned int, osg::ref_ptr<Glyph> > glyphMap;
+    for(unsigned int technique=NO_TEXT_SHADER; technique<=ALL_FEATURES; ++technique)
+    {
+        std::string fileName = getCacheFileName(fontRes, static_cast<ShaderTechnique>(technique));
+        if (fileName.empty()) break;
+
+        if (osgDB::fileExists(fileName))
+        {
+            readGlyphFile(font, fileName, fontRes, static_cast<ShaderTechnique>(technique), glyphMap);
+        }
+    }
+
+    for(std::map< unsigned int, osg::ref_ptr<Glyph> >::iterator itr = glyphMap.begin();
+        itr != glyphMap.end();
+        ++itr)
+    {
+        glyphs.push_back(itr->second);
+    }
+
+    return true;
+}
+
+bool GlyphCache::readGlyphFile(Font* font, const std::string& fileName, const FontResolution& fontRes, ShaderTechnique technique, std::map< unsigned int, osg::ref_ptr<Glyph> >& glyphs)
+{
+    osgDB::ifstream fin(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return false;
+
+    char magic[sizeof(s_glyphCacheMagic)];
+    unsigned int version=0, byteOrder=0, resolutionWidth=0, resolutionHeight=0, fileTechnique=0, numGlyphs=0;
+    fin.read(magic, sizeof(magic));
+    if (fin.fail() || memcmp(magic, s_glyphCacheMagic, sizeof(magic))!=0 ||
+        !readValue(fin, version) || version!=s_glyphCacheVersion ||
+        !readValue(fin, byteOrder) || byteOrder!=s_glyphCacheByteOrder ||
+        !readValue(fin, resolutionWidth) || !readValue(fin, resolutionHeight) || !readValue(fin, fileTechnique) ||
+        resolutionWidth!=fontRes.first || resolutionHeight!=fontRes.second || fileTechnique!=static_cast<unsigned int>(technique) ||
+        !readValue(fin, numGlyphs))
+    {
+        OSG_INFO<<"GlyphCache: ignoring "<<fileName<<", not a glyph cache file of this version."<<std::endl;
+        return false;
+    }
+
+    std::set<unsigned int>& charcodesRead = _charcodesRead[CharcodesMap::key_type(fontRes, technique)];
+
+    unsigned int numRead = 0;
+    for(; numRead<numGlyphs; ++numRead)
+    {
+        unsigned int charcode=0, glyphResolutionWidth=0, glyphResolutionHeight=0;
+        float width=0.0f, height=0.0f, horizontalAdvance=0.0f, verticalAdvance=0.0f;
+        osg::Vec2 horizontalBearing, verticalBearing;
+        if (!readValue(fin, charcode) ||
+            !readValue(fin, glyphResolutionWidth) || !readValue(fin, glyphResolutionHeight) ||
+            !readValue(fin, width) || !readValue(fin, height) ||
+            !readValue(fin, horizontalBearing) || !readValue(fin, horizontalAdvance) ||
+            !readValue(fin, verticalBearing) || !readValue(fin, verticalAdvance)) break;
+
+        osg::ref_ptr<Glyph>& glyph = glyphs[charcode];
+        if (!glyph)
+        {
+            glyph = new Glyph(font, charcode);
+            glyph->setFontResolution(FontResolution(glyphResolutionWidth, glyphResolutionHeight));
+            glyph->setWidth(width);
+            glyph->setHeight(height);
+            glyph->setHorizontalBearing(horizontalBearing);
+            glyph->setHorizontalAdvance(horizontalAdvance);
+            glyph->setVerticalBearing(verticalBearing);
+            glyph->setVerticalAdvance(verticalAdvance);
+            if (!readImage(fin, *glyph))
+            {
+                glyphs.erase(charcode);
+                break;
+            }
+        }
+        else
+        {
+            // already read from the file of another shader technique.
+            osg::ref_ptr<osg::Image> image = new osg::Image;
+            if (!readImage(fin, *image)) break;
+        }
+
+        unsigned char hasTextureImage = 0;
+        if (!readValue(fin, hasTextureImage)) break;
+
+        if (hasTextureImage)
+        {
+            osg::ref_ptr<osg::Image> textureImage = new osg::Image;
+            if (!readImage(fin, *textureImage)) break;
+
+            _glyphImages[GlyphImageKey(FontResolution(glyphResolutionWidth, glyphResolutionHeight), technique, charcode)] = textureImage;
+        }
+
+        charcodesRead.insert(charcode);
+    }
+
+    if (numRead<numGlyphs)
+    {
+        OSG_WARN<<"Warning: GlyphCache could only read "<<numRead<<" of the "<<numGlyphs<<" glyphs in "<<fileName<<std::endl;
+    }
+    else
+    {
+        OSG_INFO<<"GlyphCache: read "<<numRead<<" glyphs from "<<fileName<<std::endl;
+    }
+
+    return numRead==numGlyphs;
+}
+
+osg::ref_ptr<osg::Image> GlyphCache::takeGlyphImage(const Glyph* glyph, ShaderTechnique technique)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (_glyphImages.empty()) return 0;
+
+    GlyphImageMap::iterator itr = _glyphImages.find(GlyphImageKey(glyph->getFontResolution(), technique, glyph->getGlyphCode()));
+    if (itr==_glyphImages.end()) return 0;
+
+    osg::ref_ptr<osg::Image> image = itr->second;
+    _glyphImages.erase(itr);
+    return image;
+}
+
+bool GlyphCache::writeGlyphs(const FontResolution& fontRes, ShaderTechnique technique, const std::vector<Glyph*>& glyphs)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    std::set<unsigned int>& charcodesRead = _charcodesRead[CharcodesMap::key_type(fontRes, technique)];
+
+    // the glyphs assigned to glyph textures, plus those read from the file that haven't been, so that no cached glyph is lost.
+    std::vector<Glyph*> glyphsToWrite;
+    bool glyphsAdded = false;
+    for(std::vector<Glyph*>::const_iterator itr = glyphs.begin();
+        itr != glyphs.end();
+        ++itr)
+    {
+        bool read = charcodesRead.count((*itr)->getGlyphCode())!=0;
+        bool assigned = (*itr)->getTextureInfo(technique)!=0;
+        if (assigned && !read) glyphsAdded = true;
+        if (assigned || read) glyphsToWrite.push_back(*itr);
+    }
+
+    if (!glyphsAdded) return true;
+
+    std::string fileName = getCacheFileName(fontRes, technique);
+    if (fileName.empty()) return false;
+
+    if (!osgDB::fileExists(_directory) && !osgDB::makeDirectory(_directory))
+    {
+        OSG_WARN<<"Warning: GlyphCache could not create the directory "<<_directory<<std::endl;
+        return false;
+    }
+
+    // write to a temporary file that is then renamed, so that other processes never read a partially written file.
+    std::stringstream sstr;
+    sstr<<fileName<<"."<<std::hex<<osg::Timer::instance()->tick()<<".tmp";
+    std::string temporaryFileName = sstr.str();
+
+    {
+        osgDB::ofstream fout(temporaryFileName.c_str(), std::ios::out | std::ios::binary);
+        if (!fout)
+        {
+            OSG_WARN<<"Warning: GlyphCache could not open "<<temporaryFileName<<" for writing."<<std::endl;
+            return false;
+        }
+
+        fout.write(s_glyphCacheMagic, sizeof(s_glyphCacheMagic));
+        writeValue(fout, s_glyphCacheVersion);
+        writeValue(fout, s_glyphCacheByteOrder);
+        writeValue(fout, fontRes.first);
+        writeValue(fout, fontRes.second);
+        writeValue(fout, static_cast<unsigned int>(technique));
+        writeValue(fout, static_cast<unsigned int>(glyphsToWrite.size()));
+
+        for(std::vector<Glyph*>::const_iterator itr = glyphsToWrite.begin();
+            itr != glyphsToWrite.end();
+            ++itr)
+        {
+            Glyph* glyph = *itr;
+            writeValue(fout, glyph->getGlyphCode());
+            writeValue(fout, glyph->getFontResolution().first);
+            writeValue(fout, glyph->getFontResolution().second);
+            writeValue(fout, glyph->getWidth());
+            writeValue(fout, glyph->getHeight());
+            writeValue(fout, glyph->getHorizontalBearing());
+            writeValue(fout, glyph->getHorizontalAdvance());
+            writeValue(fout, glyph->getVerticalBearing());
+            writeValue(fout, glyph->getVerticalAdvance());
+            writeImage(fout, *glyph);
+
+            osg::ref_ptr<osg::Image> textureImage;
+            if (technique>GREYSCALE)
+            {
+                if (glyph->getTextureInfo(technique))
+                {
+                    textureImage = copyGlyphTexels(glyph, technique);
+                }
+                else
+                {
+                    // read but not used in this run, so still holding the texels it was read with.
+                    GlyphImageMap::iterator iitr = _glyphImages.find(GlyphImageKey(glyph->getFontResolution(), technique, glyph->getGlyphCode()));
+                    if (iitr != _glyphImages.end()) textureImage = iitr->second;
+                }
+            }
+            unsigned char hasTextureImage = textureImage.valid() ? 1 : 0;
+            writeValue(fout, hasTextureImage);
+            if (textureImage.valid()) writeImage(fout, *textureImage);
+        }
+
+        if (fout.fail())
+        {
+            OSG_WARN<<"Warning: GlyphCache failed writing "<<temporaryFileName<<std::endl;
+            fout.close();
+            remove(temporaryFileName.c_str());
+            return false;
+        }
+    }
+
+    if (rename(temporaryFileName.c_str(), fileName.c_str())!=0)
+    {
+        // rename doesn't replace existing files on all platforms.
+        remove(fileName.c_str());
+        if (rename(temporaryFileName.c_str(), fileName.c_str())!=0)
+        {
+            OSG_WARN<<"Warning: GlyphCache could not rename "<<temporaryFileName<<" to "<<fileName<<std::endl;
+            remove(temporaryFileName.c_str());
+            return false;
+        }
+    }
+
+    OSG_INFO<<"GlyphCache: wrote "<<glyphsToWrite.size()<<" glyphs to "<<fileName<<std::endl;
+
+    for(std::vector<Glyph*>::const_iterator itr = glyphsToWrite.begin();
+        itr != glyphsToWrite.end();
+        ++itr)
+    {
+        charcodesRead.insert((*itr)->getGlyphCode());
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSGTEXT_GLYPHCACHE_H
+#define OSGTEXT_GLYPHCACHE_H 1
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <osg/ref_ptr>
+#include <osg/Image>
+
+#include <osgText/Glyph>
+
+#include <OpenThreads/Mutex>
+
+namespace osgText {
+
+/** GlyphCache keeps the glyphs a Font renders in a directory between runs, one file per font resolution and
+  * shader technique, named after a hash of the contents of the font file so that edited fonts aren't matched,
+  * the FontImplementation's glyph cache key and the margin the shader technique's effects need.
+  * Each file holds the glyphs' metrics and images, along with the texels each glyph occupies in the glyph
+  * textures, so that neither the rasterization nor the signed distance field generation has to be repeated.
+  * Files are only rewritten when glyphs that they don't hold have been assigned to glyph textures, the new file
+  * holding both the glyphs read and those assigned, so that the cache accumulates the glyphs of successive runs.*/
+class GlyphCache : public osg::Referenced
+{
+public:
+
+    GlyphCache(const std::string& directory, const std::string& fontFileName, const std::string& fontKey);
+
+    const std::string& getDirectory() const { return _directory; }
+
+    typedef std::vector< osg::ref_ptr<Glyph> > GlyphList;
+
+    /** Read the glyphs cached for the font resolution the first time it is asked for, returning false if it was already read.
+      * The glyphs' texture images are kept until taken by takeGlyphImage().*/
+    bool readGlyphs(Font* font, const FontResolution& fontRes, GlyphList& glyphs);
+
+    /** Take the cached texture image of a glyph for a shader technique, returning NULL if there isn't one.*/
+    osg::ref_ptr<osg::Image> takeGlyphImage(const Glyph* glyph, ShaderTechnique technique);
+
+    /** Write the glyphs of the font resolution that are assigned to glyph textures of the shader technique, along with
+      * those read from its file, when any of the assigned glyphs wasn't read. The glyphs read but not assigned keep the
+      * texels they were read with. Must be called with the Font's glyph texture mutex held.*/
+    bool writeGlyphs(const FontResolution& fontRes, ShaderTechnique technique, const std::vector<Glyph*>& glyphs);
+
+protected:
+
+    virtual ~GlyphCache() {}
+
+    std::string getCacheFileName(const FontResolution& fontRes, ShaderTechnique technique);
+
+    bool readGlyphFile(Font* font, const std::string& fileName, const FontResolution& fontRes, ShaderTechnique technique, std::map< unsigned int, osg::ref_ptr<Glyph> >& glyphs);
+
+    struct GlyphImageKey
+    {
+        GlyphImageKey(const FontResolution& res, ShaderTechnique st, unsigned int code):
+            fontRes(res), technique(st), charcode(code) {}
+
+        bool operator < (const GlyphImageKey& rhs) const
+        {
+            if (fontRes<rhs.fontRes) return true;
+            if (rhs.fontRes<fontRes) return false;
+            if (technique<rhs.technique) return true;
+            if (rhs.technique<technique) return false;
+            return charcode<rhs.charcode;
+        }
+
+        FontResolution  fontRes;
+        ShaderTechnique technique;
+        unsigned int    charcode;
+    };
+
+    typedef std::map< GlyphImageKey, osg::ref_ptr<osg::Image> >                 GlyphImageMap;
+    typedef std::map< std::pair<FontResolution, ShaderTechnique>, std::set<unsigned int> > CharcodesMap;
+
+    OpenThreads::Mutex          _mutex;
+    std::string                 _directory;
+    std::string                 _fontFileName;
+    std::string                 _fontKey;
+    std::string                 _fontHash;
+    std::set<FontResolution>    _fontResolutionsRead;
+    GlyphImageMap               _glyphImages;
+    CharcodesMap                _charcodesRead;
+};
+
+}
+
+#endif
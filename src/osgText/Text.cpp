@@ -469,6 +469,17 @@ void Text::computeGlyphRepresentation()
 
     //OpenThreads::ScopedLock<Font::FontMutex> lock(*(activefont->getSerializeFontCallsMutex()));
 
+    // create the glyphs of all the characters and add them to the glyph textures in one batch, rather than one at a time during layout.
+    {
+        std::vector<unsigned int> charcodes;
+        charcodes.reserve(_text.size());
+        for(String::const_iterator itr = _text.begin(); itr != _text.end(); ++itr)
+        {
+            if (*itr!='\n') charcodes.push_back(*itr);
+        }
+        activefont->prepareGlyphs(_fontSize, charcodes, _shaderTechnique);
+    }
+
     // initialize bounding box, it will be expanded during glyph position calculation
     _textBB.init();
 
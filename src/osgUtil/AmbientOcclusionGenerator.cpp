@@ -0,0 +1,454 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgUtil/AmbientOcclusionGenerator>
+#include <osgUtil/RayBatchIntersector>
+
+#include <osg/KdTree>
+#include <osg/Notify>
+#include <osg/ParallelFor>
+#include <osg/Transform>
+#include <osg/TriangleIndexFunctor>
+
+#include <math.h>
+
+using namespace osgUtil;
+
+namespace
+{
+
+struct CollectGeometries : public osg::NodeVisitor
+{
+    CollectGeometries():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    virtual void apply(osg::Geometry& geometry)
+    {
+        _geometries.push_back(&geometry);
+        _matrices.push_back(osg::computeLocalToWorld(getNodePath()));
+    }
+
+    std::vector<osg::Geometry*>     _geometries;
+    std::vector<osg::Matrix>        _matrices;
+};
+
+struct CollectTriangles
+{
+    CollectTriangles(): _indices(0) {}
+
+    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        _indices->push_back(p1);
+        _indices->push_back(p2);
+        _indices->push_back(p3);
+    }
+
+    std::vector<unsigned int>* _indices;
+};
+
+struct Sample
+{
+    osg::Vec3d  position;
+    osg::Vec3   normal;
+};
+typedef std::vector<Sample> Samples;
+
+inline float hashToUnitFloat(unsigned int i)
+{
+    i = (i ^ 61u) ^ (i >> 16);
+    i *= 9u;
+    i = i ^ (i >> 4);
+    i *= 0x27d4eb2du;
+    i = i ^ (i >> 15);
+    return float(i & 0xffffffu)/float(0x1000000);
+}
+
+inline float radicalInverse(unsigned int i)
+{
+    i = (i << 16) | (i >> 16);
+    i = ((i & 0x55555555u) << 1) | ((i & 0xAAAAAAAAu) >> 1);
+    i = ((i & 0x33333333u) << 2) | ((i & 0xCCCCCCCCu) >> 2);
+    i = ((i & 0x0F0F0F0Fu) << 4) | ((i & 0xF0F0F0F0u) >> 4);
+    i = ((i & 0x00FF00FFu) << 8) | ((i & 0xFF00FF00u) >> 8);
+    return float(i)*2.3283064365386963e-10f;
+}
+
+/** Cast the hemisphere rays of ranges of samples, each range using its own IntersectionVisitor.*/
+struct CastRays : public osg::ParallelForFunctor
+{
+    CastRays(const Samples& samples, const std::vector<osg::Vec3>& directions, osg::Node* occluders, float maxDistance, float bias,
+             std::vector<float>& occlusion, std::vector<osg::Vec3>& bentNormals):
+        _samples(samples),
+        _directions(directions),
+        _occluders(occluders),
+        _maxDistance(maxDistance),
+        _bias(bias),
+        _occlusion(occlusion),
+        _bentNormals(bentNormals) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        unsigned int numRays = _directions.size();
+
+        osg::ref_ptr<RayBatchIntersector> intersector = new RayBatchIntersector(Intersector::MODEL, Intersector::LIMIT_ONE);
+        std::vector<osg::Vec3> rayDirections;
+        rayDirections.reserve((end-begin)*numRays);
+
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            const Sample& sample = _samples[i];
+            const osg::Vec3& n = sample.normal;
+
+            osg::Vec3 t = fabsf(n.x())<0.9f ? osg::Vec3(1.0f,0.0f,0.0f)^n : osg::Vec3(0.0f,1.0f,0.0f)^n;
+            t.normalize();
+            osg::Vec3 b = n^t;
+
+            // rotate the shared set of directions by a different angle per sample to trade banding for noise
+            float angle = hashToUnitFloat(i)*2.0f*osg::PIf;
+            float ca = cosf(angle), sa = sinf(angle);
+
+            osg::Vec3d start = sample.position + osg::Vec3d(n)*_bias;
+            for(unsigned int r=0; r<numRays; ++r)
+            {
+                const osg::Vec3& d = _directions[r];
+                osg::Vec3 direction = t*(d.x()*ca-d.y()*sa) + b*(d.x()*sa+d.y()*ca) + n*d.z();
+
+                intersector->addRay(start, start+osg::Vec3d(direction)*_maxDistance);
+                rayDirections.push_back(direction);
+            }
+        }
+
+        IntersectionVisitor iv(intersector.get());
+        _occluders->accept(iv);
+
+        const RayBatchIntersector::Intersections& intersections = intersector->getIntersections();
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            unsigned int first = (i-begin)*numRays;
+            unsigned int numOpen = 0;
+            osg::Vec3 bentNormal;
+            for(unsigned int r=first; r<first+numRays; ++r)
+            {
+                if (intersections[r].valid()) continue;
+
+                ++numOpen;
+                bentNormal += rayDirections[r];
+            }
+
+            _occlusion[i] = float(numOpen)/float(numRays);
+
+            if (!_bentNormals.empty())
+            {
+                if (bentNormal.normalize()==0.0f) bentNormal = _samples[i].normal;
+                _bentNormals[i] = bentNormal;
+            }
+        }
+    }
+
+    const Samples&                  _samples;
+    const std::vector<osg::Vec3>&   _directions;
+    osg::Node*                      _occluders;
+    float                           _maxDistance;
+    float                           _bias;
+    std::vector<float>&             _occlusion;
+    std::vector<osg::Vec3>&         _bentNormals;
+};
+
+/** Per geometry record of the samples it contributed.*/
+struct Job
+{
+    Job(): geometry(0), first(0), count(0) {}
+
+    osg::Geometry*              geometry;
+    osg::Matrix                 matrix;
+    unsigned int                first;
+    unsigned int                count;
+    std::vector<unsigned int>   texels;
+};
+
+void computeVertexNormals(const osg::Geometry& geometry, const osg::Vec3Array& vertices, const std::vector<unsigned int>& triangles, std::vector<osg::Vec3>& normals)
+{
+    const osg::Vec3Array* normalArray = dynamic_cast<const osg::Vec3Array*>(geometry.getNormalArray());
+    if (normalArray && normalArray->getBinding()==osg::Array::BIND_PER_VERTEX && normalArray->size()==vertices.size())
+    {
+        normals.assign(normalArray->begin(), normalArray->end());
+        return;
+    }
+
+    // accumulate the area weighted face normals
+    normals.assign(vertices.size(), osg::Vec3());
+    for(unsigned int i=0; i+2<triangles.size(); i+=3)
+    {
+        const osg::Vec3& v0 = vertices[triangles[i]];
+        const osg::Vec3& v1 = vertices[triangles[i+1]];
+        const osg::Vec3& v2 = vertices[triangles[i+2]];
+        osg::Vec3 normal = (v1-v0)^(v2-v0);
+        normals[triangles[i]] += normal;
+        normals[triangles[i+1]] += normal;
+        normals[triangles[i+2]] += normal;
+    }
+}
+
+/** Transform a normal by the inverse transpose of the matrix transforming the positions, given the inverse of that matrix,
+  * as osg does for normals, and renormalize it as non uniform scales change its length.*/
+inline osg::Vec3 transformNormal(const osg::Vec3& normal, const osg::Matrix& inverse)
+{
+    osg::Vec3 transformed = osg::Matrix::transform3x3(inverse, normal);
+    transformed.normalize();
+    return transformed;
+}
+
+inline Sample transformSample(const osg::Vec3& position, const osg::Vec3& normal, const osg::Matrix& matrix, const osg::Matrix& inverse)
+{
+    Sample sample;
+    sample.position = osg::Vec3d(position) * matrix;
+    sample.normal = transformNormal(normal, inverse);
+    return sample;
+}
+
+}
+
+AmbientOcclusionGenerator::AmbientOcclusionGenerator():
+    _target(PER_VERTEX),
+    _numRays(64),
+    _maxDistance(0.0f),
+    _bias(0.0f),
+    _computeBentNormals(false),
+    _ambientOcclusionAttributeIndex(6),
+    _bentNormalAttributeIndex(7),
+    _texCoordUnit(0),
+    _imageWidth(256),
+    _imageHeight(256),
+    _numThreads(0)
+{
+}
+
+void AmbientOcclusionGenerator::bake(osg::Node* subgraph, osg::Node* occluders)
+{
+    _images.clear();
+
+    if (!subgraph || _numRays==0) return;
+    if (!occluders) occluders = subgraph;
+
+    // the rays are intersected concurrently, so build the KdTrees and bounds up front
+    osg::ref_ptr<osg::KdTreeBuilder> kdTreeBuilder = new osg::KdTreeBuilder;
+    kdTreeBuilder->_buildOptions._splitStrategy = osg::KdTree::SPLIT_SURFACE_AREA_HEURISTIC;
+    kdTreeBuilder->_buildOptions._triangleLeafLayout = true;
+    occluders->accept(*kdTreeBuilder);
+
+    const osg::BoundingSphere& bs = occluders->getBound();
+    float maxDistance = _maxDistance>0.0f ? _maxDistance : bs.radius();
+    float bias = _bias>0.0f ? _bias : maxDistance*1e-4f;
+    if (maxDistance<=0.0f) return;
+
+    // cosine weighted directions over the hemisphere around +z
+    std::vector<osg::Vec3> directions(_numRays);
+    for(unsigned int i=0; i<_numRays; ++i)
+    {
+        float u1 = (float(i)+0.5f)/float(_numRays);
+        float u2 = radicalInverse(i);
+        float r = sqrtf(u1);
+        float phi = 2.0f*osg::PIf*u2;
+        directions[i].set(r*cosf(phi), r*sinf(phi), sqrtf(std::max(0.0f, 1.0f-u1)));
+    }
+
+    CollectGeometries collectGeometries;
+    subgraph->accept(collectGeometries);
+
+    Samples samples;
+    std::vector<Job> jobs;
+    for(unsigned int g=0; g<collectGeometries._geometries.size(); ++g)
+    {
+        osg::Geometry* geometry = collectGeometries._geometries[g];
+        const osg::Matrix& matrix = collectGeometries._matrices[g];
+        osg::Matrix inverse = osg::Matrix::inverse(matrix);
+
+        osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray());
+        if (!vertices || vertices->empty()) continue;
+
+        std::vector<unsigned int> triangles;
+        osg::TriangleIndexFunctor<CollectTriangles> collectTriangles;
+        collectTriangles._indices = &triangles;
+        geometry->accept(collectTriangles);
+
+        std::vector<osg::Vec3> normals;
+        computeVertexNormals(*geometry, *vertices, triangles, normals);
+
+        Job job;
+        job.geometry = geometry;
+        job.matrix = matrix;
+        job.first = samples.size();
+
+        if (_target==PER_VERTEX)
+        {
+            for(unsigned int i=0; i<vertices->size(); ++i)
+            {
+                samples.push_back(transformSample((*vertices)[i], normals[i], matrix, inverse));
+            }
+        }
+        else
+        {
+            osg::Vec2Array* texcoords = dynamic_cast<osg::Vec2Array*>(geometry->getTexCoordArray(_texCoordUnit));
+            if (!texcoords || texcoords->size()!=vertices->size())
+            {
+                OSG_NOTICE<<"Warning: AmbientOcclusionGenerator::bake() geometry has no per vertex osg::Vec2Array on texture unit "<<_texCoordUnit<<", skipping."<<std::endl;
+                continue;
+            }
+
+            // rasterize the triangles in texture space, sampling at the texel centres
+            std::vector<bool> covered(_imageWidth*_imageHeight, false);
+            for(unsigned int i=0; i+2<triangles.size(); i+=3)
+            {
+                unsigned int i0 = triangles[i], i1 = triangles[i+1], i2 = triangles[i+2];
+                osg::Vec2 t0((*texcoords)[i0].x()*_imageWidth, (*texcoords)[i0].y()*_imageHeight);
+                osg::Vec2 t1((*texcoords)[i1].x()*_imageWidth, (*texcoords)[i1].y()*_imageHeight);
+                osg::Vec2 t2((*texcoords)[i2].x()*_imageWidth, (*texcoords)[i2].y()*_imageHeight);
+
+                float area = (t1.x()-t0.x())*(t2.y()-t0.y()) - (t2.x()-t0.x())*(t1.y()-t0.y());
+                if (area==0.0f) continue;
+
+                int xmin = osg::maximum(static_cast<int>(floorf(osg::minimum(t0.x(), osg::minimum(t1.x(), t2.x())))), 0);
+                int xmax = osg::minimum(static_cast<int>(ceilf(osg::maximum(t0.x(), osg::maximum(t1.x(), t2.x())))), static_cast<int>(_imageWidth)-1);
+                int ymin = osg::maximum(static_cast<int>(floorf(osg::minimum(t0.y(), osg::minimum(t1.y(), t2.y())))), 0);
+                int ymax = osg::minimum(static_cast<int>(ceilf(osg::maximum(t0.y(), osg::maximum(t1.y(), t2.y())))), static_cast<int>(_imageHeight)-1);
+
+                for(int y=ymin; y<=ymax; ++y)
+                {
+                    for(int x=xmin; x<=xmax; ++x)
+                    {
+                        unsigned int texel = y*_imageWidth+x;
+                        if (covered[texel]) continue;
+
+                        osg::Vec2 p(float(x)+0.5f, float(y)+0.5f);
+                        float b1 = ((p.x()-t0.x())*(t2.y()-t0.y()) - (t2.x()-t0.x())*(p.y()-t0.y()))/area;
+                        float b2 = ((t1.x()-t0.x())*(p.y()-t0.y()) - (p.x()-t0.x())*(t1.y()-t0.y()))/area;
+                        float b0 = 1.0f-b1-b2;
+                        if (b0<0.0f || b1<0.0f || b2<0.0f) continue;
+
+                        osg::Vec3 position = (*vertices)[i0]*b0 + (*vertices)[i1]*b1 + (*vertices)[i2]*b2;
+                        osg::Vec3 normal = normals[i0]*b0 + normals[i1]*b1 + normals[i2]*b2;
+
+                        covered[texel] = true;
+                        job.texels.push_back(texel);
+                        samples.push_back(transformSample(position, normal, matrix, inverse));
+                    }
+                }
+            }
+        }
+
+        job.count = samples.size()-job.first;
+        jobs.push_back(job);
+    }
+
+    if (samples.empty()) return;
+
+    OSG_INFO<<"AmbientOcclusionGenerator::bake() casting "<<samples.size()*_numRays<<" rays for "<<samples.size()<<" samples"<<std::endl;
+
+    std::vector<float> occlusion(samples.size(), 1.0f);
+    std::vector<osg::Vec3> bentNormals;
+    if (_computeBentNormals) bentNormals.resize(samples.size());
+
+    CastRays castRays(samples, directions, occluders, maxDistance, bias, occlusion, bentNormals);
+    osg::parallelFor(samples.size(), castRays, osg::maximum(4096u/_numRays, 1u), _numThreads);
+
+    // bent normals are computed in the subgraph's root frame, bring them back into each geometry's local frame.
+    // The positions go back with the inverse of the job's matrix, so the job's matrix is the inverse to transform the normals with.
+    for(std::vector<Job>::iterator itr = jobs.begin();
+        itr != jobs.end() && _computeBentNormals;
+        ++itr)
+    {
+        for(unsigned int i=itr->first; i<itr->first+itr->count; ++i)
+        {
+            bentNormals[i] = transformNormal(bentNormals[i], itr->matrix);
+        }
+    }
+
+    for(std::vector<Job>::iterator itr = jobs.begin();
+        itr != jobs.end();
+        ++itr)
+    {
+        Job& job = *itr;
+        if (_target==PER_VERTEX)
+        {
+            osg::ref_ptr<osg::FloatArray> occlusionArray = new osg::FloatArray(occlusion.begin()+job.first, occlusion.begin()+job.first+job.count);
+            job.geometry->setVertexAttribArray(_ambientOcclusionAttributeIndex, occlusionArray.get(), osg::Array::BIND_PER_VERTEX);
+
+            if (_computeBentNormals)
+            {
+                osg::ref_ptr<osg::Vec3Array> bentNormalArray = new osg::Vec3Array(bentNormals.begin()+job.first, bentNormals.begin()+job.first+job.count);
+                job.geometry->setVertexAttribArray(_bentNormalAttributeIndex, bentNormalArray.get(), osg::Array::BIND_PER_VERTEX);
+            }
+            continue;
+        }
+
+        unsigned int numComponents = _computeBentNormals ? 4 : 1;
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->allocateImage(_imageWidth, _imageHeight, 1, _computeBentNormals ? GL_RGBA : GL_LUMINANCE, GL_UNSIGNED_BYTE);
+
+        std::vector<float> values(_imageWidth*_imageHeight*numComponents, 1.0f);
+        std::vector<bool> covered(_imageWidth*_imageHeight, false);
+        for(unsigned int i=0; i<job.count; ++i)
+        {
+            unsigned int texel = job.texels[i];
+            float* value = &values[texel*numComponents];
+            if (_computeBentNormals)
+            {
+                const osg::Vec3& n = bentNormals[job.first+i];
+                value[0] = n.x()*0.5f+0.5f;
+                value[1] = n.y()*0.5f+0.5f;
+                value[2] = n.z()*0.5f+0.5f;
+            }
+            value[numComponents-1] = occlusion[job.first+i];
+            covered[texel] = true;
+        }
+
+        // grow the covered texels into their neighbours so that filtering doesn't bleed in the background at uv seams
+        for(unsigned int pass=0; pass<2; ++pass)
+        {
+            std::vector<bool> newlyCovered(covered);
+            for(unsigned int y=0; y<_imageHeight; ++y)
+            {
+                for(unsigned int x=0; x<_imageWidth; ++x)
+                {
+                    unsigned int texel = y*_imageWidth+x;
+                    if (covered[texel]) continue;
+
+                    unsigned int neighbours[4];
+                    unsigned int numNeighbours = 0;
+                    if (x>0 && covered[texel-1]) neighbours[numNeighbours++] = texel-1;
+                    if (x+1<_imageWidth && covered[texel+1]) neighbours[numNeighbours++] = texel+1;
+                    if (y>0 && covered[texel-_imageWidth]) neighbours[numNeighbours++] = texel-_imageWidth;
+                    if (y+1<_imageHeight && covered[texel+_imageWidth]) neighbours[numNeighbours++] = texel+_imageWidth;
+                    if (numNeighbours==0) continue;
+
+                    for(unsigned int c=0; c<numComponents; ++c)
+                    {
+                        float sum = 0.0f;
+                        for(unsigned int n=0; n<numNeighbours; ++n) sum += values[neighbours[n]*numComponents+c];
+                        values[texel*numComponents+c] = sum/float(numNeighbours);
+                    }
+                    newlyCovered[texel] = true;
+                }
+            }
+            covered.swap(newlyCovered);
+        }
+
+        unsigned char* data = image->data();
+        for(unsigned int i=0; i<values.size(); ++i)
+        {
+            data[i] = static_cast<unsigned char>(osg::clampBetween(values[i], 0.0f, 1.0f)*255.0f+0.5f);
+        }
+
+        _images[job.geometry] = image;
+    }
+}
@@ -11,6 +11,9 @@
  * OpenSceneGraph Public License for more details.
 */
 #include <osg/Transform>
+#include <osg/MatrixTransform>
+#include <osg/PositionAttitudeTransform>
+#include <osg/AutoTransform>
 #include <osg/Projection>
 #include <osg/Geode>
 #include <osg/LOD>
@@ -27,17 +30,26 @@
 #include <osg/TemplatePrimitiveFunctor>
 #include <osg/Geometry>
 #include <osg/io_utils>
+#include <osg/ParallelFor>
+#include <osg/Trace>
+#include <osg/ApplicationUsage>
 
 #include <osgUtil/CullVisitor>
 
+#include <OpenThreads/Thread>
+
 #include <float.h>
+#include <stdlib.h>
 #include <algorithm>
+#include <typeinfo>
 
 #include <osg/Timer>
 
 using namespace osg;
 using namespace osgUtil;
 
+static osg::ApplicationUsageProxy CullVisitor_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_PARALLEL_CULL <int>","Minimum number of children of a Group for them to be culled in parallel, 0 or unset disabling it.");
+
 inline float MAX_F(float a, float b)
     { return a>b?a:b; }
 inline int EQUAL_F(float a, float b)
@@ -46,28 +58,41 @@ inline int EQUAL_F(float a, float b)
 
 CullVisitor::CullVisitor():
     osg::NodeVisitor(CULL_VISITOR,TRAVERSE_ACTIVE_CHILDREN),
-    _currentStateGraph(NULL),
+    _currentStatePath(0),
+    _lastPoppedStatePath(0),
     _currentRenderBin(NULL),
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
-    _numberOfEncloseOverrideRenderBinDetails(0)
+    _numberOfEncloseOverrideRenderBinDetails(0),
+    _parallelCullThreshold(0),
+    _numParallelCullThreads(0),
+    _parallelCullClone(false),
+    _batchCullThreshold(0)
 {
     _identifier = new Identifier;
+
+    const char* str = getenv("OSG_PARALLEL_CULL");
+    if (str) _parallelCullThreshold = atoi(str);
 }
 
 CullVisitor::CullVisitor(const CullVisitor& rhs):
     osg::Object(rhs),
     NodeVisitor(rhs),
     CullStack(rhs),
-    _currentStateGraph(NULL),
+    _currentStatePath(0),
+    _lastPoppedStatePath(0),
     _currentRenderBin(NULL),
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
     _numberOfEncloseOverrideRenderBinDetails(0),
+    _parallelCullThreshold(rhs._parallelCullThreshold),
+    _numParallelCullThreads(rhs._numParallelCullThreads),
+    _parallelCullClone(false),
+    _batchCullThreshold(rhs._batchCullThreshold),
     _identifier(rhs._identifier)
 {
 }
@@ -133,6 +158,19 @@ void CullVisitor::reset()
 
     _nearPlaneCandidateMap.clear();
     _farPlaneCandidateMap.clear();
+
+    // the StateGraphs found for the StateSet paths may be pruned between frames, so only the root path is kept.
+    if (!_statePathList.empty()) _statePathList.erase(_statePathList.begin()+1, _statePathList.end());
+    _currentStatePath = 0;
+    _lastPoppedStatePath = 0;
+    _keyedRenderBins.clear();
+
+    for(CullVisitorList::iterator itr = _parallelCullVisitors.begin();
+        itr != _parallelCullVisitors.end();
+        ++itr)
+    {
+        (*itr)->reset();
+    }
 }
 
 float CullVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
@@ -1145,7 +1183,7 @@ void CullVisitor::apply(Group& node)
     StateSet* node_state = node.getStateSet();
     if (node_state) pushStateSet(node_state);
 
-    handle_cull_callbacks_and_traverse(node);
+    handle_cull_callbacks_and_traverse_group(node);
 
     // pop the node's state off the render graph stack.
     if (node_state) popStateSet();
@@ -1169,7 +1207,7 @@ void CullVisitor::apply(Transform& node)
     node.computeLocalToWorldMatrix(*matrix,this);
     pushModelViewMatrix(matrix, node.getReferenceFrame());
 
-    handle_cull_callbacks_and_traverse(node);
+    handle_cull_callbacks_and_traverse_group(node);
 
     popModelViewMatrix();
 
@@ -1180,6 +1218,365 @@ void CullVisitor::apply(Transform& node)
     popCurrentMask();
 }
 
+namespace
+{
+
+struct ParallelCullFunctor : public osg::ParallelForFunctor
+{
+    typedef std::vector< osg::ref_ptr<CullVisitor> > CullVisitorList;
+
+    ParallelCullFunctor(osg::Group& group, CullVisitorList& cullVisitors, unsigned int numRanges):
+        _group(group),
+        _cullVisitors(cullVisitors),
+        _numRanges(numRanges) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        unsigned int numChildren = _group.getNumChildren();
+        for(unsigned int range=begin; range<end; ++range)
+        {
+            OSG_TRACE_ZONE("CullVisitor::cullChildRange");
+            _cullVisitors[range]->cullChildRange(_group, (range*numChildren)/_numRanges, ((range+1)*numChildren)/_numRanges);
+        }
+    }
+
+    osg::Group&         _group;
+    CullVisitorList&    _cullVisitors;
+    unsigned int        _numRanges;
+};
+
+// Return true if CullVisitor::apply() for the node class returns straight away when isCulled(node) is true.
+bool isCulledBeforeTraversal(const std::type_info& type)
+{
+    return type==typeid(osg::Group) ||
+           type==typeid(osg::Geode) ||
+           type==typeid(osg::MatrixTransform) ||
+           type==typeid(osg::PositionAttitudeTransform);
+}
+
+typedef std::map<StateGraph*, StateGraph*> StateGraphMap;
+
+// Find the StateGraph with the same StateSet path in the target tree, creating it if required.
+StateGraph* mapStateGraph(StateGraph* sg, StateGraphMap& stateGraphMap)
+{
+    StateGraphMap::iterator itr = stateGraphMap.find(sg);
+    if (itr!=stateGraphMap.end()) return itr->second;
+
+    // a StateGraph outside of the clone's tree is moved over as it is.
+    StateGraph* mapped = sg->_parent ? mapStateGraph(sg->_parent, stateGraphMap)->find_or_insert(sg->getStateSet()) : sg;
+    stateGraphMap[sg] = mapped;
+    return mapped;
+}
+
+void mergeRenderBins(RenderBin* target, RenderBin* source, StateGraphMap& stateGraphMap, unsigned int traversalOrderOffset)
+{
+    RenderBin::StateGraphList& stateGraphs = source->getStateGraphList();
+    for(RenderBin::StateGraphList::iterator itr = stateGraphs.begin();
+        itr != stateGraphs.end();
+        ++itr)
+    {
+        StateGraph* sg = mapStateGraph(*itr, stateGraphMap);
+        if (sg==*itr)
+        {
+            target->addStateGraph(sg);
+            continue;
+        }
+
+        if (sg->leaves_empty()) target->addStateGraph(sg);
+
+        StateGraph::LeafList& leaves = (*itr)->_leaves;
+        for(StateGraph::LeafList::iterator litr = leaves.begin();
+            litr != leaves.end();
+            ++litr)
+        {
+            (*litr)->_traversalOrderNumber += traversalOrderOffset;
+            sg->addLeaf(litr->get());
+        }
+        leaves.clear();
+    }
+    stateGraphs.clear();
+
+    RenderBin::RenderBinList& bins = source->getRenderBinList();
+    for(RenderBin::RenderBinList::iterator itr = bins.begin();
+        itr != bins.end();
+        ++itr)
+    {
+        RenderBin* bin = target->find_or_insert(itr->first, itr->second->getBinName());
+        if (bin) mergeRenderBins(bin, itr->second.get(), stateGraphMap, traversalOrderOffset);
+    }
+}
+
+}
+
+bool CullVisitor::traversesAllChildren(const osg::Group& group)
+{
+    // subclasses such as Switch and LOD select the children to traverse, so only accept the classes known to use Group::traverse().
+    const std::type_info& type = typeid(group);
+    return type==typeid(osg::Group) ||
+           type==typeid(osg::MatrixTransform) ||
+           type==typeid(osg::PositionAttitudeTransform) ||
+           type==typeid(osg::AutoTransform);
+}
+
+void CullVisitor::traverseLargeGroup(osg::Group& group)
+{
+    if (!traversesAllChildren(group)) traverse(group);
+    else if (_parallelCullThreshold>0 && group.getNumChildren()>=_parallelCullThreshold) traverseChildrenInParallel(group);
+    else cullChildRange(group, 0, group.getNumChildren());
+}
+
+void CullVisitor::cullChildRange(osg::Group& group, unsigned int begin, unsigned int end)
+{
+    unsigned int numChildren = end-begin;
+    CullingSet& cullingSet = getCurrentCullingSet();
+    osg::Polytope& frustum = cullingSet.getFrustum();
+
+    if (_batchCullThreshold==0 || numChildren<_batchCullThreshold ||
+        !(cullingSet.getCullingMask()&CullingSet::VIEW_FRUSTUM_CULLING) || frustum.getCurrentMask()==0)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            group.getChild(i)->accept(*this);
+        }
+        return;
+    }
+
+    // gather the children's bounds into this visitor's own arrays, so that clones culling other ranges of the
+    // same group in parallel don't share them.
+    _batchCullX.resize(numChildren);
+    _batchCullY.resize(numChildren);
+    _batchCullZ.resize(numChildren);
+    _batchCullRadius.resize(numChildren);
+    _batchCullTypes.resize(numChildren);
+    for(unsigned int i=0; i<numChildren; ++i)
+    {
+        const osg::Node* child = group.getChild(begin+i);
+        const osg::BoundingSphere& bs = child->getBound();
+        _batchCullX[i] = bs.center().x();
+        _batchCullY[i] = bs.center().y();
+        _batchCullZ[i] = bs.center().z();
+        _batchCullRadius[i] = bs.radius();
+        _batchCullTypes[i] = &typeid(*child);
+    }
+
+    _batchCullContained.resize(numChildren);
+    _batchCullResultMasks.resize(numChildren);
+    frustum.contains(numChildren, &_batchCullX[0], &_batchCullY[0], &_batchCullZ[0], &_batchCullRadius[0], &_batchCullContained[0], &_batchCullResultMasks[0]);
+
+    // children outside the frustum whose apply() is known to start with isCulled(node) needn't be visited at all,
+    // provided that their culling is active, which the group tracks for all its children, and that no subclass
+    // overrides apply().
+    bool skipCulledChildren = typeid(*this)==typeid(CullVisitor) && group.getNumChildrenWithCullingDisabled()==0;
+
+    // the precomputed result is only picked up by the child's own isCulled(node) test, so children that don't
+    // cull themselves, or that push a new CullingSet first, are traversed as they would be otherwise.
+    for(unsigned int i=0; i<numChildren; ++i)
+    {
+        if (!_batchCullContained[i] && skipCulledChildren && _batchCullRadius[i]>=0.0f && isCulledBeforeTraversal(*_batchCullTypes[i])) continue;
+
+        osg::Node* child = group.getChild(begin+i);
+        setBatchCullResult(child, _batchCullContained[i]!=0, _batchCullResultMasks[i]);
+        child->accept(*this);
+    }
+    clearBatchCullResult();
+}
+
+void CullVisitor::traverseChildrenInParallel(osg::Group& group)
+{
+    unsigned int numChildren = group.getNumChildren();
+    unsigned int numThreads = _numParallelCullThreads>0 ? _numParallelCullThreads : static_cast<unsigned int>(OpenThreads::GetNumberOfProcessors());
+
+    if (_parallelCullClone || !traversesAllChildren(group) || numChildren<2 || numThreads<2 ||
+        _currentRenderBin!=getCurrentRenderStage() || !getViewport())
+    {
+        traverse(group);
+        return;
+    }
+
+    OSG_TRACE_ZONE("CullVisitor::traverseChildrenInParallel");
+
+    // use a couple of ranges per thread so that the threads finishing early pick up the remaining work.
+    unsigned int numRanges = osg::minimum(numChildren, numThreads*2);
+    while (_parallelCullVisitors.size()<numRanges)
+    {
+        osg::ref_ptr<CullVisitor> cv = clone();
+        cv->_parallelCullClone = true;
+        cv->setStateGraph(new StateGraph);
+        cv->setRenderStage(new RenderStage);
+        _parallelCullVisitors.push_back(cv);
+
+        if (typeid(*cv)!=typeid(*this)) break;
+    }
+
+    // a subclass that doesn't override clone() would have its children culled by plain CullVisitors.
+    if (typeid(*_parallelCullVisitors.front())!=typeid(*this))
+    {
+        traverse(group);
+        return;
+    }
+
+    for(unsigned int i=0; i<numRanges; ++i)
+    {
+        _parallelCullVisitors[i]->beginParallelCull(*this);
+    }
+
+    ParallelCullFunctor functor(group, _parallelCullVisitors, numRanges);
+    osg::parallelFor(numRanges, functor, 1, numThreads);
+
+    // merge in child order so the StateGraphs, RenderBins and traversal order numbers end up as a serial traversal would leave them.
+    OSG_TRACE_ZONE("CullVisitor::mergeParallelCull");
+    for(unsigned int i=0; i<numRanges; ++i)
+    {
+        mergeParallelCull(*_parallelCullVisitors[i]);
+    }
+}
+
+void CullVisitor::beginParallelCull(CullVisitor& parent)
+{
+    setCullSettings(parent);
+    setTraversalMask(parent.getTraversalMask());
+    setNodeMaskOverride(parent.getNodeMaskOverride());
+    setTraversalNumber(parent.getTraversalNumber());
+    setFrameStamp(const_cast<osg::FrameStamp*>(parent.getFrameStamp()));
+    setDatabaseRequestHandler(parent.getDatabaseRequestHandler());
+    setImageRequestHandler(parent.getImageRequestHandler());
+    setRenderInfo(parent.getRenderInfo());
+    setOccluderList(parent.getOccluderList());
+    _nodePath = parent.getNodePath();
+
+    // the RenderLeaf and matrices still referenced by the parent from earlier merges are skipped when reusing them,
+    // so only the stacks are reset here, the full reset() is left to the parent's.
+    CullStack::reset();
+    _renderBinStack.clear();
+    _numberOfEncloseOverrideRenderBinDetails = parent._numberOfEncloseOverrideRenderBinDetails;
+    _traversalOrderNumber = 0;
+    _computed_znear = FLT_MAX;
+    _computed_zfar = -FLT_MAX;
+    _nearPlaneCandidateMap.clear();
+    _farPlaneCandidateMap.clear();
+
+    pushViewport(parent.getViewport());
+    pushProjectionMatrix(parent.getProjectionMatrix());
+    pushReferenceViewPoint(parent.getReferenceViewPoint());
+    pushModelViewMatrix(parent.getModelViewMatrix(), osg::Transform::RELATIVE_RF);
+
+    // replicate the parent's StateSet path so the leaves end up with the same StateSet path once merged.
+    std::vector<const osg::StateSet*> statesets;
+    parent.getStatePathStateSets(statesets);
+
+    _rootStateGraph->setStateSet(parent._rootStateGraph->getStateSet());
+    _statePathList.clear();
+    pushStatePath(_rootStateGraph.get(), statesets);
+
+    RenderStage* stage = parent.getCurrentRenderStage();
+    _rootRenderStage->reset();
+    _rootRenderStage->setCamera(stage->getCamera());
+    _rootRenderStage->setViewport(stage->getViewport());
+    _currentRenderBin = _rootRenderStage.get();
+}
+
+void CullVisitor::pushStatePath(StateGraph* root, const std::vector<const osg::StateSet*>& statesets)
+{
+    unsigned int rootPath = static_cast<unsigned int>(_statePathList.size());
+    _statePathList.push_back(StatePath(root));
+    _statePathList.back().parent = rootPath;
+
+    _currentStatePath = rootPath;
+    for(std::vector<const osg::StateSet*>::const_iterator itr = statesets.begin();
+        itr != statesets.end();
+        ++itr)
+    {
+        _statePathList.push_back(StatePath(*itr, _currentStatePath));
+        _currentStatePath = static_cast<unsigned int>(_statePathList.size()-1);
+    }
+    _lastPoppedStatePath = 0;
+}
+
+void CullVisitor::getStatePathStateSets(std::vector<const osg::StateSet*>& statesets) const
+{
+    for(unsigned int sp = _currentStatePath; _statePathList[sp].parent!=sp; sp = _statePathList[sp].parent)
+    {
+        statesets.push_back(_statePathList[sp].stateset);
+    }
+    std::reverse(statesets.begin(), statesets.end());
+}
+
+void CullVisitor::addDeferredRenderLeaves()
+{
+    for(std::vector<RenderBin*>::iterator bitr = _keyedRenderBins.begin();
+        bitr != _keyedRenderBins.end();
+        ++bitr)
+    {
+        RenderBin* bin = *bitr;
+        RenderBin::KeyedRenderLeafList& keyedLeaves = bin->getKeyedRenderLeafList();
+        for(RenderBin::KeyedRenderLeafList::iterator itr = keyedLeaves.begin();
+            itr != keyedLeaves.end();
+            ++itr)
+        {
+            StateGraph* sg = findStateGraph(static_cast<unsigned int>(itr->key));
+            if (sg->leaves_empty()) bin->addStateGraph(sg);
+            sg->addLeaf(itr->leaf);
+        }
+        keyedLeaves.clear();
+    }
+    _keyedRenderBins.clear();
+}
+
+void CullVisitor::mergeParallelCull(CullVisitor& cv)
+{
+    cv.addDeferredRenderLeaves();
+
+    cv.popModelViewMatrix();
+    cv.popReferenceViewPoint();
+    cv.CullStack::popProjectionMatrix();
+    cv.popViewport();
+
+    // remove the StateGraphs that earlier parallel culls left empty.
+    cv._rootStateGraph->prune();
+
+    StateGraphMap stateGraphMap;
+    stateGraphMap[cv._rootStateGraph.get()] = _rootStateGraph.get();
+
+    RenderStage* stage = getCurrentRenderStage();
+    RenderStage* source = cv._rootRenderStage.get();
+    mergeRenderBins(stage, source, stateGraphMap, _traversalOrderNumber);
+    _traversalOrderNumber += cv._traversalOrderNumber;
+
+    stage->moveRenderStages(*source);
+
+    PositionalStateContainer* psc = source->getPositionalStateContainer();
+    PositionalStateContainer::AttrMatrixList& attrs = psc->getAttrMatrixList();
+    for(PositionalStateContainer::AttrMatrixList::iterator itr = attrs.begin();
+        itr != attrs.end();
+        ++itr)
+    {
+        stage->addPositionedAttribute(itr->second.get(), itr->first.get());
+    }
+
+    PositionalStateContainer::TexUnitAttrMatrixListMap& texAttrs = psc->getTexUnitAttrMatrixListMap();
+    for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator titr = texAttrs.begin();
+        titr != texAttrs.end();
+        ++titr)
+    {
+        for(PositionalStateContainer::AttrMatrixList::iterator itr = titr->second.begin();
+            itr != titr->second.end();
+            ++itr)
+        {
+            stage->addPositionedTextureAttribute(titr->first, itr->second.get(), itr->first.get());
+        }
+    }
+
+    source->reset();
+
+    if (cv._computed_znear<_computed_znear) _computed_znear = cv._computed_znear;
+    if (cv._computed_zfar>_computed_zfar) _computed_zfar = cv._computed_zfar;
+
+    _nearPlaneCandidateMap.insert(cv._nearPlaneCandidateMap.begin(), cv._nearPlaneCandidateMap.end());
+    _farPlaneCandidateMap.insert(cv._farPlaneCandidateMap.begin(), cv._farPlaneCandidateMap.end());
+    cv._nearPlaneCandidateMap.clear();
+    cv._farPlaneCandidateMap.clear();
+}
+
 void CullVisitor::apply(Projection& node)
 {
 
@@ -1542,18 +1939,14 @@ void CullVisitor::apply(osg::Camera& camera)
 
         // cache the StateGraph and replace with a clone of the existing parental chain.
         osg::ref_ptr<StateGraph> previous_rootStateGraph = _rootStateGraph;
-        StateGraph* previous_currentStateGraph = _currentStateGraph;
+        unsigned int previous_currentStatePath = _currentStatePath;
 
-        // replicate the StageGraph parental chain so that state graph and render leaves are kept local to the Camera's RenderStage.
+        // replicate the StateSet path so that state graph and render leaves are kept local to the Camera's RenderStage.
         {
-            typedef std::vector< osg::ref_ptr<StateGraph> > StageGraphStack;
-            StageGraphStack stateGraphParentalChain;
-            StateGraph* sg = _currentStateGraph;
-            while(sg)
-            {
-                stateGraphParentalChain.push_back(sg);
-                sg = sg->_parent;
-            }
+            std::vector<const osg::StateSet*> statesets;
+            getStatePathStateSets(statesets);
+
+            const osg::StateSet* rootStateSet = previous_rootStateGraph->getStateSet();
 
             _rootStateGraph = rtts->getStateGraph();
             if (_rootStateGraph)
@@ -1567,20 +1960,9 @@ void CullVisitor::apply(osg::Camera& camera)
                 // assign the state graph to the RenderStage to ensure it remains in memory for the draw traversal.
                 rtts->setStateGraph(_rootStateGraph.get());
             }
-            _currentStateGraph = _rootStateGraph.get();
-
-            StageGraphStack::reverse_iterator ritr = stateGraphParentalChain.rbegin();
-
-            if (ritr!=stateGraphParentalChain.rend())
-            {
-                const osg::StateSet* ss = (*ritr++)->getStateSet();
-                _rootStateGraph->setStateSet(ss);
+            _rootStateGraph->setStateSet(rootStateSet);
 
-                while(ritr != stateGraphParentalChain.rend())
-                {
-                    _currentStateGraph = _currentStateGraph->find_or_insert((*ritr++)->getStateSet());
-                }
-            }
+            pushStatePath(_rootStateGraph.get(), statesets);
         }
 
         // set up clear masks/values
@@ -1623,6 +2005,9 @@ void CullVisitor::apply(osg::Camera& camera)
         // restore the previous renderbin.
         setCurrentRenderBin(previousRenderBin);
 
+        // the RenderStage's leaves need their StateGraphs before it is pruned.
+        addDeferredRenderLeaves();
+
 
         if (rtts->getStateGraphList().size()==0 && rtts->getRenderBinList().size()==0)
         {
@@ -1634,7 +2019,8 @@ void CullVisitor::apply(osg::Camera& camera)
         // restore cache of the StateGraph
         _rootStateGraph->prune();
         _rootStateGraph = previous_rootStateGraph;
-        _currentStateGraph = previous_currentStateGraph;
+        _currentStatePath = previous_currentStatePath;
+        _lastPoppedStatePath = 0;
 
 
         // and the render to texture stage to the current stages
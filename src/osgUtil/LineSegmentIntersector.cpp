@@ -232,6 +232,13 @@ struct IntersectFunctor
     }
 
     void intersect(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2)
+    {
+        intersect(v0, v1-v0, v2-v0, &v0, &v1, &v2);
+    }
+
+    // the triangle given by its first vertex and the edges from it to the other two, the vertex pointers only being
+    // used to compute the indices of the vertices of a hit.
+    void intersect(const osg::Vec3& v0, const osg::Vec3& e1, const osg::Vec3& e2, const osg::Vec3* p0, const osg::Vec3* p1, const osg::Vec3* p2)
     {
         if (_settings->_limitOneIntersection && _hit) return;
 
@@ -240,8 +247,8 @@ struct IntersectFunctor
         // const osg::Vec3& le = startend.second;
 
         Vec3 T = _start - v0;
-        Vec3 E2 = v2 - v0;
-        Vec3 E1 = v1 - v0;
+        Vec3 E2 = e2;
+        Vec3 E1 = e1;
 
         Vec3 P =  _d ^ E2;
 
@@ -328,19 +335,19 @@ struct IntersectFunctor
 
             if (r0!=0.0f)
             {
-                hit.indexList.push_back(&v0-first);
+                hit.indexList.push_back(p0-first);
                 hit.ratioList.push_back(r0);
             }
 
             if (r1!=0.0f)
             {
-                hit.indexList.push_back(&v1-first);
+                hit.indexList.push_back(p1-first);
                 hit.ratioList.push_back(r1);
             }
 
             if (r2!=0.0f)
             {
-                hit.indexList.push_back(&v2-first);
+                hit.indexList.push_back(p2-first);
                 hit.ratioList.push_back(r2);
             }
         }
@@ -391,6 +398,16 @@ struct IntersectFunctor
         intersect((*vertices)[p0], (*vertices)[p1], (*vertices)[p2]);
     }
 
+    void intersect(const osg::Vec3Array* vertices, const osg::KdTree::Triangle& triangle)
+    {
+        if (_settings->_limitOneIntersection && _hit) return;
+
+        _primitiveIndex = triangle.originalIndex;
+
+        const osg::Vec3* first = &(vertices->front());
+        intersect(triangle.v0, triangle.e1, triangle.e2, first+triangle.p0, first+triangle.p1, first+triangle.p2);
+    }
+
     void intersect(const osg::Vec3Array* vertices, int primitiveIndex, unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
     {
         if (_settings->_limitOneIntersection && _hit) return;
@@ -28,11 +28,17 @@
 #include <osg/Sequence>
 #include <osg/Switch>
 #include <osg/Texture>
+#include <osg/Material>
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
 #include <osg/ImageStream>
 #include <osg/Timer>
+#include <osg/Trace>
 #include <osg/TexMat>
+#include <osg/ParallelFor>
+#include <osg/Types>
+#include <osg/SurfaceAreaHeuristic>
+
 #include <osg/io_utils>
 
 #include <osgUtil/TransformAttributeFunctor>
@@ -40,6 +46,8 @@
 #include <osgUtil/Statistics>
 #include <osgUtil/MeshOptimizers>
 
+#include <OpenThreads/Thread>
+
 #include <typeinfo>
 #include <algorithm>
 #include <numeric>
@@ -49,6 +57,21 @@
 
 using namespace osgUtil;
 
+static osg::ApplicationUsageProxy Optimizer_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_SPATIALIZE_GROUPS_STRATEGY <type>","OCTREE | BOUNDING_VOLUME_HIERARCHY");
+
+Optimizer::Optimizer():
+    _spatializeGroupsStrategy(SpatializeGroupsVisitor::OCTREE)
+{
+    const char* env = getenv("OSG_SPATIALIZE_GROUPS_STRATEGY");
+    if (env)
+    {
+        std::string str(env);
+        if (str=="BOUNDING_VOLUME_HIERARCHY") _spatializeGroupsStrategy = SpatializeGroupsVisitor::BOUNDING_VOLUME_HIERARCHY;
+        else if (str=="OCTREE") _spatializeGroupsStrategy = SpatializeGroupsVisitor::OCTREE;
+        else OSG_NOTICE<<"Warning: OSG_SPATIALIZE_GROUPS_STRATEGY \""<<str<<"\" not recognized, use OCTREE or BOUNDING_VOLUME_HIERARCHY."<<std::endl;
+    }
+}
+
 void Optimizer::reset()
 {
 }
@@ -144,6 +167,8 @@ void Optimizer::optimize(osg::Node* node)
 
 void Optimizer::optimize(osg::Node* node, unsigned int options)
 {
+    OSG_TRACE_ZONE("Optimizer::optimize");
+
     StatsVisitor stats;
 
     if (osg::getNotifyLevel()>=osg::INFO)
@@ -156,12 +181,16 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & STATIC_OBJECT_DETECTION)
     {
+        OSG_TRACE_ZONE("Optimizer::STATIC_OBJECT_DETECTION");
+
         StaticObjectDetectionVisitor sodv;
         node->accept(sodv);
     }
 
     if (options & TESSELLATE_GEOMETRY)
     {
+        OSG_TRACE_ZONE("Optimizer::TESSELLATE_GEOMETRY");
+
         OSG_INFO<<"Optimizer::optimize() doing TESSELLATE_GEOMETRY"<<std::endl;
 
         TessellateVisitor tsv;
@@ -170,6 +199,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_LOADED_PROXY_NODES)
     {
+        OSG_TRACE_ZONE("Optimizer::REMOVE_LOADED_PROXY_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing REMOVE_LOADED_PROXY_NODES"<<std::endl;
 
         RemoveLoadedProxyNodesVisitor rlpnv(this);
@@ -180,6 +211,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COMBINE_ADJACENT_LODS)
     {
+        OSG_TRACE_ZONE("Optimizer::COMBINE_ADJACENT_LODS");
+
         OSG_INFO<<"Optimizer::optimize() doing COMBINE_ADJACENT_LODS"<<std::endl;
 
         CombineLODsVisitor clv(this);
@@ -189,6 +222,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & OPTIMIZE_TEXTURE_SETTINGS)
     {
+        OSG_TRACE_ZONE("Optimizer::OPTIMIZE_TEXTURE_SETTINGS");
+
         OSG_INFO<<"Optimizer::optimize() doing OPTIMIZE_TEXTURE_SETTINGS"<<std::endl;
 
         TextureVisitor tv(true,true, // unref image
@@ -200,6 +235,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SHARE_DUPLICATE_STATE)
     {
+        OSG_TRACE_ZONE("Optimizer::SHARE_DUPLICATE_STATE");
+
         OSG_INFO<<"Optimizer::optimize() doing SHARE_DUPLICATE_STATE"<<std::endl;
 
         bool combineDynamicState = false;
@@ -213,6 +250,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & TEXTURE_ATLAS_BUILDER)
     {
+        OSG_TRACE_ZONE("Optimizer::TEXTURE_ATLAS_BUILDER");
+
         OSG_INFO<<"Optimizer::optimize() doing TEXTURE_ATLAS_BUILDER"<<std::endl;
 
         // traverse the scene collecting textures into texture atlas.
@@ -232,6 +271,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COPY_SHARED_NODES)
     {
+        OSG_TRACE_ZONE("Optimizer::COPY_SHARED_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing COPY_SHARED_NODES"<<std::endl;
 
         CopySharedSubgraphsVisitor cssv(this);
@@ -241,6 +282,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS)
     {
+        OSG_TRACE_ZONE("Optimizer::FLATTEN_STATIC_TRANSFORMS");
+
         OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS"<<std::endl;
 
         int i=0;
@@ -262,6 +305,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS)
     {
+        OSG_TRACE_ZONE("Optimizer::FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS");
+
         OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS"<<std::endl;
 
         // now combine any adjacent static transforms.
@@ -272,6 +317,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_REDUNDANT_NODES)
     {
+        OSG_TRACE_ZONE("Optimizer::REMOVE_REDUNDANT_NODES");
+
         OSG_INFO<<"Optimizer::optimize() doing REMOVE_REDUNDANT_NODES"<<std::endl;
 
         RemoveEmptyNodesVisitor renv(this);
@@ -286,6 +333,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEODES)
     {
+        OSG_TRACE_ZONE("Optimizer::MERGE_GEODES");
+
         OSG_INFO<<"Optimizer::optimize() doing MERGE_GEODES"<<std::endl;
 
         osg::Timer_t startTick = osg::Timer::instance()->tick();
@@ -300,6 +349,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MAKE_FAST_GEOMETRY)
     {
+        OSG_TRACE_ZONE("Optimizer::MAKE_FAST_GEOMETRY");
+
         OSG_INFO<<"Optimizer::optimize() doing MAKE_FAST_GEOMETRY"<<std::endl;
 
         MakeFastGeometryVisitor mgv(this);
@@ -308,6 +359,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEOMETRY)
     {
+        OSG_TRACE_ZONE("Optimizer::MERGE_GEOMETRY");
+
         OSG_INFO<<"Optimizer::optimize() doing MERGE_GEOMETRY"<<std::endl;
 
         osg::Timer_t startTick = osg::Timer::instance()->tick();
@@ -324,6 +377,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_BILLBOARDS)
     {
+        OSG_TRACE_ZONE("Optimizer::FLATTEN_BILLBOARDS");
+
         FlattenBillboardVisitor fbv(this);
         node->accept(fbv);
         fbv.process();
@@ -331,15 +386,20 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SPATIALIZE_GROUPS)
     {
+        OSG_TRACE_ZONE("Optimizer::SPATIALIZE_GROUPS");
+
         OSG_INFO<<"Optimizer::optimize() doing SPATIALIZE_GROUPS"<<std::endl;
 
         SpatializeGroupsVisitor sv(this);
+        sv.setDivisionStrategy(_spatializeGroupsStrategy);
         node->accept(sv);
         sv.divide();
     }
 
     if (options & INDEX_MESH)
     {
+        OSG_TRACE_ZONE("Optimizer::INDEX_MESH");
+
         OSG_INFO<<"Optimizer::optimize() doing INDEX_MESH"<<std::endl;
         IndexMeshVisitor imv(this);
         node->accept(imv);
@@ -348,6 +408,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & VERTEX_POSTTRANSFORM)
     {
+        OSG_TRACE_ZONE("Optimizer::VERTEX_POSTTRANSFORM");
+
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_POSTTRANSFORM"<<std::endl;
         VertexCacheVisitor vcv;
         node->accept(vcv);
@@ -356,6 +418,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & VERTEX_PRETRANSFORM)
     {
+        OSG_TRACE_ZONE("Optimizer::VERTEX_PRETRANSFORM");
+
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_PRETRANSFORM"<<std::endl;
         VertexAccessOrderVisitor vaov;
         node->accept(vaov);
@@ -364,6 +428,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & BUFFER_OBJECT_SETTINGS)
     {
+        OSG_TRACE_ZONE("Optimizer::BUFFER_OBJECT_SETTINGS");
+
         OSG_INFO<<"Optimizer::optimize() doing BUFFER_OBJECT_SETTINGS"<<std::endl;
         BufferObjectVisitor bov(true, true, true, true, true, false);
         node->accept(bov);
@@ -411,6 +477,274 @@ struct LessStateSetFunctor
     }
 };
 
+namespace
+{
+
+// 64 bit FNV-1a hashing of the state contents, used to bucket candidates so that only
+// objects whose hashes match need to be compared.
+typedef uint64_t StateHash;
+
+const StateHash STATE_HASH_SEED = 14695981039346656037ULL;
+
+inline StateHash hashBytes(StateHash hash, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(std::size_t i=0; i<size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template<typename T>
+inline StateHash hashValue(StateHash hash, const T& value) { return hashBytes(hash, &value, sizeof(T)); }
+
+inline StateHash hashString(StateHash hash, const std::string& str) { return hashBytes(hashValue(hash, str.size()), str.data(), str.size()); }
+
+// Hash the parameters Image::compare() always compares rather than the image pointer, as images loaded twice compare
+// equal by file name, only the layout being hashed as computeHash(const osg::Image&) samples the data.
+StateHash hashImageParameters(StateHash hash, const osg::Image* image)
+{
+    if (!image) return hashValue(hash, 0);
+
+    hash = hashValue(hash, image->s());
+    hash = hashValue(hash, image->t());
+    hash = hashValue(hash, image->getInternalTextureFormat());
+    hash = hashValue(hash, image->getPixelFormat());
+    hash = hashValue(hash, image->getDataType());
+    hash = hashValue(hash, image->getPacking());
+    return hashValue(hash, image->getModifiedCount());
+}
+
+// StateAttribute::compare() offers no access to the members it compares, so beyond the type only the contents
+// of the commonly duplicated textures and materials are hashed.
+StateHash computeHash(const osg::StateAttribute& attribute)
+{
+    StateHash hash = hashString(hashString(STATE_HASH_SEED, attribute.libraryName()), attribute.className());
+    hash = hashValue(hash, attribute.getType());
+    hash = hashValue(hash, attribute.getMember());
+
+    const osg::Texture* texture = attribute.asTexture();
+    if (texture)
+    {
+        hash = hashValue(hash, texture->getNumImages());
+        for(unsigned int i=0; i<texture->getNumImages(); ++i)
+        {
+            hash = hashImageParameters(hash, texture->getImage(i));
+        }
+
+        hash = hashValue(hash, texture->getWrap(osg::Texture::WRAP_S));
+        hash = hashValue(hash, texture->getWrap(osg::Texture::WRAP_T));
+        hash = hashValue(hash, texture->getWrap(osg::Texture::WRAP_R));
+        hash = hashValue(hash, texture->getFilter(osg::Texture::MIN_FILTER));
+        return hashValue(hash, texture->getFilter(osg::Texture::MAG_FILTER));
+    }
+
+    const osg::Material* material = dynamic_cast<const osg::Material*>(&attribute);
+    if (material)
+    {
+        const osg::Material::Face faces[2] = { osg::Material::FRONT, osg::Material::BACK };
+        hash = hashValue(hash, material->getColorMode());
+        for(unsigned int i=0; i<2; ++i)
+        {
+            hash = hashValue(hash, material->getAmbient(faces[i]));
+            hash = hashValue(hash, material->getDiffuse(faces[i]));
+            hash = hashValue(hash, material->getSpecular(faces[i]));
+            hash = hashValue(hash, material->getEmission(faces[i]));
+            hash = hashValue(hash, material->getShininess(faces[i]));
+        }
+    }
+
+    return hash;
+}
+
+StateHash computeHash(const osg::UniformBase& uniformBase)
+{
+    StateHash hash = hashString(hashString(STATE_HASH_SEED, uniformBase.className()), uniformBase.getName());
+
+    const osg::Uniform* uniform = dynamic_cast<const osg::Uniform*>(&uniformBase);
+    if (!uniform) return hash;
+
+    hash = hashValue(hash, uniform->getType());
+    hash = hashValue(hash, uniform->getNumElements());
+
+    const osg::Array* array = uniform->getFloatArray();
+    if (!array) array = uniform->getDoubleArray();
+    if (!array) array = uniform->getIntArray();
+    if (!array) array = uniform->getUIntArray();
+    if (!array) array = uniform->getUInt64Array();
+    if (!array) array = uniform->getInt64Array();
+    if (array) hash = hashBytes(hash, array->getDataPointer(), array->getTotalDataSize());
+
+    return hash;
+}
+
+// StateSet::compare() compares the attributes by pointer, so run after the duplicate attributes have been shared.
+StateHash computeHash(const osg::StateSet& stateset)
+{
+    StateHash hash = hashValue(STATE_HASH_SEED, stateset.getRenderBinMode());
+    if (stateset.getRenderBinMode()!=osg::StateSet::INHERIT_RENDERBIN_DETAILS)
+    {
+        hash = hashValue(hash, stateset.getBinNumber());
+        hash = hashString(hash, stateset.getBinName());
+    }
+
+    const osg::StateSet::AttributeList& attributes = stateset.getAttributeList();
+    hash = hashValue(hash, attributes.size());
+    for(osg::StateSet::AttributeList::const_iterator itr=attributes.begin(); itr!=attributes.end(); ++itr)
+    {
+        hash = hashValue(hash, itr->first);
+        hash = hashValue(hash, itr->second.first.get());
+        hash = hashValue(hash, itr->second.second);
+    }
+
+    const osg::StateSet::TextureAttributeList& textureAttributes = stateset.getTextureAttributeList();
+    hash = hashValue(hash, textureAttributes.size());
+    for(unsigned int unit=0; unit<textureAttributes.size(); ++unit)
+    {
+        hash = hashValue(hash, textureAttributes[unit].size());
+        for(osg::StateSet::AttributeList::const_iterator itr=textureAttributes[unit].begin(); itr!=textureAttributes[unit].end(); ++itr)
+        {
+            hash = hashValue(hash, itr->first);
+            hash = hashValue(hash, itr->second.first.get());
+            hash = hashValue(hash, itr->second.second);
+        }
+    }
+
+    const osg::StateSet::ModeList& modes = stateset.getModeList();
+    hash = hashValue(hash, modes.size());
+    for(osg::StateSet::ModeList::const_iterator itr=modes.begin(); itr!=modes.end(); ++itr)
+    {
+        hash = hashValue(hash, itr->first);
+        hash = hashValue(hash, itr->second);
+    }
+
+    const osg::StateSet::TextureModeList& textureModes = stateset.getTextureModeList();
+    hash = hashValue(hash, textureModes.size());
+    for(unsigned int unit=0; unit<textureModes.size(); ++unit)
+    {
+        hash = hashValue(hash, textureModes[unit].size());
+        for(osg::StateSet::ModeList::const_iterator itr=textureModes[unit].begin(); itr!=textureModes[unit].end(); ++itr)
+        {
+            hash = hashValue(hash, itr->first);
+            hash = hashValue(hash, itr->second);
+        }
+    }
+
+    // uniforms are compared by content, so hash their name and override value only.
+    const osg::StateSet::UniformList& uniforms = stateset.getUniformList();
+    hash = hashValue(hash, uniforms.size());
+    for(osg::StateSet::UniformList::const_iterator itr=uniforms.begin(); itr!=uniforms.end(); ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashValue(hash, itr->second.second);
+    }
+
+    const osg::StateSet::DefineList& defines = stateset.getDefineList();
+    hash = hashValue(hash, defines.size());
+    for(osg::StateSet::DefineList::const_iterator itr=defines.begin(); itr!=defines.end(); ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashString(hash, itr->second.first);
+        hash = hashValue(hash, itr->second.second);
+    }
+
+    return hash;
+}
+
+bool isImageShareable(const osg::Image& image)
+{
+    return image.data()!=0 &&
+           image.isDataContiguous() &&
+           dynamic_cast<const osg::ImageStream*>(&image)==0;
+}
+
+// Hash the layout and pixel data of an image, large images only having evenly spaced blocks of their data sampled.
+StateHash computeHash(const osg::Image& image)
+{
+    StateHash hash = hashValue(STATE_HASH_SEED, image.s());
+    hash = hashValue(hash, image.t());
+    hash = hashValue(hash, image.r());
+    hash = hashValue(hash, image.getInternalTextureFormat());
+    hash = hashValue(hash, image.getPixelFormat());
+    hash = hashValue(hash, image.getDataType());
+    hash = hashValue(hash, image.getPacking());
+    hash = hashValue(hash, image.getOrigin());
+
+    const osg::Image::MipmapDataType& mipmaps = image.getMipmapLevels();
+    hash = hashValue(hash, mipmaps.size());
+    if (!mipmaps.empty()) hash = hashBytes(hash, &mipmaps.front(), mipmaps.size()*sizeof(unsigned int));
+
+    const std::size_t size = image.getTotalSizeInBytesIncludingMipmaps();
+    hash = hashValue(hash, size);
+
+    const std::size_t numSamples = 64;
+    const std::size_t sampleSize = 1024;
+    if (size<=numSamples*sampleSize)
+    {
+        return hashBytes(hash, image.data(), size);
+    }
+
+    const std::size_t stride = (size-sampleSize)/(numSamples-1);
+    for(std::size_t i=0; i<numSamples; ++i)
+    {
+        hash = hashBytes(hash, image.data()+i*stride, sampleSize);
+    }
+    return hash;
+}
+
+bool isImageDataEqual(const osg::Image& lhs, const osg::Image& rhs)
+{
+    if (lhs.s()!=rhs.s() || lhs.t()!=rhs.t() || lhs.r()!=rhs.r()) return false;
+    if (lhs.getInternalTextureFormat()!=rhs.getInternalTextureFormat() ||
+        lhs.getPixelFormat()!=rhs.getPixelFormat() ||
+        lhs.getDataType()!=rhs.getDataType() ||
+        lhs.getPacking()!=rhs.getPacking() ||
+        lhs.getOrigin()!=rhs.getOrigin()) return false;
+    if (lhs.getMipmapLevels()!=rhs.getMipmapLevels()) return false;
+
+    const unsigned int size = lhs.getTotalSizeInBytesIncludingMipmaps();
+    return size==rhs.getTotalSizeInBytesIncludingMipmaps() && memcmp(lhs.data(), rhs.data(), size)==0;
+}
+
+/** Find the duplicates in a list of objects, returning them as pairs of the duplicate and the instance to replace it with.
+  * The objects are first bucketed by hash and only those in the same bucket are sorted and compared, which keeps the
+  * number of potentially expensive comparisons linear in the number of objects when the hashes discriminate well.*/
+template<typename T>
+void findDuplicates(std::vector< std::pair<StateHash, T*> >& objects, std::vector< std::pair<T*, T*> >& duplicates)
+{
+    std::sort(objects.begin(), objects.end());
+
+    std::vector<T*> bucket;
+    typename std::vector< std::pair<StateHash, T*> >::iterator itr = objects.begin();
+    while(itr!=objects.end())
+    {
+        typename std::vector< std::pair<StateHash, T*> >::iterator end = itr;
+        bucket.clear();
+        for(; end!=objects.end() && end->first==itr->first; ++end)
+        {
+            bucket.push_back(end->second);
+        }
+        itr = end;
+
+        if (bucket.size()<2) continue;
+
+        // sort the bucket so that equal objects sit along side each other.
+        std::sort(bucket.begin(), bucket.end(), LessDerefFunctor<T>());
+
+        typename std::vector<T*>::iterator first_unique = bucket.begin();
+        typename std::vector<T*>::iterator current = first_unique;
+        for(++current; current!=bucket.end(); ++current)
+        {
+            if (**current==**first_unique) duplicates.push_back(std::pair<T*, T*>(*current, *first_unique));
+            else first_unique = current;
+        }
+    }
+}
+
+}
+
 
 
 void Optimizer::StateVisitor::reset()
@@ -505,104 +839,118 @@ void Optimizer::StateVisitor::optimize()
 
         }
 
-        if (attributeToStateSetMap.size()>=2)
+        // share the images of textures which hold identical pixel data, so that the textures themselves compare equal.
         {
-            // create unique set of state attribute pointers.
-            typedef std::vector<osg::StateAttribute*> AttributeList;
-            AttributeList attributeList;
+            typedef std::map<StateHash, std::vector<osg::Image*> > ImageBucketMap;
+            ImageBucketMap imageBuckets;
+            unsigned int numImagesShared = 0;
 
             for(AttributeToStateSetMap::iterator aitr=attributeToStateSetMap.begin();
                 aitr!=attributeToStateSetMap.end();
                 ++aitr)
             {
-                attributeList.push_back(aitr->first);
+                osg::Texture* texture = aitr->first->asTexture();
+                if (!texture || !isOperationPermissibleForObject(texture)) continue;
+
+                for(unsigned int i=0; i<texture->getNumImages(); ++i)
+                {
+                    osg::Image* image = texture->getImage(i);
+                    if (!image || !optimize(image->getDataVariance()) || !isImageShareable(*image)) continue;
+
+                    std::vector<osg::Image*>& bucket = imageBuckets[computeHash(*image)];
+
+                    osg::Image* sharedImage = 0;
+                    for(std::vector<osg::Image*>::iterator itr=bucket.begin(); itr!=bucket.end() && !sharedImage; ++itr)
+                    {
+                        if (*itr==image || isImageDataEqual(**itr, *image)) sharedImage = *itr;
+                    }
+
+                    if (!sharedImage)
+                    {
+                        bucket.push_back(image);
+                    }
+                    else if (sharedImage!=image)
+                    {
+                        OSG_INFO << "    sharing duplicate image "<<image->getFileName()<<" with "<<sharedImage->getFileName()<< std::endl;
+                        texture->setImage(i, sharedImage);
+                        ++numImagesShared;
+                    }
+                }
             }
 
-            // sort the attributes so that equal attributes sit along side each
-            // other.
-            std::sort(attributeList.begin(),attributeList.end(),LessDerefFunctor<osg::StateAttribute>());
+            OSG_INFO << "Num of duplicate Image shared="<<numImagesShared<< std::endl;
+        }
+
+        if (attributeToStateSetMap.size()>=2)
+        {
+            typedef std::vector< std::pair<StateHash, osg::StateAttribute*> > HashedAttributeList;
+            HashedAttributeList attributeList;
+            attributeList.reserve(attributeToStateSetMap.size());
 
-            OSG_INFO << "state attribute list"<< std::endl;
-            for(AttributeList::iterator aaitr = attributeList.begin();
-                aaitr!=attributeList.end();
-                ++aaitr)
+            for(AttributeToStateSetMap::iterator aitr=attributeToStateSetMap.begin();
+                aitr!=attributeToStateSetMap.end();
+                ++aitr)
             {
-                OSG_INFO << "    "<<*aaitr << "  "<<(*aaitr)->className()<< std::endl;
+                attributeList.push_back(HashedAttributeList::value_type(computeHash(*aitr->first), aitr->first));
             }
 
             OSG_INFO << "searching for duplicate attributes"<< std::endl;
-            // find the duplicates.
-            AttributeList::iterator first_unique = attributeList.begin();
-            AttributeList::iterator current = first_unique;
-            ++current;
-            for(; current!=attributeList.end();++current)
+            typedef std::vector< std::pair<osg::StateAttribute*, osg::StateAttribute*> > AttributeDuplicateList;
+            AttributeDuplicateList duplicates;
+            findDuplicates(attributeList, duplicates);
+
+            for(AttributeDuplicateList::iterator ditr=duplicates.begin();
+                ditr!=duplicates.end();
+                ++ditr)
             {
-                if (**current==**first_unique)
+                OSG_INFO << "    found duplicate "<<ditr->first->className()<<"  first="<<ditr->second<<"  current="<<ditr->first<< std::endl;
+                StateSetList& statesetlist = attributeToStateSetMap[ditr->first];
+                for(StateSetList::iterator sitr=statesetlist.begin();
+                    sitr!=statesetlist.end();
+                    ++sitr)
                 {
-                    OSG_INFO << "    found duplicate "<<(*current)->className()<<"  first="<<*first_unique<<"  current="<<*current<< std::endl;
-                    StateSetList& statesetlist = attributeToStateSetMap[*current];
-                    for(StateSetList::iterator sitr=statesetlist.begin();
-                        sitr!=statesetlist.end();
-                        ++sitr)
-                    {
-                        OSG_INFO << "       replace duplicate "<<*current<<" with "<<*first_unique<< std::endl;
-                        osg::StateSet* stateset = sitr->first;
-                        unsigned int unit = sitr->second;
-                        if (unit==NON_TEXTURE_ATTRIBUTE) stateset->setAttribute(*first_unique);
-                        else stateset->setTextureAttribute(unit,*first_unique);
-                    }
+                    OSG_INFO << "       replace duplicate "<<ditr->first<<" with "<<ditr->second<< std::endl;
+                    osg::StateSet* stateset = sitr->first;
+                    unsigned int unit = sitr->second;
+                    if (unit==NON_TEXTURE_ATTRIBUTE) stateset->setAttribute(ditr->second);
+                    else stateset->setTextureAttribute(unit,ditr->second);
                 }
-                else first_unique = current;
             }
         }
 
 
         if (uniformToStateSetMap.size()>=2)
         {
-            // create unique set of uniform pointers.
-            typedef std::vector<osg::UniformBase*> UniformList;
-            UniformList uniformList;
+            typedef std::vector< std::pair<StateHash, osg::UniformBase*> > HashedUniformList;
+            HashedUniformList uniformList;
+            uniformList.reserve(uniformToStateSetMap.size());
 
-            for(UniformToStateSetMap::iterator aitr=uniformToStateSetMap.begin();
-                aitr!=uniformToStateSetMap.end();
-                ++aitr)
-            {
-                uniformList.push_back(aitr->first);
-            }
-
-            // sort the uniforms so that equal uniforms sit along side each
-            // other.
-            std::sort(uniformList.begin(),uniformList.end(),LessDerefFunctor<osg::UniformBase>());
-
-            OSG_INFO << "state uniform list"<< std::endl;
-            for(UniformList::iterator uuitr = uniformList.begin();
-                uuitr!=uniformList.end();
-                ++uuitr)
+            for(UniformToStateSetMap::iterator uitr=uniformToStateSetMap.begin();
+                uitr!=uniformToStateSetMap.end();
+                ++uitr)
             {
-                OSG_INFO << "    "<<*uuitr << "  "<<(*uuitr)->getName()<< std::endl;
+                uniformList.push_back(HashedUniformList::value_type(computeHash(*uitr->first), uitr->first));
             }
 
             OSG_INFO << "searching for duplicate uniforms"<< std::endl;
-            // find the duplicates.
-            UniformList::iterator first_unique_uniform = uniformList.begin();
-            UniformList::iterator current_uniform = first_unique_uniform;
-            ++current_uniform;
-            for(; current_uniform!=uniformList.end();++current_uniform)
+            typedef std::vector< std::pair<osg::UniformBase*, osg::UniformBase*> > UniformDuplicateList;
+            UniformDuplicateList duplicates;
+            findDuplicates(uniformList, duplicates);
+
+            for(UniformDuplicateList::iterator ditr=duplicates.begin();
+                ditr!=duplicates.end();
+                ++ditr)
             {
-                if ((**current_uniform)==(**first_unique_uniform))
+                OSG_INFO << "    found duplicate uniform "<<ditr->first->getName()<<"  first_unique_uniform="<<ditr->second<<"  current_uniform="<<ditr->first<< std::endl;
+                StateSetSet& statesetset = uniformToStateSetMap[ditr->first];
+                for(StateSetSet::iterator sitr=statesetset.begin();
+                    sitr!=statesetset.end();
+                    ++sitr)
                 {
-                    OSG_INFO << "    found duplicate uniform "<<(*current_uniform)->getName()<<"  first_unique_uniform="<<*first_unique_uniform<<"  current_uniform="<<*current_uniform<< std::endl;
-                    StateSetSet& statesetset = uniformToStateSetMap[*current_uniform];
-                    for(StateSetSet::iterator sitr=statesetset.begin();
-                        sitr!=statesetset.end();
-                        ++sitr)
-                    {
-                        OSG_INFO << "       replace duplicate "<<*current_uniform<<" with "<<*first_unique_uniform<< std::endl;
-                        osg::StateSet* stateset = *sitr;
-                        stateset->addUniform(*first_unique_uniform);
-                    }
+                    OSG_INFO << "       replace duplicate "<<ditr->first<<" with "<<ditr->second<< std::endl;
+                    osg::StateSet* stateset = *sitr;
+                    stateset->addUniform(ditr->second);
                 }
-                else first_unique_uniform = current_uniform;
             }
         }
 
@@ -612,40 +960,35 @@ void Optimizer::StateVisitor::optimize()
     // now need to look at duplicate state sets.
     if (_statesets.size()>=2)
     {
-        // create the list of stateset's.
-        typedef std::vector<osg::StateSet*> StateSetSortList;
-        StateSetSortList statesetSortList;
+        typedef std::vector< std::pair<StateHash, osg::StateSet*> > HashedStateSetList;
+        HashedStateSetList statesetList;
+        statesetList.reserve(_statesets.size());
+
         for(StateSetMap::iterator ssitr=_statesets.begin();
             ssitr!=_statesets.end();
             ++ssitr)
         {
-            statesetSortList.push_back(ssitr->first);
+            statesetList.push_back(HashedStateSetList::value_type(computeHash(*ssitr->first), ssitr->first));
         }
 
+        OSG_INFO << "searching for duplicate statesets"<< std::endl;
+        typedef std::vector< std::pair<osg::StateSet*, osg::StateSet*> > StateSetDuplicateList;
+        StateSetDuplicateList duplicates;
+        findDuplicates(statesetList, duplicates);
 
-        // sort the StateSet's so that equal StateSet's sit along side each
-        // other.
-        std::sort(statesetSortList.begin(),statesetSortList.end(),LessDerefFunctor<osg::StateSet>());
-
-        OSG_INFO << "searching for duplicate attributes"<< std::endl;
-        // find the duplicates.
-        StateSetSortList::iterator first_unique = statesetSortList.begin();
-        StateSetSortList::iterator current = first_unique; ++current;
-        for(; current!=statesetSortList.end();++current)
+        for(StateSetDuplicateList::iterator ditr=duplicates.begin();
+            ditr!=duplicates.end();
+            ++ditr)
         {
-            if (**current==**first_unique)
+            OSG_INFO << "    found duplicate "<<ditr->first->className()<<"  first="<<ditr->second<<"  current="<<ditr->first<< std::endl;
+            NodeSet& nodeSet = _statesets[ditr->first];
+            for(NodeSet::iterator sitr=nodeSet.begin();
+                sitr!=nodeSet.end();
+                ++sitr)
             {
-                OSG_INFO << "    found duplicate "<<(*current)->className()<<"  first="<<*first_unique<<"  current="<<*current<< std::endl;
-                NodeSet& nodeSet = _statesets[*current];
-                for(NodeSet::iterator sitr=nodeSet.begin();
-                    sitr!=nodeSet.end();
-                    ++sitr)
-                {
-                    OSG_INFO << "       replace duplicate "<<*current<<" with "<<*first_unique<< std::endl;
-                    (*sitr)->setStateSet(*first_unique);
-                }
+                OSG_INFO << "       replace duplicate "<<ditr->first<<" with "<<ditr->second<< std::endl;
+                (*sitr)->setStateSet(ditr->second);
             }
-            else first_unique = current;
         }
     }
 
@@ -1733,43 +2076,167 @@ void Optimizer::MakeFastGeometryVisitor::apply(osg::Geometry& geom)
 /// Shortcut to get size of an array, even if pointer is NULL.
 inline unsigned int getSize(const osg::Array * a) { return a ? a->getNumElements() : 0; }
 
-/// When merging geometries, tests if two arrays can be merged, regarding to their number of components, and the number of vertices.
-bool isArrayCompatible(unsigned int numVertice1, unsigned int numVertice2, const osg::Array* compare1, const osg::Array* compare2)
-{
-    // Sumed up truth table:
-    //  If array (1 or 2) not empty and vertices empty => error, should not happen (allows simplification in formulae below)
-    //  If one side has both vertices and array, and the other side has only vertices => then arrays cannot be merged
-    //  Else, arrays can be merged
-    //assert(numVertice1 || !getSize(compare1));
-    //assert(numVertice2 || !getSize(compare2));
-    return !(   (numVertice1 && !getSize(compare1) && getSize(compare2))
-             || (numVertice2 && !getSize(compare2) && getSize(compare1)) );
+/// Signature of the array types of a geometry, geometries can only be merged without loss of data when their signatures match.
+typedef std::vector<int> GeometryLayout;
+
+inline void addToLayout(GeometryLayout& layout, const osg::Array* array)
+{
+    layout.push_back(getSize(array)>0 ? static_cast<int>(array->getType()) : -1);
+}
+
+void computeGeometryLayout(const osg::Geometry& geometry, GeometryLayout& layout)
+{
+    layout.clear();
+    addToLayout(layout, geometry.getVertexArray());
+    addToLayout(layout, geometry.getNormalArray());
+    addToLayout(layout, geometry.getColorArray());
+    addToLayout(layout, geometry.getSecondaryColorArray());
+    addToLayout(layout, geometry.getFogCoordArray());
+
+    layout.push_back(geometry.getNumTexCoordArrays());
+    for(unsigned int i=0; i<geometry.getNumTexCoordArrays(); ++i)
+    {
+        addToLayout(layout, geometry.getTexCoordArray(i));
+    }
+
+    layout.push_back(geometry.getNumVertexAttribArrays());
+    for(unsigned int i=0; i<geometry.getNumVertexAttribArrays(); ++i)
+    {
+        addToLayout(layout, geometry.getVertexAttribArray(i));
+    }
 }
 
-/// Return true only if both geometries have same array type and if arrays (such as TexCoords) are compatible (i.e. both empty or both filled)
-bool isAbleToMerge(const osg::Geometry& g1, const osg::Geometry& g2)
+/// Key of the merge buckets, combining the array layout with the StateSet and bindings compared by LessGeometry.
+struct GeometryMergeKey
 {
-    unsigned int numVertice1( getSize(g1.getVertexArray()) );
-    unsigned int numVertice2( getSize(g2.getVertexArray()) );
+    GeometryMergeKey(osg::Geometry* g):
+        geometry(g) { computeGeometryLayout(*g, layout); }
+
+    bool operator < (const GeometryMergeKey& rhs) const
+    {
+        if (layout<rhs.layout) return true;
+        if (rhs.layout<layout) return false;
+        return LessGeometry()(geometry, rhs.geometry);
+    }
 
-    // first verify arrays size
-    if (!isArrayCompatible(numVertice1,numVertice2,g1.getNormalArray(),g2.getNormalArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getColorArray(),g2.getColorArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getSecondaryColorArray(),g2.getSecondaryColorArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getFogCoordArray(),g2.getFogCoordArray()) ||
-        g1.getNumTexCoordArrays()!=g2.getNumTexCoordArrays()) return false;
+    osg::ref_ptr<osg::Geometry> geometry;
+    GeometryLayout              layout;
+};
 
-    for (unsigned int eachTexCoordArray=0;eachTexCoordArray<g1.getNumTexCoordArrays();++eachTexCoordArray)
+/// Reserve the lhs arrays to their merged size so that appending the rhs arrays never reallocates.
+void reserveMergedArrays(osg::Geometry& lhs, const std::vector< osg::ref_ptr<osg::Geometry> >& geometries)
+{
+    typedef std::vector<osg::Array*> ArrayList;
+    ArrayList lhsArrays;
+    lhsArrays.push_back(lhs.getVertexArray());
+    lhsArrays.push_back(lhs.getNormalArray());
+    lhsArrays.push_back(lhs.getColorArray());
+    lhsArrays.push_back(lhs.getSecondaryColorArray());
+    lhsArrays.push_back(lhs.getFogCoordArray());
+    for(unsigned int i=0; i<lhs.getNumTexCoordArrays(); ++i) lhsArrays.push_back(lhs.getTexCoordArray(i));
+    for(unsigned int i=0; i<lhs.getNumVertexAttribArrays(); ++i) lhsArrays.push_back(lhs.getVertexAttribArray(i));
+
+    std::vector<unsigned int> sizes(lhsArrays.size(), 0);
+    for(std::vector< osg::ref_ptr<osg::Geometry> >::const_iterator itr = geometries.begin();
+        itr != geometries.end();
+        ++itr)
+    {
+        const osg::Geometry& geometry = **itr;
+        unsigned int i = 0;
+        sizes[i++] += getSize(geometry.getVertexArray());
+        sizes[i++] += getSize(geometry.getNormalArray());
+        sizes[i++] += getSize(geometry.getColorArray());
+        sizes[i++] += getSize(geometry.getSecondaryColorArray());
+        sizes[i++] += getSize(geometry.getFogCoordArray());
+        for(unsigned int unit=0; unit<lhs.getNumTexCoordArrays(); ++unit) sizes[i++] += getSize(geometry.getTexCoordArray(unit));
+        for(unsigned int unit=0; unit<lhs.getNumVertexAttribArrays(); ++unit) sizes[i++] += getSize(geometry.getVertexAttribArray(unit));
+    }
+
+    for(unsigned int i=0; i<lhsArrays.size(); ++i)
     {
-        if (!isArrayCompatible(numVertice1,numVertice2,g1.getTexCoordArray(eachTexCoordArray),g2.getTexCoordArray(eachTexCoordArray))) return false;
+        if (lhsArrays[i] && lhsArrays[i]->getBinding()!=osg::Array::BIND_OVERALL) lhsArrays[i]->reserveArray(sizes[i]);
     }
+}
+
+typedef std::vector< osg::ref_ptr<osg::Geometry> > GeometryMergeList;
+typedef std::vector< GeometryMergeList > GeometryMergeLists;
+
+/// Merge each list of geometries into its first geometry, run in parallel when mergeListsAreIndependent() finds the lists share nothing.
+struct MergeGeometryLists : public osg::ParallelForFunctor
+{
+    MergeGeometryLists(GeometryMergeLists& mergeLists):
+        _mergeLists(mergeLists) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            GeometryMergeList& mergeList = _mergeLists[i];
+            if (mergeList.size()<2) continue;
 
-    // then verify data type compatibility
-    if (g1.getVertexArray() && g2.getVertexArray() && g1.getVertexArray()->getDataType()!=g2.getVertexArray()->getDataType()) return false;
-    if (g1.getNormalArray() && g2.getNormalArray() && g1.getNormalArray()->getDataType()!=g2.getNormalArray()->getDataType()) return false;
-    if (g1.getColorArray() && g2.getColorArray() && g1.getColorArray()->getDataType()!=g2.getColorArray()->getDataType()) return false;
-    if (g1.getSecondaryColorArray() && g2.getSecondaryColorArray() && g1.getSecondaryColorArray()->getDataType()!=g2.getSecondaryColorArray()->getDataType()) return false;
-    if (g1.getFogCoordArray() && g2.getNormalArray() && g1.getFogCoordArray()->getDataType()!=g2.getFogCoordArray()->getDataType()) return false;
+            osg::Geometry& lhs = *mergeList.front();
+            reserveMergedArrays(lhs, mergeList);
+
+            for(GeometryMergeList::iterator itr = mergeList.begin()+1;
+                itr != mergeList.end();
+                ++itr)
+            {
+                Optimizer::MergeGeometryVisitor::mergeGeometry(lhs, **itr);
+            }
+        }
+    }
+
+    GeometryMergeLists& _mergeLists;
+};
+
+/// Record the object as used by the merge list listIndex, returning false if another merge list already uses it.
+inline bool claimForMergeList(std::map<const osg::Object*, unsigned int>& owners, const osg::Object* object, unsigned int listIndex)
+{
+    if (!object) return true;
+    std::pair<std::map<const osg::Object*, unsigned int>::iterator, bool> result = owners.insert(std::make_pair(object, listIndex));
+    return result.second || result.first->second==listIndex;
+}
+
+/// Return true if the merge lists can be merged concurrently, with no geometry having any parent other than group and
+/// no geometry, array, primitive set or buffer object being used by more than one list, as merging modifies them.
+bool mergeListsAreIndependent(const GeometryMergeLists& mergeLists, const osg::Group& group)
+{
+    std::map<const osg::Object*, unsigned int> owners;
+    for(unsigned int listIndex=0; listIndex<mergeLists.size(); ++listIndex)
+    {
+        const GeometryMergeList& mergeList = mergeLists[listIndex];
+        if (mergeList.size()<2) continue;
+
+        for(GeometryMergeList::const_iterator itr = mergeList.begin();
+            itr != mergeList.end();
+            ++itr)
+        {
+            const osg::Geometry* geometry = itr->get();
+            if (geometry->getNumParents()!=1 || geometry->getParent(0)!=&group) return false;
+            if (!claimForMergeList(owners, geometry, listIndex)) return false;
+
+            osg::Geometry::ArrayList arrays;
+            geometry->getArrayList(arrays);
+            for(osg::Geometry::ArrayList::const_iterator aitr = arrays.begin();
+                aitr != arrays.end();
+                ++aitr)
+            {
+                const osg::Array* array = aitr->get();
+                if (!claimForMergeList(owners, array, listIndex)) return false;
+                if (!claimForMergeList(owners, array->getBufferObject(), listIndex)) return false;
+            }
+
+            const osg::Geometry::PrimitiveSetList& primitives = geometry->getPrimitiveSetList();
+            for(osg::Geometry::PrimitiveSetList::const_iterator pitr = primitives.begin();
+                pitr != primitives.end();
+                ++pitr)
+            {
+                const osg::PrimitiveSet* primitive = pitr->get();
+                if (!claimForMergeList(owners, primitive, listIndex)) return false;
+                if (primitive->getDrawElements() && !claimForMergeList(owners, primitive->getDrawElements()->getElementBufferObject(), listIndex)) return false;
+            }
+        }
+    }
     return true;
 }
 
@@ -1780,12 +2247,13 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
     if (group.getNumChildren()>=2)
     {
 
-        typedef std::vector< osg::ref_ptr<osg::Geometry> >                          DuplicateList;
+        typedef GeometryMergeList                                                   DuplicateList;
         typedef std::vector< osg::ref_ptr<osg::Node> >                              Nodes;
-        typedef std::map< osg::ref_ptr<osg::Geometry> ,DuplicateList,LessGeometry>  GeometryDuplicateMap;
+        typedef std::map< GeometryMergeKey, DuplicateList >                         GeometryDuplicateMap;
 
-        typedef std::vector<DuplicateList> MergeList;
+        typedef GeometryMergeLists MergeList;
 
+        // bucket the geometries in one pass by StateSet, bindings and array layout, so every bucket can be merged without loss of data
         GeometryDuplicateMap geometryDuplicateMap;
         Nodes standardChildren;
 
@@ -1800,7 +2268,7 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
                     geom->getDataVariance()!=osg::Object::DYNAMIC &&
                     isOperationPermissibleForObject(geom))
                 {
-                    geometryDuplicateMap[geom].push_back(geom);
+                    geometryDuplicateMap[GeometryMergeKey(geom)].push_back(geom);
                 }
                 else
                 {
@@ -1813,82 +2281,24 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
             }
         }
 
-        // first try to group geometries with the same properties
-        // (i.e. array types) to avoid loss of data during merging
-        MergeList mergeListChecked;        // List of drawables just before merging, grouped by "compatibility" and vertex limit
-        MergeList mergeList;            // Intermediate list of drawables, grouped ony by "compatibility"
+        // then build merge list using _targetMaximumNumberOfVertices
+        MergeList mergeList;
+        bool needToDoMerge = false;
+        unsigned int numGeometriesToMerge = 0;
         for(GeometryDuplicateMap::iterator itr=geometryDuplicateMap.begin();
             itr!=geometryDuplicateMap.end();
             ++itr)
         {
-            if (itr->second.empty()) continue;
-            if (itr->second.size()==1)
-            {
-                mergeList.push_back(DuplicateList());
-                DuplicateList* duplicateList = &mergeList.back();
-                duplicateList->push_back(itr->second[0]);
-                continue;
-            }
-
-            std::sort(itr->second.begin(),itr->second.end(),LessGeometryPrimitiveType());
-
-            // initialize the temporary list by pushing the first geometry
-            MergeList mergeListTmp;
-            mergeListTmp.push_back(DuplicateList());
-            DuplicateList* duplicateList = &mergeListTmp.back();
-            duplicateList->push_back(itr->second[0]);
-
-            for(DuplicateList::iterator dupItr=itr->second.begin()+1;
-                dupItr!=itr->second.end();
-                ++dupItr)
-            {
-                osg::Geometry* geomToPush = dupItr->get();
-
-                // try to group geomToPush with another geometry
-                MergeList::iterator eachMergeList=mergeListTmp.begin();
-                for(;eachMergeList!=mergeListTmp.end();++eachMergeList)
-                {
-                    if (!eachMergeList->empty() && eachMergeList->front()!=NULL
-                        && isAbleToMerge(*eachMergeList->front(),*geomToPush))
-                    {
-                        eachMergeList->push_back(geomToPush);
-                        break;
-                    }
-                }
-
-                // if no suitable group was found, then a new one is created
-                if (eachMergeList==mergeListTmp.end())
-                {
-                    mergeListTmp.push_back(DuplicateList());
-                    duplicateList = &mergeListTmp.back();
-                    duplicateList->push_back(geomToPush);
-                }
-            }
-
-            // copy the group in the mergeListChecked
-            for(MergeList::iterator eachMergeList=mergeListTmp.begin();eachMergeList!=mergeListTmp.end();++eachMergeList)
-            {
-                mergeListChecked.push_back(*eachMergeList);
-            }
-        }
-
-        // then build merge list using _targetMaximumNumberOfVertices
-        bool needToDoMerge = false;
-        // dequeue each DuplicateList when vertices limit is reached or when all elements has been checked
-        for(MergeList::iterator itr=mergeListChecked.begin(); itr!=mergeListChecked.end(); ++itr)
-        {
-            DuplicateList& duplicateList(*itr);
-            if (duplicateList.size()==0)
-            {
-                continue;
-            }
-
+            DuplicateList& duplicateList = itr->second;
             if (duplicateList.size()==1)
             {
                 mergeList.push_back(duplicateList);
                 continue;
             }
 
+            // keep the primitive types together so that the primitive sets can be combined after merging
+            std::sort(duplicateList.begin(),duplicateList.end(),LessGeometryPrimitiveType());
+
             unsigned int totalNumberVertices = 0;
             DuplicateList subset;
             for(DuplicateList::iterator ditr = duplicateList.begin();
@@ -1906,16 +2316,28 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
                 }
                 totalNumberVertices += numVertices;
                 subset.push_back(geometry);
-                if (subset.size()>1) needToDoMerge = true;
+                if (subset.size()>1)
+                {
+                    needToDoMerge = true;
+                    ++numGeometriesToMerge;
+                }
             }
             if (!subset.empty()) mergeList.push_back(subset);
         }
 
         if (needToDoMerge)
         {
+            // merge the lists in parallel when there is enough work to share out and they share nothing that merging modifies,
+            // checked before the children are removed so that any other parents of the geometries are seen.
+            bool mergeInParallel = numGeometriesToMerge>=1000 && mergeListsAreIndependent(mergeList, group);
+
             // to avoid performance issues associated with incrementally removing a large number children, we remove them all and add back the ones we need.
             group.removeChildren(0, group.getNumChildren());
 
+            // now do the merging of geometries
+            MergeGeometryLists mergeGeometryLists(mergeList);
+            osg::parallelFor(mergeList.size(), mergeGeometryLists, 1, mergeInParallel ? 0 : 1);
+
             for(Nodes::iterator itr = standardChildren.begin();
                 itr != standardChildren.end();
                 ++itr)
@@ -1923,25 +2345,11 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
                 group.addChild(*itr);
             }
 
-            // now do the merging of geometries
             for(MergeList::iterator mitr = mergeList.begin();
                 mitr != mergeList.end();
                 ++mitr)
             {
-                DuplicateList& duplicateList = *mitr;
-                if (!duplicateList.empty())
-                {
-                    DuplicateList::iterator ditr = duplicateList.begin();
-                    osg::ref_ptr<osg::Geometry> lhs = *ditr++;
-                    group.addChild(lhs.get());
-
-                    for(;
-                        ditr != duplicateList.end();
-                        ++ditr)
-                    {
-                        mergeGeometry(*lhs, **ditr);
-                    }
-                }
+                if (!mitr->empty()) group.addChild(mitr->front().get());
             }
         }
     }
@@ -2517,6 +2925,8 @@ bool Optimizer::SpatializeGroupsVisitor::divide(osg::Group* group, unsigned int
 {
     if (group->getNumChildren()<=maxNumTreesPerCell) return false;
 
+    if (_divisionStrategy==BOUNDING_VOLUME_HIERARCHY) return divideBoundingVolumeHierarchy(group, maxNumTreesPerCell);
+
     // create the original box.
     osg::BoundingBox bb;
     for(unsigned int i=0;i<group->getNumChildren();++i)
@@ -2679,6 +3089,292 @@ bool Optimizer::SpatializeGroupsVisitor::divide(osg::Group* group, unsigned int
 
 }
 
+namespace
+{
+
+/** Binary bounding volume hierarchy over the children of a group, built with binned surface area heuristic splits.*/
+struct BuildBoundingVolumeHierarchy
+{
+    struct BVHNode
+    {
+        BVHNode(): left(-1), right(-1), begin(0), end(0) {}
+
+        bool isLeaf() const { return left<0; }
+
+        osg::BoundingBox    bb;
+        int                 left;
+        int                 right;
+        unsigned int        begin;
+        unsigned int        end;
+    };
+    typedef std::vector<BVHNode> BVHNodes;
+
+    // the children range of a node left by divide() for BuildSubtrees to build on one of the parallelFor() threads
+    struct Subtree
+    {
+        Subtree(int ni, unsigned int b, unsigned int e):
+            nodeIndex(ni), begin(b), end(e) {}
+
+        int             nodeIndex;
+        unsigned int    begin;
+        unsigned int    end;
+        BVHNodes        nodes;
+    };
+    typedef std::vector<Subtree> Subtrees;
+
+    BuildBoundingVolumeHierarchy(unsigned int maxLeafSize):
+        _maxLeafSize(maxLeafSize) {}
+
+    void build()
+    {
+        unsigned int numItems = _indices.size();
+        unsigned int numThreads = std::max(OpenThreads::GetNumberOfProcessors(), 1);
+
+        unsigned int parallelThreshold = osg::SurfaceAreaHeuristicSplit::computeParallelSubtreeSize(numItems, numThreads, 2048);
+
+        Subtrees subtrees;
+        divide(_nodes, 0, numItems, parallelThreshold>0 ? &subtrees : 0, parallelThreshold);
+
+        if (subtrees.empty()) return;
+
+        BuildSubtrees buildSubtrees(*this, subtrees);
+        osg::parallelFor(subtrees.size(), buildSubtrees, 1, numThreads);
+
+        // splice the subtrees' nodes into _nodes, offsetting their child indices by where they land
+        for(Subtrees::iterator itr = subtrees.begin();
+            itr != subtrees.end();
+            ++itr)
+        {
+            int offset = static_cast<int>(_nodes.size())-1;
+            for(BVHNodes::iterator nitr = itr->nodes.begin();
+                nitr != itr->nodes.end();
+                ++nitr)
+            {
+                if (!nitr->isLeaf())
+                {
+                    nitr->left += offset;
+                    nitr->right += offset;
+                }
+            }
+
+            _nodes[itr->nodeIndex] = itr->nodes.front();
+            _nodes.insert(_nodes.end(), itr->nodes.begin()+1, itr->nodes.end());
+        }
+    }
+
+    int divide(BVHNodes& nodes, unsigned int begin, unsigned int end, Subtrees* subtrees, unsigned int parallelThreshold)
+    {
+        int nodeIndex = static_cast<int>(nodes.size());
+        nodes.push_back(BVHNode());
+        nodes.back().begin = begin;
+        nodes.back().end = end;
+
+        unsigned int numItems = end-begin;
+        if (subtrees && numItems<=parallelThreshold)
+        {
+            subtrees->push_back(Subtree(nodeIndex, begin, end));
+            return nodeIndex;
+        }
+
+        osg::BoundingBox bb, centerBB;
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            bb.expandBy(_bounds[_indices[i]]);
+            centerBB.expandBy(_centers[_indices[i]]);
+        }
+        nodes[nodeIndex].bb = bb;
+
+        if (numItems<=_maxLeafSize) return nodeIndex;
+
+        osg::SurfaceAreaHeuristicSplit split(_bounds, _centers);
+        unsigned int mid = split.find(_indices, begin, end, centerBB) ? split.partition(_indices, begin, end) : begin;
+
+        // fall back to splitting at the median when the centers can't be separated by the bins
+        if (mid==begin || mid==end)
+        {
+            mid = begin + numItems/2;
+            std::nth_element(_indices.begin()+begin, _indices.begin()+mid, _indices.begin()+end, LessCenter(_centers, split.getAxis()));
+        }
+
+        int left = divide(nodes, begin, mid, subtrees, parallelThreshold);
+        int right = divide(nodes, mid, end, subtrees, parallelThreshold);
+
+        nodes[nodeIndex].left = left;
+        nodes[nodeIndex].right = right;
+
+        return nodeIndex;
+    }
+
+    struct LessCenter
+    {
+        LessCenter(const std::vector<osg::Vec3>& centers, int axis): _centers(centers), _axis(axis) {}
+
+        bool operator() (unsigned int lhs, unsigned int rhs) const { return _centers[lhs][_axis]<_centers[rhs][_axis]; }
+
+        const std::vector<osg::Vec3>&   _centers;
+        int                             _axis;
+    };
+
+    struct BuildSubtrees : public osg::ParallelForFunctor
+    {
+        BuildSubtrees(BuildBoundingVolumeHierarchy& builder, Subtrees& subtrees):
+            _builder(builder),
+            _subtrees(subtrees) {}
+
+        virtual void operator() (unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i=begin; i<end; ++i)
+            {
+                Subtree& subtree = _subtrees[i];
+                _builder.divide(subtree.nodes, subtree.begin, subtree.end, 0, 0);
+            }
+        }
+
+        BuildBoundingVolumeHierarchy&   _builder;
+        Subtrees&                       _subtrees;
+    };
+
+    /** Create the scene graph for a node, collapsing the binary hierarchy so each group gets up to _maxLeafSize children.*/
+    osg::Node* createNode(const BVHNode& node, osg::Group& group)
+    {
+        if (node.isLeaf())
+        {
+            if (node.end-node.begin==1) return group.getChild(_indices[node.begin]);
+
+            osg::Group* leaf = new osg::Group;
+            for(unsigned int i=node.begin; i<node.end; ++i)
+            {
+                leaf->addChild(group.getChild(_indices[i]));
+            }
+            return leaf;
+        }
+
+        osg::Group* newGroup = new osg::Group;
+        std::vector<osg::Node*> children;
+        collapse(node, children, group);
+        for(std::vector<osg::Node*>::iterator itr = children.begin();
+            itr != children.end();
+            ++itr)
+        {
+            newGroup->addChild(*itr);
+        }
+        return newGroup;
+    }
+
+    void collapse(const BVHNode& node, std::vector<osg::Node*>& children, osg::Group& group)
+    {
+        // repeatedly open up the largest internal node until the branching factor is reached
+        std::vector<const BVHNode*> nodes;
+        nodes.push_back(&_nodes[node.left]);
+        nodes.push_back(&_nodes[node.right]);
+        while(nodes.size()<_maxLeafSize)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for(unsigned int i=0; i<nodes.size(); ++i)
+            {
+                if (nodes[i]->isLeaf()) continue;
+
+                float area = osg::surfaceArea(nodes[i]->bb);
+                if (area>largestArea)
+                {
+                    largestArea = area;
+                    largest = i;
+                }
+            }
+            if (largest<0) break;
+
+            const BVHNode* opened = nodes[largest];
+            nodes[largest] = &_nodes[opened->left];
+            nodes.push_back(&_nodes[opened->right]);
+        }
+
+        for(unsigned int i=0; i<nodes.size(); ++i)
+        {
+            children.push_back(createNode(*nodes[i], group));
+        }
+    }
+
+    unsigned int                _maxLeafSize;
+    std::vector<osg::BoundingBox> _bounds;
+    std::vector<osg::Vec3>      _centers;
+    std::vector<unsigned int>   _indices;
+    BVHNodes                    _nodes;
+};
+
+}
+
+bool Optimizer::SpatializeGroupsVisitor::divideBoundingVolumeHierarchy(osg::Group* group, unsigned int maxNumTreesPerCell)
+{
+    if (group->getNumChildren()<=maxNumTreesPerCell || maxNumTreesPerCell<2) return false;
+
+    BuildBoundingVolumeHierarchy builder(maxNumTreesPerCell);
+
+    // children without a valid bound are kept directly under the group
+    typedef std::vector< osg::ref_ptr<osg::Node> > NodeList;
+    NodeList unassignedList;
+
+    builder._bounds.resize(group->getNumChildren());
+    builder._centers.resize(group->getNumChildren());
+    for(unsigned int i=0;i<group->getNumChildren();++i)
+    {
+        osg::Node* child = group->getChild(i);
+        osg::BoundingBox bb;
+        if (child->asDrawable()) bb = child->asDrawable()->getBoundingBox();
+        else if (child->asGeode()) bb = child->asGeode()->getBoundingBox();
+        else if (child->getBound().valid())
+        {
+            const osg::BoundingSphere& bs = child->getBound();
+            bb.expandBy(bs);
+        }
+
+        if (!bb.valid())
+        {
+            unassignedList.push_back(child);
+            continue;
+        }
+
+        builder._bounds[i] = bb;
+        builder._centers[i] = bb.center();
+        builder._indices.push_back(i);
+    }
+
+    if (builder._indices.size()<=maxNumTreesPerCell) return false;
+
+    OSG_INFO<<"Building bounding volume hierarchy for "<<group->className()<<"  num children = "<<group->getNumChildren()<<std::endl;
+
+    builder.build();
+
+    // create the new hierarchy before removing the children, so that none of them loses its last reference
+    std::vector< osg::ref_ptr<osg::Node> > children;
+    const BuildBoundingVolumeHierarchy::BVHNode& root = builder._nodes[0];
+    if (root.isLeaf()) return false;
+
+    std::vector<osg::Node*> rootChildren;
+    builder.collapse(root, rootChildren, *group);
+    children.insert(children.end(), rootChildren.begin(), rootChildren.end());
+
+    unsigned int numChildrenOnEntry = group->getNumChildren();
+
+    group->removeChildren(0,group->getNumChildren());
+
+    for(std::vector< osg::ref_ptr<osg::Node> >::iterator itr = children.begin();
+        itr != children.end();
+        ++itr)
+    {
+        group->addChild(itr->get());
+    }
+
+    for(NodeList::iterator nitr=unassignedList.begin();
+        nitr!=unassignedList.end();
+        ++nitr)
+    {
+        group->addChild(nitr->get());
+    }
+
+    return (numChildrenOnEntry!=group->getNumChildren());
+}
+
 bool Optimizer::SpatializeGroupsVisitor::divide(osg::Geode* geode, unsigned int maxNumTreesPerCell)
 {
 
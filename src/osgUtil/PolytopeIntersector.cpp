@@ -409,6 +409,11 @@ struct IntersectFunctor
         }
     }
 
+    void intersect(const osg::Vec3Array* vertices, const osg::KdTree::Triangle& triangle)
+    {
+        intersect(vertices, triangle.originalIndex, triangle.p0, triangle.p1, triangle.p2);
+    }
+
     void intersect(const osg::Vec3Array* vertices, int primitiveIndex, unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
     {
         if (_settings->_limitOneIntersection && _hit) return;
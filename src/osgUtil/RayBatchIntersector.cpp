@@ -0,0 +1,526 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+
+#include <osgUtil/RayBatchIntersector>
+#include <osgUtil/LineSegmentIntersector>
+#include <osg/Geometry>
+#include <osg/KdTree>
+#include <osg/TemplatePrimitiveFunctor>
+
+#include <float.h>
+#include <math.h>
+
+using namespace osgUtil;
+
+namespace RayBatchIntersectorUtils
+{
+
+const unsigned int PacketSize = 8;
+
+/** Rays stored as structure of arrays so that each lane of a packet can be processed by the same instructions.*/
+struct RayPacket
+{
+    RayPacket(): numRays(0) {}
+
+    void addRay(const osg::Vec3d& s, const osg::Vec3d& e, float maxRatio, unsigned int ray)
+    {
+        unsigned int i = numRays++;
+        osg::Vec3d d = e-s;
+        ox[i] = s.x(); oy[i] = s.y(); oz[i] = s.z();
+        dx[i] = d.x(); dy[i] = d.y(); dz[i] = d.z();
+        idx[i] = d.x()!=0.0 ? 1.0f/dx[i] : FLT_MAX;
+        idy[i] = d.y()!=0.0 ? 1.0f/dy[i] : FLT_MAX;
+        idz[i] = d.z()!=0.0 ? 1.0f/dz[i] : FLT_MAX;
+        tmax[i] = maxRatio;
+        rays[i] = ray;
+    }
+
+    void finish()
+    {
+        // pad the unused lanes with rays that can never hit anything
+        for(unsigned int i=numRays; i<PacketSize; ++i)
+        {
+            ox[i] = oy[i] = oz[i] = 0.0f;
+            dx[i] = dy[i] = dz[i] = 0.0f;
+            idx[i] = idy[i] = idz[i] = FLT_MAX;
+            tmax[i] = -1.0f;
+            rays[i] = 0;
+        }
+    }
+
+    inline unsigned int fullMask() const { return (1u<<numRays)-1u; }
+
+    float ox[PacketSize], oy[PacketSize], oz[PacketSize];
+    float dx[PacketSize], dy[PacketSize], dz[PacketSize];
+    float idx[PacketSize], idy[PacketSize], idz[PacketSize];
+    float tmax[PacketSize];
+    unsigned int rays[PacketSize];
+    unsigned int numRays;
+};
+
+typedef std::vector<RayPacket> RayPackets;
+
+/** Slab test of all the rays of a packet against a bounding box, returning the mask of the rays that hit it.*/
+inline unsigned int intersectBox(const RayPacket& packet, const osg::BoundingBox& bb)
+{
+    float hit[PacketSize];
+    for(unsigned int i=0; i<PacketSize; ++i)
+    {
+        float tx0 = (bb._min.x()-packet.ox[i])*packet.idx[i];
+        float tx1 = (bb._max.x()-packet.ox[i])*packet.idx[i];
+        float ty0 = (bb._min.y()-packet.oy[i])*packet.idy[i];
+        float ty1 = (bb._max.y()-packet.oy[i])*packet.idy[i];
+        float tz0 = (bb._min.z()-packet.oz[i])*packet.idz[i];
+        float tz1 = (bb._max.z()-packet.oz[i])*packet.idz[i];
+
+        float tnear = std::max(std::max(std::min(tx0,tx1), std::min(ty0,ty1)), std::max(std::min(tz0,tz1), 0.0f));
+        float tfar = std::min(std::min(std::max(tx0,tx1), std::max(ty0,ty1)), std::min(std::max(tz0,tz1), packet.tmax[i]));
+        hit[i] = tfar-tnear;
+    }
+
+    unsigned int mask = 0;
+    for(unsigned int i=0; i<PacketSize; ++i)
+    {
+        if (hit[i]>=0.0f) mask |= (1u<<i);
+    }
+    return mask;
+}
+
+/** Functor that intersects packets of rays with the triangles passed to it, either by a KdTree or by a TemplatePrimitiveFunctor.*/
+struct PacketIntersectFunctor
+{
+    PacketIntersectFunctor():
+        _intersector(0),
+        _iv(0),
+        _drawable(0),
+        _packets(0),
+        _packet(0),
+        _limitOneIntersection(false),
+        _primitiveIndex(0) {}
+
+    void set(RayBatchIntersector* intersector, IntersectionVisitor* iv, osg::Drawable* drawable, RayPackets* packets, bool limitOneIntersection)
+    {
+        _intersector = intersector;
+        _iv = iv;
+        _drawable = drawable;
+        _packets = packets;
+        _limitOneIntersection = limitOneIntersection;
+
+        osg::Geometry* geometry = drawable->asGeometry();
+        _vertices = geometry ? dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray()) : 0;
+
+        _masks.resize(packets->size());
+        for(unsigned int i=0; i<packets->size(); ++i)
+        {
+            _masks[i] = (*packets)[i].fullMask();
+        }
+    }
+
+    /** Restrict the intersections to the single packet specified, as required by the KdTree traversal.*/
+    void setPacket(unsigned int packet)
+    {
+        _packet = packet;
+        _maskStack.clear();
+        _maskStack.push_back(_masks[packet]);
+    }
+
+    bool enter(const osg::BoundingBox& bb)
+    {
+        unsigned int mask = _maskStack.back() & intersectBox((*_packets)[_packet], bb);
+        if (mask==0) return false;
+
+        _maskStack.push_back(mask);
+        return true;
+    }
+
+    void leave()
+    {
+        _maskStack.pop_back();
+    }
+
+    void intersect(const osg::Vec3& v0, const osg::Vec3& e1, const osg::Vec3& e2, const osg::Vec3* p0, const osg::Vec3* p1, const osg::Vec3* p2,
+                   RayPacket& packet, unsigned int& activeMask)
+    {
+        float hit[PacketSize], t[PacketSize], u[PacketSize], v[PacketSize];
+        for(unsigned int i=0; i<PacketSize; ++i)
+        {
+            // Moller-Trumbore with the triangle edges shared by all the rays of the packet
+            float px = packet.dy[i]*e2.z()-packet.dz[i]*e2.y();
+            float py = packet.dz[i]*e2.x()-packet.dx[i]*e2.z();
+            float pz = packet.dx[i]*e2.y()-packet.dy[i]*e2.x();
+            float det = px*e1.x()+py*e1.y()+pz*e1.z();
+            float inv_det = det!=0.0f ? 1.0f/det : 0.0f;
+
+            float sx = packet.ox[i]-v0.x();
+            float sy = packet.oy[i]-v0.y();
+            float sz = packet.oz[i]-v0.z();
+
+            float qx = sy*e1.z()-sz*e1.y();
+            float qy = sz*e1.x()-sx*e1.z();
+            float qz = sx*e1.y()-sy*e1.x();
+
+            u[i] = (sx*px+sy*py+sz*pz)*inv_det;
+            v[i] = (packet.dx[i]*qx+packet.dy[i]*qy+packet.dz[i]*qz)*inv_det;
+            t[i] = (e2.x()*qx+e2.y()*qy+e2.z()*qz)*inv_det;
+
+            hit[i] = std::min(std::min(u[i], v[i]), std::min(1.0f-u[i]-v[i], std::min(t[i], packet.tmax[i]-t[i])));
+            if (det==0.0f) hit[i] = -1.0f;
+        }
+
+        for(unsigned int i=0; i<PacketSize; ++i)
+        {
+            if ((activeMask & (1u<<i))==0 || hit[i]<0.0f) continue;
+
+            unsigned int ray = packet.rays[i];
+            const RayBatchIntersector::Ray& r = _intersector->getRays()[ray];
+
+            RayBatchIntersector::Intersection intersection;
+            intersection.ratio = t[i];
+            intersection.matrix = _iv->getModelMatrix();
+            intersection.nodePath = _iv->getNodePath();
+            intersection.drawable = _drawable;
+            intersection.primitiveIndex = _primitiveIndex;
+            intersection.localIntersectionPoint = r.start + (r.end-r.start)*t[i];
+            intersection.localIntersectionNormal = e1^e2;
+            intersection.localIntersectionNormal.normalize();
+            intersection.ratios[0] = 1.0f-u[i]-v[i];
+            intersection.ratios[1] = u[i];
+            intersection.ratios[2] = v[i];
+
+            if (_vertices.valid())
+            {
+                const osg::Vec3* first = &(_vertices->front());
+                intersection.indices[0] = p0-first;
+                intersection.indices[1] = p1-first;
+                intersection.indices[2] = p2-first;
+            }
+
+            _intersector->insertIntersection(ray, intersection);
+
+            // later hits of this ray now have to be nearer, or aren't required at all
+            packet.tmax[i] = t[i];
+            if (_limitOneIntersection)
+            {
+                packet.tmax[i] = -1.0f;
+                activeMask &= ~(1u<<i);
+            }
+        }
+    }
+
+    // the triangle given by its first vertex and the edges from it to the other two, the vertex pointers only being
+    // used to compute the indices of the vertices of a hit.
+    void intersect(const osg::Vec3& v0, const osg::Vec3& e1, const osg::Vec3& e2, const osg::Vec3* p0, const osg::Vec3* p1, const osg::Vec3* p2)
+    {
+        if (_maskStack.empty())
+        {
+            // test the triangle against every packet
+            for(unsigned int i=0; i<_packets->size(); ++i)
+            {
+                if (_masks[i]!=0) intersect(v0, e1, e2, p0, p1, p2, (*_packets)[i], _masks[i]);
+            }
+        }
+        else
+        {
+            // rays retired by LIMIT_ONE have their tmax set negative, so the parent KdTree nodes' masks needn't be updated
+            unsigned int& mask = _maskStack.back();
+            if (mask!=0) intersect(v0, e1, e2, p0, p1, p2, (*_packets)[_packet], mask);
+        }
+    }
+
+    void intersect(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2)
+    {
+        intersect(v0, v1-v0, v2-v0, &v0, &v1, &v2);
+    }
+
+    // handle points and lines
+    void operator()(const osg::Vec3&, bool /*treatVertexDataAsTemporary*/)
+    {
+        ++_primitiveIndex;
+    }
+
+    void operator()(const osg::Vec3&, const osg::Vec3&, bool /*treatVertexDataAsTemporary*/)
+    {
+        ++_primitiveIndex;
+    }
+
+    // handle triangles
+    void operator()(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2, bool /*treatVertexDataAsTemporary*/)
+    {
+        intersect(v0,v1,v2);
+        ++_primitiveIndex;
+    }
+
+    void operator()(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool /*treatVertexDataAsTemporary*/)
+    {
+        intersect(v0,v1,v3);
+        intersect(v1,v2,v3);
+        ++_primitiveIndex;
+    }
+
+    void intersect(const osg::Vec3Array*, int , unsigned int)
+    {
+    }
+
+    void intersect(const osg::Vec3Array*, int, unsigned int, unsigned int)
+    {
+    }
+
+    void intersect(const osg::Vec3Array* vertices, int primitiveIndex, unsigned int p0, unsigned int p1, unsigned int p2)
+    {
+        _primitiveIndex = primitiveIndex;
+
+        intersect((*vertices)[p0], (*vertices)[p1], (*vertices)[p2]);
+    }
+
+    void intersect(const osg::Vec3Array* vertices, const osg::KdTree::Triangle& triangle)
+    {
+        _primitiveIndex = triangle.originalIndex;
+
+        const osg::Vec3* first = &(vertices->front());
+        intersect(triangle.v0, triangle.e1, triangle.e2, first+triangle.p0, first+triangle.p1, first+triangle.p2);
+    }
+
+    void intersect(const osg::Vec3Array* vertices, int primitiveIndex, unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        _primitiveIndex = primitiveIndex;
+
+        intersect((*vertices)[p0], (*vertices)[p1], (*vertices)[p3]);
+        intersect((*vertices)[p1], (*vertices)[p2], (*vertices)[p3]);
+    }
+
+    typedef std::vector<unsigned int> Masks;
+
+    RayBatchIntersector*            _intersector;
+    IntersectionVisitor*            _iv;
+    osg::Drawable*                  _drawable;
+    osg::ref_ptr<osg::Vec3Array>    _vertices;
+    RayPackets*                     _packets;
+    unsigned int                    _packet;
+    Masks                           _masks;
+    Masks                           _maskStack;
+    bool                            _limitOneIntersection;
+    unsigned int                    _primitiveIndex;
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  RayBatchIntersector
+//
+
+RayBatchIntersector::RayBatchIntersector(CoordinateFrame cf, IntersectionLimit intersectionLimit):
+    Intersector(cf, intersectionLimit),
+    _parent(0),
+    _numHits(0)
+{
+}
+
+unsigned int RayBatchIntersector::addRay(const osg::Vec3d& start, const osg::Vec3d& end)
+{
+    unsigned int index = static_cast<unsigned int>(_rays.size());
+    _rays.push_back(Ray(start, end));
+    _allRays.push_back(index);
+    _intersections.push_back(Intersection());
+    return index;
+}
+
+void RayBatchIntersector::setRays(const Rays& rays)
+{
+    _rays = rays;
+
+    _allRays.resize(_rays.size());
+    for(unsigned int i=0; i<_allRays.size(); ++i) _allRays[i] = i;
+
+    reset();
+}
+
+Intersector* RayBatchIntersector::clone(osgUtil::IntersectionVisitor& iv)
+{
+    osg::ref_ptr<RayBatchIntersector> rbi = new RayBatchIntersector(MODEL, _intersectionLimit);
+    rbi->_parent = this;
+
+    // only the rays that reached the point of the traversal where the clone is required need to be transformed
+    const RayBatchIntersector* owner = _activeStack.empty() ? this : _activeStack.back().owner;
+    const Indices& active = _activeStack.empty() ? _allRays : _activeStack.back().indices;
+
+    bool transform = !(_coordinateFrame==MODEL && iv.getModelMatrix()==0);
+    osg::Matrix matrix;
+    if (transform) matrix = LineSegmentIntersector::getTransformation(iv, _coordinateFrame);
+
+    rbi->_rays.reserve(active.size());
+    rbi->_rayIndices.reserve(active.size());
+    rbi->_allRays.reserve(active.size());
+    for(Indices::const_iterator itr = active.begin();
+        itr != active.end();
+        ++itr)
+    {
+        unsigned int rootIndex = owner->getRootIndex(*itr);
+        const Ray& ray = _rays[rootIndex];
+
+        rbi->_allRays.push_back(static_cast<unsigned int>(rbi->_rays.size()));
+        rbi->_rays.push_back(transform ? Ray(ray.start * matrix, ray.end * matrix) : ray);
+        rbi->_rayIndices.push_back(rootIndex);
+    }
+
+    return rbi.release();
+}
+
+const RayBatchIntersector::Indices& RayBatchIntersector::getActiveRays() const
+{
+    const RayBatchIntersector* root = _parent ? _parent : this;
+    if (!root->_activeStack.empty() && root->_activeStack.back().owner==this) return root->_activeStack.back().indices;
+    return _allRays;
+}
+
+double RayBatchIntersector::getMaxRatio(unsigned int ray) const
+{
+    const Intersection& intersection = getIntersections()[getRootIndex(ray)];
+    if (!intersection.valid()) return 1.0;
+    return (_intersectionLimit==LIMIT_ONE || _intersectionLimit==LIMIT_ONE_PER_DRAWABLE) ? -1.0 : intersection.ratio;
+}
+
+bool RayBatchIntersector::enter(const osg::Node& node)
+{
+    const Indices& active = getActiveRays();
+
+    ActiveRays activeRays;
+    activeRays.owner = this;
+    activeRays.indices.reserve(active.size());
+
+    const osg::BoundingSphere& bs = node.getBound();
+    bool testBound = node.isCullingActive() && bs.valid();
+
+    for(Indices::const_iterator itr = active.begin();
+        itr != active.end();
+        ++itr)
+    {
+        double maxRatio = getMaxRatio(*itr);
+        if (maxRatio<0.0) continue;
+
+        if (testBound)
+        {
+            const Ray& ray = _rays[*itr];
+
+            osg::Vec3d sm = ray.start - bs._center;
+            double c = sm.length2()-bs._radius*bs._radius;
+            if (c>=0.0)
+            {
+                osg::Vec3d se = ray.end-ray.start;
+                double a = se.length2();
+                double b = (sm*se)*2.0;
+                double d = b*b-4.0*a*c;
+
+                if (d<0.0 || a==0.0) continue;
+
+                d = sqrt(d);
+                double div = 1.0/(2.0*a);
+                double r1 = (-b-d)*div;
+                double r2 = (-b+d)*div;
+
+                if (r1<=0.0 && r2<=0.0) continue;
+                if (r1>=maxRatio && r2>=maxRatio) continue;
+            }
+        }
+
+        activeRays.indices.push_back(*itr);
+    }
+
+    if (activeRays.indices.empty()) return false;
+
+    RayBatchIntersector* root = _parent ? _parent : this;
+    root->_activeStack.push_back(ActiveRays());
+    root->_activeStack.back().owner = this;
+    root->_activeStack.back().indices.swap(activeRays.indices);
+
+    return true;
+}
+
+void RayBatchIntersector::leave()
+{
+    RayBatchIntersector* root = _parent ? _parent : this;
+    root->_activeStack.pop_back();
+}
+
+void RayBatchIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
+{
+    using namespace RayBatchIntersectorUtils;
+
+    const osg::BoundingBox& bb = drawable->getBoundingBox();
+    bool testBound = drawable->isCullingActive() && bb.valid();
+
+    // gather the active rays into packets, keeping those that hit the drawable's bounding box
+    RayPackets packets;
+    RayPacket packet;
+    const Indices& active = getActiveRays();
+    for(unsigned int i=0; i<=active.size(); ++i)
+    {
+        if (packet.numRays==PacketSize || (i==active.size() && packet.numRays>0))
+        {
+            packet.finish();
+            if (!testBound || RayBatchIntersectorUtils::intersectBox(packet, bb)!=0) packets.push_back(packet);
+            packet.numRays = 0;
+        }
+
+        if (i==active.size()) break;
+
+        double maxRatio = getMaxRatio(active[i]);
+        if (maxRatio<0.0) continue;
+
+        const Ray& ray = _rays[active[i]];
+        packet.addRay(ray.start, ray.end, static_cast<float>(maxRatio), active[i]);
+    }
+
+    if (packets.empty()) return;
+
+    if (iv.getDoDummyTraversal()) return;
+
+    osg::TemplatePrimitiveFunctor<PacketIntersectFunctor> intersector;
+    intersector.set(this, &iv, drawable, &packets, _intersectionLimit==LIMIT_ONE || _intersectionLimit==LIMIT_ONE_PER_DRAWABLE);
+
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
+    if (kdTree && !kdTree->getNodes().empty())
+    {
+        // traverse the KdTree once per packet, each node being tested against all the rays of the packet
+        for(unsigned int i=0; i<packets.size(); ++i)
+        {
+            intersector.setPacket(i);
+            kdTree->intersect(intersector, kdTree->getNode(0));
+        }
+    }
+    else
+    {
+        drawable->accept(intersector);
+    }
+}
+
+void RayBatchIntersector::insertIntersection(unsigned int ray, const Intersection& intersection)
+{
+    RayBatchIntersector* root = _parent ? _parent : this;
+    Intersection& current = root->_intersections[getRootIndex(ray)];
+    if (current.valid() && current.ratio<=intersection.ratio) return;
+
+    if (!current.valid()) ++root->_numHits;
+    current = intersection;
+}
+
+void RayBatchIntersector::reset()
+{
+    Intersector::reset();
+
+    _activeStack.clear();
+    _intersections.clear();
+    _intersections.resize(_rays.size());
+    _numHits = 0;
+}
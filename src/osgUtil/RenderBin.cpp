@@ -113,7 +113,7 @@ void RenderBin::removeRenderBinPrototype(RenderBin* proto)
 
 static bool s_defaultBinSortModeInitialized = false;
 static RenderBin::SortMode s_defaultBinSortMode = RenderBin::SORT_BY_STATE;
-static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT");
+static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT | TRAVERSAL_ORDER | SORT_BY_STATE_KEY");
 
 void RenderBin::setDefaultRenderBinSortMode(RenderBin::SortMode mode)
 {
@@ -136,6 +136,7 @@ RenderBin::SortMode RenderBin::getDefaultRenderBinSortMode()
             else if (strcmp(str,"SORT_FRONT_TO_BACK")==0) s_defaultBinSortMode = RenderBin::SORT_FRONT_TO_BACK;
             else if (strcmp(str,"SORT_BACK_TO_FRONT")==0) s_defaultBinSortMode = RenderBin::SORT_BACK_TO_FRONT;
             else if (strcmp(str,"TRAVERSAL_ORDER")==0) s_defaultBinSortMode = RenderBin::TRAVERSAL_ORDER;
+            else if (strcmp(str,"SORT_BY_STATE_KEY")==0) s_defaultBinSortMode = RenderBin::SORT_BY_STATE_KEY;
         }
     }
 
@@ -180,6 +181,7 @@ RenderBin::RenderBin(SortMode mode)
 RenderBin::RenderBin(const RenderBin& rhs,const CopyOp& copyop):
         Object(rhs,copyop),
         _binNum(rhs._binNum),
+        _binName(rhs._binName),
         _parent(rhs._parent),
         _stage(rhs._stage),
         _bins(rhs._bins),
@@ -202,6 +204,8 @@ void RenderBin::reset()
 {
     _stateGraphList.clear();
     _renderLeafList.clear();
+    _keyedRenderLeafList.clear();
+    _keyedRenderLeafBuffer.clear();
     _bins.clear();
     _sorted = false;
 }
@@ -250,6 +254,9 @@ void RenderBin::sortImplementation()
         case(TRAVERSAL_ORDER):
             sortTraversalOrder();
             break;
+        case(SORT_BY_STATE_KEY):
+            sortByStateKey();
+            break;
     }
 }
 
@@ -292,58 +299,188 @@ void RenderBin::sortByStateThenFrontToBack()
     std::sort(_stateGraphList.begin(),_stateGraphList.end(),StateGraphFrontToBackSortFunctor());
 }
 
-struct FrontToBackSortFunctor
+void RenderBin::sortFrontToBack()
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
-    {
-        return (lhs->_depth<rhs->_depth);
-    }
-};
+    sortLeavesByKey(SORT_FRONT_TO_BACK);
+}
 
+void RenderBin::sortBackToFront()
+{
+    sortLeavesByKey(SORT_BACK_TO_FRONT);
+}
 
-void RenderBin::sortFrontToBack()
+void RenderBin::sortTraversalOrder()
+{
+    sortLeavesByKey(TRAVERSAL_ORDER);
+}
+
+void RenderBin::sortByStateKey()
+{
+    sortLeavesByKey(SORT_BY_STATE_KEY);
+}
+
+namespace
 {
-    copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
+// map the float bit pattern onto an unsigned integer with the same ordering.
+inline uint32_t sortableDepth(float depth)
+{
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
 
-//    cout << "sort front to back"<<endl;
+inline uint64_t hashPointer16(const void* ptr)
+{
+    if (!ptr) return 0;
+    uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)) * 0x9E3779B97F4A7C15ull;
+    return (value >> 48) | 1;
 }
 
-struct BackToFrontSortFunctor
+// The key of the state of a StateGraph, the Program in the top 16 bits and the texture on unit 0 in the next 16,
+// both taken from the StateSet nearest to the leaves.
+uint64_t computeStateKey(const StateGraph* sg)
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    const osg::StateAttribute* program = 0;
+    const osg::StateAttribute* texture = 0;
+    for(; sg && !(program && texture); sg = sg->_parent)
     {
-        return (rhs->_depth<lhs->_depth);
+        const osg::StateSet* stateset = sg->getStateSet();
+        if (!stateset) continue;
+
+        if (!program) program = stateset->getAttribute(osg::StateAttribute::PROGRAM);
+        if (!texture) texture = stateset->getTextureAttribute(0, osg::StateAttribute::TEXTURE);
     }
-};
+    return (hashPointer16(program) << 48) | (hashPointer16(texture) << 32);
+}
 
-void RenderBin::sortBackToFront()
+// Least significant digit radix sort, 8 bits per pass, skipping the passes over digits all the keys share.
+// Stable, so leaves with equal keys keep the order they were collected in.
+void radixSort(RenderBin::KeyedRenderLeafList& list, RenderBin::KeyedRenderLeafList& buffer, unsigned int numBytes)
 {
-    copyLeavesFromStateGraphListToRenderLeafList();
+    if (list.size()<64)
+    {
+        std::stable_sort(list.begin(), list.end());
+        return;
+    }
+
+    buffer.resize(list.size());
+
+    std::vector<unsigned int> counts(numBytes*256, 0);
+    for(RenderBin::KeyedRenderLeafList::const_iterator itr = list.begin();
+        itr != list.end();
+        ++itr)
+    {
+        for(unsigned int b=0; b<numBytes; ++b) ++counts[b*256 + ((itr->key >> (b*8)) & 0xff)];
+    }
+
+    RenderBin::KeyedRenderLeaf* src = &list.front();
+    RenderBin::KeyedRenderLeaf* dst = &buffer.front();
+    unsigned int size = static_cast<unsigned int>(list.size());
+    for(unsigned int b=0; b<numBytes; ++b)
+    {
+        unsigned int* count = &counts[b*256];
+        unsigned int shift = b*8;
+        if (count[(src->key >> shift) & 0xff]==size) continue;
+
+        unsigned int offset = 0;
+        for(unsigned int d=0; d<256; ++d)
+        {
+            unsigned int c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
+        for(unsigned int i=0; i<size; ++i)
+        {
+            dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
 
-//    cout << "sort back to front"<<endl;
+    if (src!=&list.front()) list.swap(buffer);
 }
 
+}
 
-struct TraversalOrderFunctor
+void RenderBin::sortLeavesByKey(SortMode mode)
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    _keyedRenderLeafList.clear();
+
+    float minDepth = FLT_MAX;
+    float maxDepth = -FLT_MAX;
+    bool detectedNaN = false;
+
+    for(StateGraphList::iterator itr=_stateGraphList.begin();
+        itr!=_stateGraphList.end();
+        ++itr)
     {
-        return (lhs->_traversalOrderNumber<rhs->_traversalOrderNumber);
+        for(StateGraph::LeafList::iterator dw_itr = (*itr)->_leaves.begin();
+            dw_itr != (*itr)->_leaves.end();
+            ++dw_itr)
+        {
+            RenderLeaf* rl = dw_itr->get();
+            if (osg::isNaN(rl->_depth))
+            {
+                detectedNaN = true;
+                continue;
+            }
+
+            switch(mode)
+            {
+                case(SORT_FRONT_TO_BACK): _keyedRenderLeafList.push_back(KeyedRenderLeaf(sortableDepth(rl->_depth), rl)); break;
+                case(SORT_BACK_TO_FRONT): _keyedRenderLeafList.push_back(KeyedRenderLeaf(~sortableDepth(rl->_depth), rl)); break;
+                case(SORT_BY_STATE_KEY):
+                    if (rl->_depth<minDepth) minDepth = rl->_depth;
+                    if (rl->_depth>maxDepth) maxDepth = rl->_depth;
+                    _keyedRenderLeafList.push_back(KeyedRenderLeaf(0, rl));
+                    break;
+                default: _keyedRenderLeafList.push_back(KeyedRenderLeaf(rl->_traversalOrderNumber, rl)); break;
+            }
+        }
     }
-};
 
-void RenderBin::sortTraversalOrder()
-{
-    copyLeavesFromStateGraphListToRenderLeafList();
+    if (detectedNaN) OSG_NOTICE<<"Warning: RenderBin::sortLeavesByKey() detected NaN depth values, database may be corrupted."<<std::endl;
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+    unsigned int numBytes = 4;
+    if (mode==SORT_BY_STATE_KEY)
+    {
+        numBytes = 8;
+
+        // the StateGraph index occupies bits 16 to 31 and the depth, quantized over the range of the bin, bits 0 to 15.
+        float depthScale = (maxDepth>minDepth) ? 65535.0f/(maxDepth-minDepth) : 0.0f;
+        uint64_t stateGraphIndex = 0;
+        const StateGraph* previous = 0;
+        uint64_t stateKey = 0;
+        for(KeyedRenderLeafList::iterator itr = _keyedRenderLeafList.begin();
+            itr != _keyedRenderLeafList.end();
+            ++itr)
+        {
+            const StateGraph* sg = itr->leaf->_parent;
+            if (sg!=previous)
+            {
+                if (previous && stateGraphIndex<0xffff) ++stateGraphIndex;
+                stateKey = computeStateKey(sg) | (stateGraphIndex << 16);
+                previous = sg;
+            }
+            itr->key = stateKey | static_cast<uint64_t>((itr->leaf->_depth-minDepth)*depthScale);
+        }
+    }
+
+    radixSort(_keyedRenderLeafList, _keyedRenderLeafBuffer, numBytes);
+
+    _renderLeafList.clear();
+    _renderLeafList.reserve(_keyedRenderLeafList.size());
+    for(KeyedRenderLeafList::iterator itr = _keyedRenderLeafList.begin();
+        itr != _keyedRenderLeafList.end();
+        ++itr)
+    {
+        _renderLeafList.push_back(itr->leaf);
+    }
+
+    // empty the render graph list to prevent it being drawn along side the render leaf list (see drawImplementation.)
+    _stateGraphList.clear();
 }
 
 void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
@@ -411,6 +548,7 @@ RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
         else
         {
             rb->_binNum = binNum;
+            rb->_binName = binName;
             rb->_parent = this;
             rb->_stage = _stage;
             _bins[binNum] = rb;
@@ -210,6 +210,33 @@ void RenderStage::addPostRenderStage(RenderStage* rs, int order)
     }
 }
 
+void RenderStage::moveRenderStages(RenderStage& rhs)
+{
+    // stages that inherited the positional state of rhs now inherit this stage's instead.
+    PositionalStateContainer* rhsPositionalState = rhs._renderStageLighting.get();
+
+    for(RenderStageList::iterator itr = rhs._preRenderList.begin(); itr != rhs._preRenderList.end(); ++itr)
+    {
+        if (rhsPositionalState && itr->second->getInheritedPositionalStateContainer()==rhsPositionalState)
+        {
+            itr->second->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        }
+        addPreRenderStage(itr->second.get(), itr->first);
+    }
+
+    for(RenderStageList::iterator itr = rhs._postRenderList.begin(); itr != rhs._postRenderList.end(); ++itr)
+    {
+        if (rhsPositionalState && itr->second->getInheritedPositionalStateContainer()==rhsPositionalState)
+        {
+            itr->second->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        }
+        addPostRenderStage(itr->second.get(), itr->first);
+    }
+
+    rhs._preRenderList.clear();
+    rhs._postRenderList.clear();
+}
+
 void RenderStage::drawPreRenderStages(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     if (_preRenderList.empty()) return;
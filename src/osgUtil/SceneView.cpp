@@ -15,6 +15,7 @@
 #include <osgUtil/GLObjectsVisitor>
 
 #include <osg/Timer>
+#include <osg/Trace>
 #include <osg/GLExtensions>
 #include <osg/GLObjects>
 #include <osg/Notify>
@@ -892,6 +893,7 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     // If the camera has a cullCallback execute the callback which has the
     // requirement that it must traverse the camera's children.
     {
+       OSG_TRACE_ZONE("CullVisitor::traverse");
        osg::Callback* callback = _camera->getCullCallback();
        if (callback) callback->run(_camera.get(), cullVisitor);
        else cullVisitor->traverse(*_camera);
@@ -906,8 +908,12 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     if (_secondaryStateSet.valid()) cullVisitor->popStateSet();
     if (_globalStateSet.valid()) cullVisitor->popStateSet();
 
+    cullVisitor->addDeferredRenderLeaves();
 
-    renderStage->sort();
+    {
+        OSG_TRACE_ZONE("RenderStage::sort");
+        renderStage->sort();
+    }
 
     // prune out any empty StateGraph children.
     // note, this would be not required if the rendergraph had been
@@ -26,6 +26,9 @@ void StateGraph::reset()
 
     _children.clear();
     _leaves.clear();
+
+    _lastFoundStateSet = NULL;
+    _lastFoundChild = NULL;
 }
 
 /** recursively clean the StateGraph of all its drawables, lights and depths.
@@ -57,6 +60,12 @@ void StateGraph::prune()
 
         if (citr->second->empty())
         {
+            if (citr->second.get()==_lastFoundChild)
+            {
+                _lastFoundStateSet = NULL;
+                _lastFoundChild = NULL;
+            }
+
             ChildList::iterator ditr= citr++;
             _children.erase(ditr);
         }
@@ -25,6 +25,16 @@
 
 using namespace osgViewer;
 
+static const osg::Stats::AttributeID s_frameDurationID = osg::Stats::registerAttribute("Frame duration");
+static const osg::Stats::AttributeID s_frameRateID = osg::Stats::registerAttribute("Frame rate");
+static const osg::Stats::AttributeID s_referenceTimeID = osg::Stats::registerAttribute("Reference time");
+static const osg::Stats::AttributeID s_eventTraversalBeginTimeID = osg::Stats::registerAttribute("Event traversal begin time");
+static const osg::Stats::AttributeID s_eventTraversalEndTimeID = osg::Stats::registerAttribute("Event traversal end time");
+static const osg::Stats::AttributeID s_eventTraversalTimeTakenID = osg::Stats::registerAttribute("Event traversal time taken");
+static const osg::Stats::AttributeID s_updateTraversalBeginTimeID = osg::Stats::registerAttribute("Update traversal begin time");
+static const osg::Stats::AttributeID s_updateTraversalEndTimeID = osg::Stats::registerAttribute("Update traversal end time");
+static const osg::Stats::AttributeID s_updateTraversalTimeTakenID = osg::Stats::registerAttribute("Update traversal time taken");
+
 CompositeViewer::CompositeViewer()
 {
     constructorInit();
@@ -694,11 +704,11 @@ void CompositeViewer::advance(double simulationTime)
     {
         // update previous frame stats
         double deltaFrameTime = _frameStamp->getReferenceTime() - previousReferenceTime;
-        getViewerStats()->setAttribute(previousFrameNumber, "Frame duration", deltaFrameTime);
-        getViewerStats()->setAttribute(previousFrameNumber, "Frame rate", 1.0/deltaFrameTime);
+        getViewerStats()->setAttribute(previousFrameNumber, s_frameDurationID, deltaFrameTime);
+        getViewerStats()->setAttribute(previousFrameNumber, s_frameRateID, 1.0/deltaFrameTime);
 
         // update current frames stats
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Reference time", _frameStamp->getReferenceTime());
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_referenceTimeID, _frameStamp->getReferenceTime());
     }
 
 }
@@ -1343,9 +1353,9 @@ void CompositeViewer::eventTraversal()
         double endEventTraversal = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
 
         // update current frames stats
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Event traversal begin time", beginEventTraversal);
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Event traversal end time", endEventTraversal);
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Event traversal time taken", endEventTraversal-beginEventTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_eventTraversalBeginTimeID, beginEventTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_eventTraversalEndTimeID, endEventTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_eventTraversalTimeTakenID, endEventTraversal-beginEventTraversal);
     }
 }
 
@@ -1445,9 +1455,9 @@ void CompositeViewer::updateTraversal()
         double endUpdateTraversal = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
 
         // update current frames stats
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
-        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_updateTraversalBeginTimeID, beginUpdateTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_updateTraversalEndTimeID, endUpdateTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), s_updateTraversalTimeTakenID, endUpdateTraversal-beginUpdateTraversal);
     }
 
 }
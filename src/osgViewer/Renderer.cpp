@@ -14,6 +14,7 @@
 #include <stdio.h>
 
 #include <osg/GLExtensions>
+#include <osg/Trace>
 #include <OpenThreads/ReentrantMutex>
 
 #include <osgUtil/Optimizer>
@@ -32,6 +33,17 @@
 
 using namespace osgViewer;
 
+// the timings are set from the cull and draw threads through registered attributes, avoiding the Stats mutex and string lookups.
+static const osg::Stats::AttributeID s_gpuDrawBeginTimeID = osg::Stats::registerAttribute("GPU draw begin time");
+static const osg::Stats::AttributeID s_gpuDrawEndTimeID = osg::Stats::registerAttribute("GPU draw end time");
+static const osg::Stats::AttributeID s_gpuDrawTimeTakenID = osg::Stats::registerAttribute("GPU draw time taken");
+static const osg::Stats::AttributeID s_cullTraversalBeginTimeID = osg::Stats::registerAttribute("Cull traversal begin time");
+static const osg::Stats::AttributeID s_cullTraversalEndTimeID = osg::Stats::registerAttribute("Cull traversal end time");
+static const osg::Stats::AttributeID s_cullTraversalTimeTakenID = osg::Stats::registerAttribute("Cull traversal time taken");
+static const osg::Stats::AttributeID s_drawTraversalBeginTimeID = osg::Stats::registerAttribute("Draw traversal begin time");
+static const osg::Stats::AttributeID s_drawTraversalEndTimeID = osg::Stats::registerAttribute("Draw traversal end time");
+static const osg::Stats::AttributeID s_drawTraversalTimeTakenID = osg::Stats::registerAttribute("Draw traversal time taken");
+
 //#define DEBUG_MESSAGE OSG_NOTICE
 #define DEBUG_MESSAGE OSG_DEBUG
 
@@ -85,9 +97,9 @@ void EXTQuerySupport::checkQuery(osg::Stats* stats, osg::State* /*state*/,
             double estimatedEndTime = (_previousQueryTime + currentTime) * 0.5;
             double estimatedBeginTime = estimatedEndTime - timeElapsedSeconds;
 
-            stats->setAttribute(itr->second, "GPU draw begin time", estimatedBeginTime);
-            stats->setAttribute(itr->second, "GPU draw end time", estimatedEndTime);
-            stats->setAttribute(itr->second, "GPU draw time taken", timeElapsedSeconds);
+            stats->setAttribute(itr->second, s_gpuDrawBeginTimeID, estimatedBeginTime);
+            stats->setAttribute(itr->second, s_gpuDrawEndTimeID, estimatedEndTime);
+            stats->setAttribute(itr->second, s_gpuDrawTimeTakenID, timeElapsedSeconds);
 
 
             itr = _queryFrameNumberList.erase(itr);
@@ -269,10 +281,10 @@ void ARBQuerySupport::checkQuery(osg::Stats* stats, osg::State* state,
             else
                 endTime = gpuTick
                     - double(gpuTimestamp - endTimestamp) * 1e-9;
-            stats->setAttribute(itr->frameNumber, "GPU draw begin time",
+            stats->setAttribute(itr->frameNumber, s_gpuDrawBeginTimeID,
                                 beginTime);
-            stats->setAttribute(itr->frameNumber, "GPU draw end time", endTime);
-            stats->setAttribute(itr->frameNumber, "GPU draw time taken",
+            stats->setAttribute(itr->frameNumber, s_gpuDrawEndTimeID, endTime);
+            stats->setAttribute(itr->frameNumber, s_gpuDrawTimeTakenID,
                                 timeElapsedSeconds);
             itr = _queryFrameList.erase(itr);
             _availableQueryObjects.push_back(queries);
@@ -577,6 +589,8 @@ void Renderer::compile()
 {
     DEBUG_MESSAGE<<"Renderer::compile()"<<std::endl;
 
+    OSG_TRACE_ZONE("Renderer::compile");
+
     _compileOnNextDraw = false;
 
     osgUtil::SceneView* sceneView = _sceneView[0].get();
@@ -643,6 +657,8 @@ void Renderer::cull()
 
     DEBUG_MESSAGE<<"cull() got SceneView "<<sceneView<<std::endl;
 
+    OSG_TRACE_ZONE("Renderer::cull");
+
     if (sceneView)
     {
         updateSceneView(sceneView);
@@ -673,9 +689,9 @@ void Renderer::cull()
         {
             DEBUG_MESSAGE<<"Collecting rendering stats"<<std::endl;
 
-            stats->setAttribute(frameNumber, "Cull traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeCullTick));
-            stats->setAttribute(frameNumber, "Cull traversal end time", osg::Timer::instance()->delta_s(_startTick, afterCullTick));
-            stats->setAttribute(frameNumber, "Cull traversal time taken", osg::Timer::instance()->delta_s(beforeCullTick, afterCullTick));
+            stats->setAttribute(frameNumber, s_cullTraversalBeginTimeID, osg::Timer::instance()->delta_s(_startTick, beforeCullTick));
+            stats->setAttribute(frameNumber, s_cullTraversalEndTimeID, osg::Timer::instance()->delta_s(_startTick, afterCullTick));
+            stats->setAttribute(frameNumber, s_cullTraversalTimeTakenID, osg::Timer::instance()->delta_s(beforeCullTick, afterCullTick));
         }
 
         if (stats && stats->collectStats("scene"))
@@ -700,6 +716,9 @@ void Renderer::draw()
 
     DEBUG_MESSAGE<<"draw() got SceneView "<<sceneView<<std::endl;
 
+    // only trace once the SceneView is available, takeFront() blocks until the cull has produced one.
+    OSG_TRACE_ZONE("Renderer::draw");
+
     if (sceneView && !_done)
     {
         // since we are running the draw thread in parallel with the main thread it's possible to unreference Camera's
@@ -791,9 +810,9 @@ void Renderer::draw()
 
         if (stats && stats->collectStats("rendering"))
         {
-            stats->setAttribute(frameNumber, "Draw traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
-            stats->setAttribute(frameNumber, "Draw traversal end time", osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
-            stats->setAttribute(frameNumber, "Draw traversal time taken", osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
+            stats->setAttribute(frameNumber, s_drawTraversalBeginTimeID, osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
+            stats->setAttribute(frameNumber, s_drawTraversalEndTimeID, osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
+            stats->setAttribute(frameNumber, s_drawTraversalTimeTakenID, osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
         }
 
         sceneView->clearReferencesToDependentCameras();
@@ -806,6 +825,8 @@ void Renderer::cull_draw()
 {
     DEBUG_MESSAGE<<"cull_draw() "<<this<<std::endl;
 
+    OSG_TRACE_ZONE("Renderer::cull_draw");
+
     osgUtil::SceneView* sceneView = _sceneView[0].get();
     if (!sceneView || _done) return;
 
@@ -896,13 +917,13 @@ void Renderer::cull_draw()
     {
         DEBUG_MESSAGE<<"Collecting rendering stats"<<std::endl;
 
-        stats->setAttribute(frameNumber, "Cull traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeCullTick));
-        stats->setAttribute(frameNumber, "Cull traversal end time", osg::Timer::instance()->delta_s(_startTick, afterCullTick));
-        stats->setAttribute(frameNumber, "Cull traversal time taken", osg::Timer::instance()->delta_s(beforeCullTick, afterCullTick));
+        stats->setAttribute(frameNumber, s_cullTraversalBeginTimeID, osg::Timer::instance()->delta_s(_startTick, beforeCullTick));
+        stats->setAttribute(frameNumber, s_cullTraversalEndTimeID, osg::Timer::instance()->delta_s(_startTick, afterCullTick));
+        stats->setAttribute(frameNumber, s_cullTraversalTimeTakenID, osg::Timer::instance()->delta_s(beforeCullTick, afterCullTick));
 
-        stats->setAttribute(frameNumber, "Draw traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
-        stats->setAttribute(frameNumber, "Draw traversal end time", osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
-        stats->setAttribute(frameNumber, "Draw traversal time taken", osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
+        stats->setAttribute(frameNumber, s_drawTraversalBeginTimeID, osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
+        stats->setAttribute(frameNumber, s_drawTraversalEndTimeID, osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
+        stats->setAttribute(frameNumber, s_drawTraversalTimeTakenID, osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
     }
 
     DEBUG_MESSAGE<<"end cull_draw() "<<this<<std::endl;
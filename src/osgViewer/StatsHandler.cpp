@@ -12,6 +12,7 @@
 */
 
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 #include <stdio.h>
 
@@ -93,6 +94,8 @@ static const char* gl2_StatsFragmentShader = {
 StatsHandler::StatsHandler():
     _keyEventTogglesOnScreenStats('s'),
     _keyEventPrintsOutStats('S'),
+    _keyEventWritesOutStatsTrace('T'),
+    _statsTraceFileName("stats_trace.json"),
     _statsType(NO_STATS),
     _initialized(false),
     _threadingModel(ViewerBase::SingleThreaded),
@@ -294,25 +297,7 @@ bool StatsHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdap
                     OSG_NOTICE<<std::endl<<"Stats report:"<<std::endl;
                     typedef std::vector<osg::Stats*> StatsList;
                     StatsList statsList;
-                    statsList.push_back(viewer->getViewerStats());
-
-                    osgViewer::ViewerBase::Contexts contexts;
-                    viewer->getContexts(contexts);
-                    for(osgViewer::ViewerBase::Contexts::iterator gcitr = contexts.begin();
-                        gcitr != contexts.end();
-                        ++gcitr)
-                    {
-                        osg::GraphicsContext::Cameras& cameras = (*gcitr)->getCameras();
-                        for(osg::GraphicsContext::Cameras::iterator itr = cameras.begin();
-                            itr != cameras.end();
-                            ++itr)
-                        {
-                            if ((*itr)->getStats())
-                            {
-                                statsList.push_back((*itr)->getStats());
-                            }
-                        }
-                    }
+                    collectStatsList(viewer, statsList);
 
                     for(unsigned int i = viewer->getViewerStats()->getEarliestFrameNumber(); i< viewer->getViewerStats()->getLatestFrameNumber(); ++i)
                     {
@@ -329,6 +314,28 @@ bool StatsHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdap
                 }
                 return true;
             }
+            if (ea.getKey()==_keyEventWritesOutStatsTrace)
+            {
+                if (viewer && viewer->getViewerStats())
+                {
+                    std::vector<osg::Stats*> statsList;
+                    collectStatsList(viewer, statsList);
+
+                    osg::Stats::StatsList constStatsList(statsList.begin(), statsList.end());
+
+                    std::ofstream fout(_statsTraceFileName.c_str());
+                    if (fout)
+                    {
+                        osg::Stats::writeChromeTrace(fout, constStatsList, viewer->getViewerStats()->getEarliestFrameNumber(), viewer->getViewerStats()->getLatestFrameNumber());
+                        OSG_NOTICE<<"Stats trace written to "<<_statsTraceFileName<<std::endl;
+                    }
+                    else
+                    {
+                        OSG_WARN<<"Warning: could not open "<<_statsTraceFileName<<" to write the stats trace to."<<std::endl;
+                    }
+                }
+                return true;
+            }
             break;
         }
         case(osgGA::GUIEventAdapter::RESIZE):
@@ -341,6 +348,29 @@ bool StatsHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdap
 
 }
 
+void StatsHandler::collectStatsList(osgViewer::ViewerBase* viewer, std::vector<osg::Stats*>& statsList)
+{
+    statsList.push_back(viewer->getViewerStats());
+
+    osgViewer::ViewerBase::Contexts contexts;
+    viewer->getContexts(contexts);
+    for(osgViewer::ViewerBase::Contexts::iterator gcitr = contexts.begin();
+        gcitr != contexts.end();
+        ++gcitr)
+    {
+        osg::GraphicsContext::Cameras& cameras = (*gcitr)->getCameras();
+        for(osg::GraphicsContext::Cameras::iterator itr = cameras.begin();
+            itr != cameras.end();
+            ++itr)
+        {
+            if ((*itr)->getStats())
+            {
+                statsList.push_back((*itr)->getStats());
+            }
+        }
+    }
+}
+
 void StatsHandler::updateThreadingModelText()
 {
     switch(_threadingModel)
@@ -1836,6 +1866,7 @@ void StatsHandler::getUsage(osg::ApplicationUsage& usage) const
 {
     usage.addKeyboardMouseBinding(_keyEventTogglesOnScreenStats,"On screen stats.");
     usage.addKeyboardMouseBinding(_keyEventPrintsOutStats,"Output stats to console.");
+    usage.addKeyboardMouseBinding(_keyEventWritesOutStatsTrace,"Write the frames held by the stats to a Chrome trace file.");
 }
 
 }